@@ -5,8 +5,10 @@
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V object_depth.vert -o object_depth.vert.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V object_depth.frag -o object_depth.frag.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V object.vert -o object.vert.spv
+%VK_SDK_PATH%/Bin32/glslangValidator.exe -V -DPACKED_VERTICES object.vert -o object_packed.vert.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V object.frag -o object.frag.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V plane.vert -o plane.vert.spv
+%VK_SDK_PATH%/Bin32/glslangValidator.exe -V -DPACKED_VERTICES plane.vert -o plane_packed.vert.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V plane.frag -o plane.frag.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V boxblur.vert -o boxblur.vert.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V boxblur.frag -o boxblur.frag.spv
@@ -14,4 +16,5 @@
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V screenquad.frag -o screenquad.frag.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V fxaa.frag -o fxaa.frag.spv
 %VK_SDK_PATH%/Bin32/glslangValidator.exe -V final_screenquad.frag -o final_screenquad.frag.spv
+%VK_SDK_PATH%/Bin32/glslangValidator.exe -V meshlet_cull.comp -o meshlet_cull.comp.spv
 pause
\ No newline at end of file
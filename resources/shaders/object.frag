@@ -43,8 +43,9 @@ float random(vec4 p){
 
 void main(){
 	// Compute the normal at the fragment using the tangent space matrix and the normal read in the normal map.
-	vec3 n = texture(textureNormal,Inuv).rgb;
-	n = normalize(n * 2.0 - 1.0);
+	// Only x and y are read, the normal maps can be stored with two channels (BC5).
+	vec2 nxy = texture(textureNormal,Inuv).rg * 2.0 - 1.0;
+	vec3 n = vec3(nxy, sqrt(max(0.0, 1.0 - dot(nxy, nxy))));
 	n = normalize(Intbn * n);
 
 	// Read the effects values
@@ -22,11 +22,22 @@ layout(set = 1, binding = 0) uniform LightUniforms {
 	float lightShininess;
 } lightUniforms;
 
-layout(push_constant) uniform Model {
+// Per-object data of the current frame, indexed by the draw ID.
+struct Object {
 	mat4 matrix;
-} model;
+	mat3 normalMatrix;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects {
+	Object objects[];
+};
+
+layout(push_constant) uniform Draw {
+	uint id;
+} draw;
 
 void main(){
+	Object model = objects[draw.id];
 	// We multiply the coordinates by the MVP matrix, and ouput the result.
 	gl_Position = lightUniforms.lightProjection * lightUniforms.lightView * model.matrix * vec4(v, 1.0);
 }
@@ -51,8 +51,9 @@ float random(vec4 p){
 
 vec3 shading(vec2 uv, float lightShininess, vec3 lightColor, out vec3 ambient){
 	// Compute the normal at the fragment using the tangent space matrix and the normal read in the normal map.
-	vec3 n = texture(textureNormal,uv).rgb;
-	n = normalize(n * 2.0 - 1.0);
+	// Only x and y are read, the normal maps can be stored with two channels (BC5).
+	vec2 nxy = texture(textureNormal,uv).rg * 2.0 - 1.0;
+	vec3 n = vec3(nxy, sqrt(max(0.0, 1.0 - dot(nxy, nxy))));
 	n = normalize(Intbn * n);
 	
 	// Compute the direction from the point to the light
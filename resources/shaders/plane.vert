@@ -3,9 +3,15 @@
 
 // Attributes
 layout(location = 0) in vec3 v;
+#ifdef PACKED_VERTICES
+// Octahedral normal, tangent remapped to [0,1] with the binormal handedness in w.
+layout(location = 1) in vec2 packedN;
+layout(location = 2) in vec4 packedTang;
+#else
 layout(location = 1) in vec3 n;
 layout(location = 2) in vec3 tang;
 layout(location = 3) in vec3 binor;
+#endif
 layout(location = 4) in vec2 uv;
 
 // Uniform: the light structure (position in view space)
@@ -26,10 +32,19 @@ layout(set = 1, binding = 0) uniform LightUniforms {
 	float lightShininess;
 } lightUniforms;
 
-layout(push_constant) uniform Model {
+// Per-object data of the current frame, indexed by the draw ID.
+struct Object {
 	mat4 matrix;
 	mat3 normalMatrix;
-} model;
+};
+
+layout(std430, set = 3, binding = 0) readonly buffer Objects {
+	Object objects[];
+};
+
+layout(push_constant) uniform Draw {
+	uint id;
+} draw;
 
 // Output: tangent space matrix, position in view space and uv.
 
@@ -41,7 +56,25 @@ layout(location = 6) out vec3 OuttangentSpacePosition;
 layout(location = 7) out vec3 OuttangentSpaceView;
 layout(location = 8) out vec3 OuttangentSpaceLight;
 
+#ifdef PACKED_VERTICES
+vec3 decodeOctahedral(vec2 e){
+	vec3 d = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	// Fold the lower hemisphere back from the corners of the square.
+	float t = max(-d.z, 0.0);
+	d.x += d.x >= 0.0 ? -t : t;
+	d.y += d.y >= 0.0 ? -t : t;
+	return normalize(d);
+}
+#endif
+
 void main(){
+	Object model = objects[draw.id];
+#ifdef PACKED_VERTICES
+	vec3 n = decodeOctahedral(packedN);
+	vec3 tang = packedTang.xyz * 2.0 - 1.0;
+	vec3 binor = (packedTang.w > 0.5 ? 1.0 : -1.0) * cross(n, tang);
+#endif
+
 	// We multiply the coordinates by the MVP matrix, and ouput the result.
 	gl_Position = camUniforms.camProjection * camUniforms.camView * model.matrix * vec4(v, 1.0);
 	
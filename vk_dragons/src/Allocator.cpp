@@ -1,161 +1,216 @@
 #include "Allocator.h"
+#include <stdexcept>
+#include <algorithm>
 
-Allocator::Allocator(VkDevice device, uint32_t type, size_t pageSize, std::map<VkDeviceMemory, Allocator*>& allocatorMap) : allocatorMap(allocatorMap) {
+//pages are at most 1/8 of their heap and 256 MB, the first one is 8 times smaller and each new page doubles
+static const VkDeviceSize maxPageSizeLimit = 256 * 1024 * 1024;
+static const VkDeviceSize heapPageFraction = 8;
+static const size_t firstPageDivisor = 8;
+static const size_t minPageSize = 1024 * 1024;
+
+Allocator::Allocator(VkDevice device, uint32_t type, VkDeviceSize heapSize, VkDeviceSize granularity, bool dedicatedAllocation, std::map<VkDeviceMemory, Allocator*>& allocatorMap) : allocatorMap(allocatorMap) {
 	this->device = device;
-	this->pageSize = pageSize;
 	this->type = type;
+	this->granularity = granularity;
+	this->dedicatedAllocation = dedicatedAllocation;
+
+	maxPageSize = static_cast<size_t>(std::max<VkDeviceSize>(std::min(heapSize / heapPageFraction, maxPageSizeLimit), minPageSize));
+	firstPageSize = std::max(maxPageSize / firstPageDivisor, minPageSize);
+	pageCount = 0;
 }
 
 Allocator::~Allocator() {
 	for (auto& page : pages) {
+		if (page.memory == VK_NULL_HANDLE) continue;
 		vkFreeMemory(device, page.memory, nullptr);
 		allocatorMap.erase(page.memory);
 	}
+	for (auto& pair : dedicatedPages) {
+		vkFreeMemory(device, pair.first, nullptr);
+		allocatorMap.erase(pair.first);
+	}
 }
 
-Allocation Allocator::Alloc(VkMemoryRequirements requirements) {
-	if (requirements.size > pageSize) throw std::runtime_error("Allocation too large");
+Allocation Allocator::Alloc(VkMemoryRequirements requirements, VkBuffer buffer, VkImage image) {
+	size_t size = static_cast<size_t>(requirements.size);
+	size_t alignment = static_cast<size_t>(requirements.alignment);
 
-	//check existing pages
-	for (Page& page : pages) {
-		Allocation alloc = AttemptAlloc(page, requirements);
-		if (alloc.memory != VK_NULL_HANDLE) {
-			return alloc;
-		}
+	//images take whole granularity pages, so a buffer can never share one with them
+	//bufferImageGranularity only matters between linear and optimal resources, every image created here has optimal tiling
+	if (image != VK_NULL_HANDLE && granularity > 1) {
+		size_t pageGranularity = static_cast<size_t>(granularity);
+		alignment = alignment > pageGranularity ? alignment : pageGranularity;
+		size = (size + pageGranularity - 1) / pageGranularity * pageGranularity;
 	}
 
-	//allocate new page
-	AllocPage();
-	Allocation alloc = AttemptAlloc(pages.back(), requirements);
-	if (alloc.memory != VK_NULL_HANDLE) {
-		return alloc;
+	//anything over half a page would waste most of one
+	if (size > maxPageSize / 2) {
+		return AllocDedicated(requirements, buffer, image);
 	}
 
-	throw std::runtime_error("Could not allocate memory");
-}
-
-void Allocator::Free(Allocation alloc) {
-	Page& page = GetPage(alloc.memory);
+	//the free lists cover every page
+	Tlsf::Range range = tlsf.Alloc(size, alignment);
 
-	for (auto iter = page.nodes.begin(); iter != page.nodes.end(); iter++) {
-		if (iter->offset > alloc.offset) {
-			page.nodes.insert(iter, { alloc.offset, alloc.size });
-			CombineNodes(page.nodes, iter);
-			return;
-		}
+	//allocate new page
+	if (range.block == Tlsf::InvalidBlock) {
+		AllocPage(size + alignment);
+		range = tlsf.Alloc(size, alignment);
 	}
-}
 
-void Allocator::Reset() {
-	for (Page& page : pages) {
-		page.nodes.clear();
-		page.nodes.push_back({ 0, pageSize });
+	if (range.block == Tlsf::InvalidBlock) {
+		throw std::runtime_error("Could not allocate memory");
 	}
-}
 
-uint32_t Allocator::GetType() {
-	return type;
+	return { pages[range.region].memory, range.offset, range.size, range.block };
 }
 
-void Allocator::AllocPage() {
+Allocation Allocator::AllocDedicated(VkMemoryRequirements requirements, VkBuffer buffer, VkImage image) {
 	VkMemoryAllocateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	info.allocationSize = pageSize;
+	info.allocationSize = requirements.size;
 	info.memoryTypeIndex = type;
 
-	VkDeviceMemory memory;
-	VkResult result = vkAllocateMemory(device, &info, nullptr, &memory);
+	VkMemoryDedicatedAllocateInfoKHR dedicatedInfo = {};
+	if (dedicatedAllocation && (buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE)) {
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+		dedicatedInfo.buffer = buffer;
+		dedicatedInfo.image = image;
+		info.pNext = &dedicatedInfo;
+	}
 
-	if (result == VK_ERROR_OUT_OF_HOST_MEMORY || result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
-		throw std::runtime_error("Out of memory");
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &info, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Could not allocate dedicated memory");
 	}
 
-	pages.push_back({ memory });
-	pageMap[memory] = pages.size() - 1;
-	pages.back().nodes.push_back({ 0, pageSize });
+	dedicatedPages[memory] = { memory, nullptr, static_cast<size_t>(requirements.size) };
 	allocatorMap[memory] = this;
+
+	return { memory, 0, static_cast<size_t>(requirements.size), Tlsf::InvalidBlock };
 }
 
-Allocation Allocator::AttemptAlloc(Page& page, VkMemoryRequirements requirements) {
-	for (auto iter = page.nodes.begin(); iter != page.nodes.end(); iter++) {
-		if (iter->size >= requirements.size) {
-			Allocation result = AttemptAlloc(page, iter, requirements);
-			if (result.memory != VK_NULL_HANDLE) {
-				SplitNode(page.nodes, iter, result);
-				return result;
-			}
-		}
+void Allocator::Free(Allocation alloc) {
+	if (alloc.block == Tlsf::InvalidBlock) {
+		vkFreeMemory(device, alloc.memory, nullptr);
+		dedicatedPages.erase(alloc.memory);
+		allocatorMap.erase(alloc.memory);
+		return;
 	}
 
-	return { VK_NULL_HANDLE };
+	uint32_t region = tlsf.Free(alloc.block);
+	if (tlsf.IsRegionEmpty(region)) {
+		pages[region].emptySince = std::chrono::steady_clock::now();
+	}
 }
 
-Allocation Allocator::AttemptAlloc(Page& page, std::list<Node>::iterator iter, VkMemoryRequirements requirements) {
-	size_t unalign = iter->offset % requirements.alignment;
-	size_t align = 0;
-
-	if (unalign != 0) {
-		align = requirements.alignment - unalign;
+void Allocator::Reset() {
+	tlsf.Reset();
+	auto now = std::chrono::steady_clock::now();
+	for (auto& page : pages) {
+		page.emptySince = now;
+		page.frozen = false;
 	}
+}
 
-	if (align + requirements.size > iter->size) return { VK_NULL_HANDLE };
-
-	Allocation result = {
-		page.memory,
-		iter->offset + align,
-		requirements.size
-	};
+void Allocator::ReleaseIdlePages(double idleTime) {
+	auto now = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < pages.size(); i++) {
+		if (pages[i].memory == VK_NULL_HANDLE || !tlsf.IsRegionEmpty(static_cast<uint32_t>(i))) continue;
 
-	return result;
+		std::chrono::duration<double> idle = now - pages[i].emptySince;
+		if (idle.count() >= idleTime || pages[i].frozen) {
+			FreePage(i);
+		}
+	}
 }
 
-void Allocator::SplitNode(std::list<Node>& list, std::list<Node>::iterator iter, Allocation alloc) {
-	size_t frontSlack = alloc.offset - iter->offset;
-	size_t endSlack = (iter->offset + iter->size) - (alloc.offset + alloc.size);
+uint32_t Allocator::GetType() {
+	return type;
+}
 
-	if (frontSlack == 0 && endSlack == 0) {
-		list.erase(iter);
+std::vector<PageUsage> Allocator::GetPageUsage() {
+	std::vector<PageUsage> usage;
+	for (size_t i = 0; i < pages.size(); i++) {
+		if (pages[i].memory == VK_NULL_HANDLE) continue;
+		usage.push_back({ pages[i].memory, pages[i].size, tlsf.GetRegionUsed(static_cast<uint32_t>(i)), pages[i].frozen });
 	}
-	else if (frontSlack == 0 && endSlack > 0) {
-		iter->offset = alloc.offset + alloc.size;
-		iter->size = endSlack;
-	}
-	else if (frontSlack > 0 && endSlack == 0) {
-		iter->size = frontSlack;
+	return usage;
+}
+
+MemoryStats Allocator::GetStats() {
+	MemoryStats stats = {};
+	for (size_t i = 0; i < pages.size(); i++) {
+		if (pages[i].memory == VK_NULL_HANDLE) continue;
+		stats.pages++;
+		stats.reserved += pages[i].size;
+		stats.used += tlsf.GetRegionUsed(static_cast<uint32_t>(i));
 	}
-	else {
-		list.insert(iter, { iter->offset, frontSlack });
-		iter->offset = alloc.offset + alloc.size;
-		iter->size = endSlack;
+	for (auto& pair : dedicatedPages) {
+		stats.dedicated++;
+		stats.reserved += pair.second.size;
+		stats.used += pair.second.size;
 	}
+
+	stats.allocations = static_cast<int64_t>(tlsf.GetAllocationCount()) + stats.dedicated;
+	stats.free = stats.reserved - stats.used;
+	stats.largestFree = tlsf.GetLargestFree();
+	return stats;
 }
 
-void Allocator::CombineNodes(std::list<Node>& list, std::list<Node>::iterator iter) {
-	//iter was the existing node
-	//middle was just added in front of iter and is guaranteed to exist
-	auto middle = iter;
-	middle--;
-	CombineNode(list, iter);
-	CombineNode(list, middle);
+void Allocator::SetPageFrozen(VkDeviceMemory memory, bool frozen) {
+	if (pageMap.count(memory) == 0) return;
+
+	size_t index = pageMap[memory];
+	tlsf.SetRegionFrozen(static_cast<uint32_t>(index), frozen);
+	pages[index].frozen = frozen;
 }
 
-//if node in front of iter exists, attempt to combine them
-void Allocator::CombineNode(std::list<Node>& list, std::list<Node>::iterator iter) {
-	auto prev = iter;
-	if (prev != list.begin()) {
-		prev--;
-		if (prev->offset + prev->size == iter->offset) {
-			prev->size += iter->size;
-			list.erase(iter);
-		}
+void Allocator::AllocPage(size_t minSize) {
+	//pages grow geometrically with the number of pages in use
+	size_t pageSize = firstPageSize;
+	for (size_t i = 0; i < pageCount && pageSize < maxPageSize; i++) {
+		pageSize *= 2;
+	}
+	while (pageSize < minSize && pageSize < maxPageSize) {
+		pageSize *= 2;
+	}
+	pageSize = std::min(pageSize, maxPageSize);
+
+	VkMemoryAllocateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	info.allocationSize = pageSize;
+	info.memoryTypeIndex = type;
+
+	VkDeviceMemory memory;
+	VkResult result = vkAllocateMemory(device, &info, nullptr, &memory);
+
+	if (result == VK_ERROR_OUT_OF_HOST_MEMORY || result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+		throw std::runtime_error("Out of memory");
 	}
+
+	uint32_t region = tlsf.AddRegion(pageSize);
+	if (region >= pages.size()) pages.resize(region + 1);
+	pages[region] = { memory, nullptr, pageSize, std::chrono::steady_clock::now() };
+	pageMap[memory] = region;
+	allocatorMap[memory] = this;
+	pageCount++;
+}
+
+void Allocator::FreePage(size_t index) {
+	Page& page = pages[index];
+	vkFreeMemory(device, page.memory, nullptr);
+	pageMap.erase(page.memory);
+	allocatorMap.erase(page.memory);
+	tlsf.RemoveRegion(static_cast<uint32_t>(index));
+	page = {};
+	pageCount--;
 }
 
 void* Allocator::GetMapping(VkDeviceMemory memory) {
 	Page& page = GetPage(memory);
 	if (page.mapping != nullptr) return page.mapping;
 
-	VkResult result = vkMapMemory(device, memory, 0, pageSize, 0, &page.mapping);
+	VkResult result = vkMapMemory(device, memory, 0, page.size, 0, &page.mapping);
 	if (result != VK_SUCCESS) {
 		throw std::runtime_error("Could not map memory");
 	}
@@ -167,6 +222,9 @@ Page& Allocator::GetPage(VkDeviceMemory memory) {
 	if (pageMap.count(memory) > 0) {
 		return pages[pageMap[memory]];
 	}
+	if (dedicatedPages.count(memory) > 0) {
+		return dedicatedPages[memory];
+	}
 
 	throw std::runtime_error("Could not find page");
 }
\ No newline at end of file
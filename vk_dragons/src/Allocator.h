@@ -1,54 +1,83 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
-#include <stack>
 #include <vector>
 #include <map>
-#include <list>
-#include <iterator>
+#include <chrono>
+#include "Tlsf.h"
 
 struct Allocation {
 	VkDeviceMemory memory;
 	size_t offset;
 	size_t size;
+	uint32_t block;	//handle of the range in the allocator, so that it can be freed in constant time. InvalidBlock for dedicated memory
 };
 
-struct Node {
-	size_t offset;
+struct Page {
+	VkDeviceMemory memory;
+	void* mapping;
 	size_t size;
+	std::chrono::steady_clock::time_point emptySince;
+	bool frozen;	//takes no new allocation, see SetPageFrozen
 };
 
-struct Page {
+//sizes are signed so that the difference between two frames fits in the same struct
+struct MemoryStats {
+	int64_t pages;
+	int64_t dedicated;	//number of dedicated allocations
+	int64_t allocations;	//sub-allocations and dedicated ones
+	int64_t reserved;	//bytes obtained from vkAllocateMemory
+	int64_t used;
+	int64_t free;
+	int64_t largestFree;	//largest sub-allocation that fits without a new page
+};
+
+struct PageUsage {
 	VkDeviceMemory memory;
-	std::list<Node> nodes;
-	void* mapping;
+	size_t size;
+	size_t used;
+	bool frozen;
 };
 
+//sub-allocates pages of one memory type, with a two-level segregated fit shared by all the pages
+//pages start small and grow geometrically up to a fraction of the heap, large resources get their own memory
 class Allocator {
 public:
-	Allocator(VkDevice device, uint32_t type, size_t pageSize, std::map<VkDeviceMemory, Allocator*>& allocatorMap);
+	Allocator(VkDevice device, uint32_t type, VkDeviceSize heapSize, VkDeviceSize granularity, bool dedicatedAllocation, std::map<VkDeviceMemory, Allocator*>& allocatorMap);
 	~Allocator();
 
-	Allocation Alloc(VkMemoryRequirements requirements);
+	//exactly one of buffer and image is the resource the memory is for. It is named in the dedicated allocation of a large resource
+	Allocation Alloc(VkMemoryRequirements requirements, VkBuffer buffer, VkImage image);
+	//one vkAllocateMemory for a single resource. buffer or image is passed on as a VK_KHR_dedicated_allocation hint when it is enabled
+	Allocation AllocDedicated(VkMemoryRequirements requirements, VkBuffer buffer, VkImage image);
 	void Free(Allocation alloc);
 	void Reset();
+	//free the pages that have been empty for at least idleTime seconds
+	void ReleaseIdlePages(double idleTime);
 	uint32_t GetType();
+	//sub-allocated pages only, dedicated memory is never fragmented
+	std::vector<PageUsage> GetPageUsage();
+	MemoryStats GetStats();
+	//used by the defragmenter to empty a page: new allocations go elsewhere, and once empty the page is released without waiting for the idle time
+	void SetPageFrozen(VkDeviceMemory memory, bool frozen);
 	void* GetMapping(VkDeviceMemory memory);
 
 private:
 	VkDevice device;
-	size_t pageSize;
 	uint32_t type;
+	VkDeviceSize granularity;
+	bool dedicatedAllocation;
+	size_t firstPageSize;
+	size_t maxPageSize;
+	size_t pageCount;
 
-	std::vector<Page> pages;
+	Tlsf tlsf;
+	std::vector<Page> pages;	//indexed by tlsf region, memory is VK_NULL_HANDLE for released pages
 	std::map<VkDeviceMemory, size_t> pageMap;
+	std::map<VkDeviceMemory, Page> dedicatedPages;
 	std::map<VkDeviceMemory, Allocator*>& allocatorMap;
 
-	void AllocPage();
-	Allocation AttemptAlloc(Page& page, VkMemoryRequirements requirements);
-	Allocation AttemptAlloc(Page& page, std::list<Node>::iterator iter, VkMemoryRequirements requirements);
-	void SplitNode(std::list<Node>& list, std::list<Node>::iterator iter, Allocation alloc);
-	void CombineNodes(std::list<Node>& list, std::list<Node>::iterator iter);
-	void CombineNode(std::list<Node>& list, std::list<Node>::iterator iter);
+	void AllocPage(size_t minSize);
+	void FreePage(size_t index);
 	Page& GetPage(VkDeviceMemory memory);
 };
\ No newline at end of file
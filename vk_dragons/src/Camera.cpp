@@ -37,6 +37,10 @@ void Camera::SetSize(uint32_t width, uint32_t height) {
 	this->height = height;
 }
 
+uint32_t Camera::GetHeight() {
+	return height;
+}
+
 void Camera::Update() {
 	projection = glm::perspective(glm::radians(fov), width / static_cast<float>(height), 0.1f, 100.0f);
 	projection = correctionMatrix * projection;
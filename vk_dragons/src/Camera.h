@@ -10,6 +10,7 @@ public:
 	glm::vec3 GetPosition();
 	glm::quat GetRotation();
 	void SetSize(uint32_t width, uint32_t height);
+	uint32_t GetHeight();
 	void Update();
 	glm::mat4 GetProjection();
 	glm::mat4 GetView();
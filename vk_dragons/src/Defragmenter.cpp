@@ -0,0 +1,285 @@
+#include "Defragmenter.h"
+#include "Uploader.h"
+#include <set>
+#include <algorithm>
+
+Defragmenter::Defragmenter(Renderer& renderer) : renderer(renderer) {
+	budget = DEFAULT_DEFRAG_BUDGET;
+	maxUsage = DEFAULT_DEFRAG_MAX_USAGE;
+	source = VK_NULL_HANDLE;
+	sourceAllocator = nullptr;
+}
+
+Defragmenter::~Defragmenter() {
+	ReleaseRetired();
+}
+
+void Defragmenter::Register(const Buffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, std::function<void(const Buffer&)> relocate) {
+	buffers[buffer.buffer] = { buffer, size, usage, relocate };
+}
+
+void Defragmenter::Register(const Image& image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers,
+	VkImageUsageFlags usage, VkImageCreateFlags flags, std::function<void(const Image&)> relocate) {
+	images[image.image] = { image, format, width, height, mipLevels, arrayLayers, usage, flags, relocate };
+}
+
+void Defragmenter::Unregister(VkBuffer buffer) {
+	buffers.erase(buffer);
+}
+
+void Defragmenter::Unregister(VkImage image) {
+	images.erase(image);
+}
+
+void Defragmenter::SetBudget(VkDeviceSize bytesPerFrame) {
+	budget = bytesPerFrame;
+}
+
+void Defragmenter::SetMaxUsage(double fraction) {
+	maxUsage = fraction;
+}
+
+bool Defragmenter::Step(VkCommandBuffer commandBuffer) {
+	//resources still being uploaded belong to the transfer queue and may not hold their data yet
+	if (renderer.uploader->GetPendingCount() > 0) return false;
+
+	uint32_t frameIndex = renderer.GetFrameIndex();
+
+	//the fence of this frame slot was waited on in Acquire, so the frame that copied these is done
+	for (size_t i = 0; i < retired.size();) {
+		if (retired[i].frameIndex == frameIndex) {
+			Destroy(retired[i]);
+			retired.erase(retired.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	if (!retired.empty()) return false;
+
+	if (source == VK_NULL_HANDLE) PickSource();
+	if (source == VK_NULL_HANDLE) return false;
+
+	//moving changes the keys, so collect them first
+	std::vector<VkBuffer> sourceBuffers;
+	for (auto& pair : buffers) {
+		if (pair.second.buffer.alloc.memory == source) sourceBuffers.push_back(pair.first);
+	}
+	std::vector<VkImage> sourceImages;
+	for (auto& pair : images) {
+		if (pair.second.image.alloc.memory == source) sourceImages.push_back(pair.first);
+	}
+
+	if (sourceBuffers.empty() && sourceImages.empty()) {
+		FinishSource();
+		return false;
+	}
+
+	Retired retiring = {};
+	retiring.frameIndex = frameIndex;
+	VkDeviceSize moved = 0;
+
+	//at least one resource moves each time, even if it is larger than the budget
+	for (VkBuffer buffer : sourceBuffers) {
+		MovableBuffer& movable = buffers[buffer];
+		if (moved > 0 && moved + movable.size > budget) break;
+		moved += movable.size;
+		MoveBuffer(commandBuffer, movable, retiring);
+	}
+	for (VkImage image : sourceImages) {
+		MovableImage& movable = images[image];
+		if (moved > 0 && moved + movable.image.alloc.size > budget) break;
+		moved += movable.image.alloc.size;
+		MoveImage(commandBuffer, movable, retiring);
+	}
+
+	if (!retiring.buffers.empty()) {
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr
+		);
+	}
+
+	retired.push_back(retiring);
+	return true;
+}
+
+void Defragmenter::ReleaseRetired() {
+	for (auto& retiring : retired) {
+		Destroy(retiring);
+	}
+	retired.clear();
+}
+
+//the sparsest page whose content can all be moved, and fits in the free space of the other pages
+void Defragmenter::PickSource() {
+	std::map<VkDeviceMemory, size_t> movableBytes;
+	for (auto& pair : buffers) {
+		if (pair.second.buffer.alloc.block != Tlsf::InvalidBlock) movableBytes[pair.second.buffer.alloc.memory] += pair.second.buffer.alloc.size;
+	}
+	for (auto& pair : images) {
+		if (pair.second.image.alloc.block != Tlsf::InvalidBlock) movableBytes[pair.second.image.alloc.memory] += pair.second.image.alloc.size;
+	}
+
+	std::set<Allocator*> allocators;
+	for (auto& pair : movableBytes) {
+		allocators.insert(&renderer.memory->GetAllocator(pair.first));
+	}
+
+	double bestUsage = maxUsage;
+	for (Allocator* allocator : allocators) {
+		std::vector<PageUsage> pages = allocator->GetPageUsage();
+
+		size_t freeBytes = 0;
+		for (auto& page : pages) {
+			if (!page.frozen) freeBytes += page.size - page.used;
+		}
+
+		for (auto& page : pages) {
+			//empty pages are released on their own, and pages holding anything unmovable can never be emptied
+			if (page.frozen || page.used == 0) continue;
+			if (movableBytes.count(page.memory) == 0 || movableBytes[page.memory] != page.used) continue;
+			if (freeBytes - (page.size - page.used) < page.used) continue;
+
+			double usage = static_cast<double>(page.used) / static_cast<double>(page.size);
+			if (usage < bestUsage) {
+				bestUsage = usage;
+				source = page.memory;
+				sourceAllocator = allocator;
+			}
+		}
+	}
+
+	if (source != VK_NULL_HANDLE) {
+		sourceAllocator->SetPageFrozen(source, true);
+	}
+}
+
+//an empty page stays frozen, so the next ReleaseIdlePages gives it back. Otherwise something was allocated there before it was frozen
+void Defragmenter::FinishSource() {
+	for (auto& page : sourceAllocator->GetPageUsage()) {
+		if (page.memory == source && page.used > 0) {
+			sourceAllocator->SetPageFrozen(source, false);
+		}
+	}
+
+	source = VK_NULL_HANDLE;
+	sourceAllocator = nullptr;
+}
+
+void Defragmenter::MoveBuffer(VkCommandBuffer commandBuffer, MovableBuffer& movable, Retired& retiring) {
+	//the source page is frozen, so the new buffer lands in another one
+	Buffer buffer = CreateBuffer(renderer, movable.size, movable.usage);
+
+	VkBufferCopy copy = {};
+	copy.size = movable.size;
+	vkCmdCopyBuffer(commandBuffer, movable.buffer.buffer, buffer.buffer, 1, &copy);
+
+	retiring.buffers.push_back(movable.buffer);
+
+	//movable lives in the map, so copy it before erasing
+	MovableBuffer moved = movable;
+	moved.buffer = buffer;
+	buffers.erase(retiring.buffers.back().buffer);
+	buffers[buffer.buffer] = moved;
+
+	moved.relocate(buffer);
+}
+
+void Defragmenter::MoveImage(VkCommandBuffer commandBuffer, MovableImage& movable, Retired& retiring) {
+	Image image = CreateImage(renderer, movable.format, movable.width, movable.height, movable.mipLevels, movable.arrayLayers, movable.usage, movable.flags);
+
+	VkImageMemoryBarrier barriers[2] = {};
+	for (auto& barrier : barriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = movable.mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = movable.arrayLayers;
+	}
+
+	//the old image is only read by earlier frames, so waiting for their fragment shaders is enough
+	barriers[0].image = movable.image.image;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[1].image = image.image;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		2, barriers
+	);
+
+	//one region per mip level, covering every layer
+	std::vector<VkImageCopy> regions(movable.mipLevels);
+	for (uint32_t i = 0; i < movable.mipLevels; i++) {
+		VkImageCopy& region = regions[i];
+		region = {};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.mipLevel = i;
+		region.srcSubresource.baseArrayLayer = 0;
+		region.srcSubresource.layerCount = movable.arrayLayers;
+		region.dstSubresource = region.srcSubresource;
+		region.extent.width = std::max(movable.width >> i, 1u);
+		region.extent.height = std::max(movable.height >> i, 1u);
+		region.extent.depth = 1;
+	}
+
+	vkCmdCopyImage(commandBuffer,
+		movable.image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data()
+	);
+
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barriers[1]
+	);
+
+	retiring.images.push_back(movable.image);
+
+	MovableImage moved = movable;
+	moved.image = image;
+	images.erase(retiring.images.back().image);
+	images[image.image] = moved;
+
+	moved.relocate(image);
+}
+
+void Defragmenter::Destroy(Retired& retiring) {
+	for (auto& buffer : retiring.buffers) {
+		vkDestroyBuffer(renderer.device, buffer.buffer, nullptr);
+		renderer.memory->Free(buffer.alloc);
+	}
+	for (auto& image : retiring.images) {
+		vkDestroyImage(renderer.device, image.image, nullptr);
+		renderer.memory->Free(image.alloc);
+	}
+}
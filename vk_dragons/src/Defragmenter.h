@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <functional>
+#include "Renderer.h"
+#include "ProgramUtilities.h"
+
+//bytes copied per frame when moving resources
+#define DEFAULT_DEFRAG_BUDGET 4 * 1024 * 1024
+//pages used above this fraction are not worth emptying
+#define DEFAULT_DEFRAG_MAX_USAGE 0.5
+
+//empties sparsely used device pages, a few resources per frame, so idle page release can give them back
+//resources are copied into other pages at the start of the frame command buffer, then their owner gets the new handle through its callback
+//the old resource is destroyed once the frame that copied it is done. Only one batch of moves is in flight at a time,
+//so an owner can reuse whatever it replaced on the previous move (a descriptor set, for example)
+class Defragmenter {
+public:
+	Defragmenter(Renderer& renderer);
+	~Defragmenter();
+
+	//movable buffers need VK_BUFFER_USAGE_TRANSFER_SRC_BIT and VK_BUFFER_USAGE_TRANSFER_DST_BIT in usage
+	void Register(const Buffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, std::function<void(const Buffer&)> relocate);
+	//movable images are color images in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, with transfer usage as well
+	void Register(const Image& image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers,
+		VkImageUsageFlags usage, VkImageCreateFlags flags, std::function<void(const Image&)> relocate);
+	//must be called before the owner destroys the resource
+	void Unregister(VkBuffer buffer);
+	void Unregister(VkImage image);
+
+	//record outside of a render pass, before any use of the movable resources. Callbacks run during the call
+	//returns true when resources were moved, command buffers recorded earlier still use the old ones
+	bool Step(VkCommandBuffer commandBuffer);
+	//the device must be idle
+	void ReleaseRetired();
+
+	void SetBudget(VkDeviceSize bytesPerFrame);
+	void SetMaxUsage(double fraction);
+
+private:
+	struct MovableBuffer {
+		Buffer buffer;
+		VkDeviceSize size;
+		VkBufferUsageFlags usage;
+		std::function<void(const Buffer&)> relocate;
+	};
+
+	struct MovableImage {
+		Image image;
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t arrayLayers;
+		VkImageUsageFlags usage;
+		VkImageCreateFlags flags;
+		std::function<void(const Image&)> relocate;
+	};
+
+	struct Retired {
+		std::vector<Buffer> buffers;
+		std::vector<Image> images;
+		uint32_t frameIndex;	//slot of the frame that copied them
+	};
+
+	Renderer& renderer;
+	VkDeviceSize budget;
+	double maxUsage;
+
+	std::map<VkBuffer, MovableBuffer> buffers;
+	std::map<VkImage, MovableImage> images;
+	VkDeviceMemory source;	//frozen page being emptied, VK_NULL_HANDLE when idle
+	Allocator* sourceAllocator;
+	std::vector<Retired> retired;
+
+	Defragmenter(const Defragmenter& other) = delete;
+	Defragmenter& operator = (const Defragmenter& other) = delete;
+
+	void PickSource();
+	void FinishSource();
+	void MoveBuffer(VkCommandBuffer commandBuffer, MovableBuffer& movable, Retired& retiring);
+	void MoveImage(VkCommandBuffer commandBuffer, MovableImage& movable, Retired& retiring);
+	void Destroy(Retired& retiring);
+};
@@ -1,6 +1,7 @@
 #include "Input.h"
 #include "Scene.h"
 #include <algorithm>
+#include <iostream>
 
 Input::Input(GLFWwindow* window, Camera& camera, Scene& scene, Renderer& renderer) : scene(scene), camera(camera), renderer(renderer) {
 	this->window = window;
@@ -33,6 +34,14 @@ void Input::HandleKey(int key, int scancode, int action, int mods) {
 		renderer.ToggleVSync();
 		scene.Resize(renderer.GetWidth(), renderer.GetHeight());
 	}
+
+	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+		std::cout << renderer.memory->DumpStats() << std::endl;
+	}
+
+	if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		scene.ToggleCommandReuse();
+	}
 }
 
 void Input::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
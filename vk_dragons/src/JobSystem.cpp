@@ -0,0 +1,200 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <iomanip>
+
+//queue of the worker running on this thread, jobs it queues go there first
+//the pool is kept with it, a job can queue into another pool where that index means nothing
+struct CurrentWorker {
+	const JobSystem* owner;
+	unsigned int index;
+};
+static thread_local CurrentWorker currentWorker = { nullptr, 0 };
+
+JobSystem::JobSystem(unsigned int threadCount, bool timeline) : timeline(timeline) {
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	startTime = std::chrono::steady_clock::now();
+	queuedCount = 0;
+	outstanding = 0;
+	nextId = 0;
+	stopping = false;
+
+	for (unsigned int i = 0; i < threadCount; i++) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+	for (unsigned int i = 0; i < threadCount; i++) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void JobSystem::Run(const std::string& name, std::function<void()> job, std::function<void()> onComplete) {
+	Job entry = { 0, name, job, onComplete, Now(), false };
+	size_t index;
+	{
+		//counted before it is queued, so the count never goes below the number of queued jobs,
+		//and under the lock, so a worker checking it before sleeping cannot miss it
+		std::lock_guard<std::mutex> lock(mutex);
+		entry.id = nextId++;
+		outstanding++;
+		queuedCount++;
+		index = currentWorker.owner == this ? currentWorker.index : entry.id % queues.size();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->jobs.push_back(std::move(entry));
+	}
+	wake.notify_one();
+}
+
+void JobSystem::Wait() {
+	while (true) {
+		Job job;
+		bool complete = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!completions.empty()) {
+				job = std::move(completions.front());
+				completions.pop_front();
+				complete = true;
+			} else if (outstanding == 0) {
+				break;
+			}
+		}
+
+		if (complete) {
+			double start = Now();
+			if (job.onComplete && !job.failed) job.onComplete();
+			double end = Now();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (timeline) events.push_back({ job.id, job.name, 0, job.queued, start, end, true });
+			outstanding--;
+			continue;
+		}
+
+		//helping is better than sleeping while jobs are still queued
+		if (TryTake(static_cast<unsigned int>(queues.size()), job)) {
+			Execute(job, 0);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this] { return !completions.empty() || outstanding == 0 || queuedCount > 0; });
+	}
+
+	std::exception_ptr first;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::swap(first, error);
+	}
+	if (first) std::rethrow_exception(first);
+}
+
+void JobSystem::PrintTimeline(std::ostream& out) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (events.empty()) return;
+
+	std::vector<Event> sorted = events;
+	std::sort(sorted.begin(), sorted.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+	out << std::fixed << std::setprecision(1);
+	out << "Startup timeline, in ms since the job system started" << std::endl;
+	for (auto& event : sorted) {
+		out << "  " << (event.thread == 0 ? std::string("main    ") : "worker " + std::to_string(event.thread))
+			<< std::setw(9) << event.start << " - " << std::setw(8) << event.end
+			<< "  " << (event.completion ? "complete " : "run      ") << event.name << std::endl;
+	}
+
+	//the completion that ended last, and the job it followed
+	const Event* last = nullptr;
+	for (auto& event : events) {
+		if (event.completion && (last == nullptr || event.end > last->end)) last = &event;
+	}
+	if (last == nullptr) return;
+	for (auto& event : events) {
+		if (event.completion || event.id != last->id) continue;
+		out << "Critical path: " << event.name
+			<< ", queued " << (event.start - event.queued)
+			<< ", run " << (event.end - event.start)
+			<< ", waited " << (last->start - event.end)
+			<< ", complete " << (last->end - last->start)
+			<< ", done at " << last->end << std::endl;
+	}
+}
+
+void JobSystem::WorkerLoop(unsigned int index) {
+	currentWorker = { this, index };
+
+	while (true) {
+		Job job;
+		if (TryTake(index, job)) {
+			Execute(job, index + 1);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait(lock, [this] { return stopping || queuedCount > 0; });
+		if (stopping && queuedCount == 0) return;
+	}
+}
+
+//the own queue from the back, since the latest job is the most likely to share data with the previous one, and the others from the front
+//index past the last queue only steals
+bool JobSystem::TryTake(unsigned int index, Job& job) {
+	size_t count = queues.size();
+	for (size_t i = 0; i < count; i++) {
+		size_t q = (index + i) % count;
+		Queue& queue = *queues[q];
+
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty()) continue;
+
+		if (q == index) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		} else {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		queuedCount--;
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::Execute(Job& job, unsigned int thread) {
+	double start = Now();
+	try {
+		job.work();
+	} catch (...) {
+		job.failed = true;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!error) error = std::current_exception();
+	}
+	double end = Now();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (timeline) events.push_back({ job.id, job.name, thread, job.queued, start, end, false });
+		completions.push_back(std::move(job));
+	}
+	finished.notify_all();
+}
+
+double JobSystem::Now() {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
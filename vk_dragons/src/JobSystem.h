@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <ostream>
+
+//small pool of worker threads, each with its own queue. Idle workers steal from the others
+//a job can have a completion, run on the thread calling Wait as soon as the job is done. Vulkan objects are created there
+class JobSystem {
+public:
+	//0 uses one worker per hardware thread. Without a timeline, jobs run every frame don't pile up events
+	JobSystem(unsigned int threadCount = 0, bool timeline = true);
+	~JobSystem();
+
+	void Run(const std::string& name, std::function<void()> job, std::function<void()> onComplete = nullptr);
+	//runs completions as jobs finish, and queued jobs while none is ready. Rethrows the first exception of a job, whose completion is skipped
+	void Wait();
+	//when each job and completion ran and on which thread, then the chain that finished last
+	void PrintTimeline(std::ostream& out);
+
+private:
+	struct Job {
+		size_t id;
+		std::string name;
+		std::function<void()> work;
+		std::function<void()> onComplete;
+		double queued;
+		bool failed;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	struct Event {
+		size_t id;
+		std::string name;
+		unsigned int thread;	//0 is the waiting thread, workers start at 1
+		double queued;
+		double start;
+		double end;
+		bool completion;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point startTime;
+
+	std::mutex mutex;	//guards everything below
+	std::condition_variable wake;	//for workers: a job was queued, or the pool is stopping
+	std::condition_variable finished;	//for the waiting thread: a job is done
+	std::atomic<size_t> queuedCount;
+	size_t outstanding;	//jobs whose completion has not run yet
+	size_t nextId;
+	std::deque<Job> completions;
+	std::vector<Event> events;
+	std::exception_ptr error;
+	bool stopping;
+	bool timeline;
+
+	JobSystem(const JobSystem& other) = delete;
+	JobSystem& operator = (const JobSystem& other) = delete;
+
+	void WorkerLoop(unsigned int index);
+	bool TryTake(unsigned int index, Job& job);
+	void Execute(Job& job, unsigned int thread);
+	double Now();
+};
@@ -9,7 +9,8 @@ Material::Material(Renderer& renderer, VkSampler sampler, std::vector<std::share
 
 	CreateLayout();
 	CreatePool();
-	CreateSet();
+	CreateSets();
+	currentSet = 0;
 	WriteDescriptors();
 }
 
@@ -19,7 +20,19 @@ Material::~Material() {
 }
 
 void Material::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstSet) {
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, firstSet, 1, &set, 0, nullptr);
+	if (HasMovedTextures()) {
+		currentSet = 1 - currentSet;
+		WriteDescriptors();
+	}
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, firstSet, 1, &sets[currentSet], 0, nullptr);
+}
+
+bool Material::HasMovedTextures() {
+	for (size_t i = 0; i < textures.size(); i++) {
+		if (textures[i]->imageView != imageViews[i]) return true;
+	}
+	return false;
 }
 
 void Material::CreateLayout() {
@@ -44,12 +57,12 @@ void Material::CreateLayout() {
 
 void Material::CreatePool() {
 	VkDescriptorPoolSize size = {};
-	size.descriptorCount = static_cast<uint32_t>(textures.size());
+	size.descriptorCount = static_cast<uint32_t>(textures.size()) * 2;
 	size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
 	VkDescriptorPoolCreateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	info.maxSets = 1;
+	info.maxSets = 2;
 	info.poolSizeCount = 1;
 	info.pPoolSizes = &size;
 	
@@ -58,14 +71,16 @@ void Material::CreatePool() {
 	}
 }
 
-void Material::CreateSet() {
+void Material::CreateSets() {
+	VkDescriptorSetLayout layouts[] = { layout, layout };
+
 	VkDescriptorSetAllocateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	info.descriptorPool = pool;
-	info.descriptorSetCount = 1;
-	info.pSetLayouts = &layout;
+	info.descriptorSetCount = 2;
+	info.pSetLayouts = layouts;
 
-	if (vkAllocateDescriptorSets(renderer.device, &info, &set) != VK_SUCCESS) {
+	if (vkAllocateDescriptorSets(renderer.device, &info, sets) != VK_SUCCESS) {
 		throw std::runtime_error("Could not allocate texture set");
 	}
 }
@@ -73,14 +88,16 @@ void Material::CreateSet() {
 void Material::WriteDescriptors() {
 	std::vector<VkDescriptorImageInfo> imageInfos(textures.size());
 	std::vector<VkWriteDescriptorSet> writes(textures.size());
+	imageViews.resize(textures.size());
 
 	for (size_t i = 0; i < textures.size(); i++) {
+		imageViews[i] = textures[i]->imageView;
 		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		imageInfos[i].imageView = textures[i]->imageView;
 		imageInfos[i].sampler = sampler;
 
 		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writes[i].dstSet = set;
+		writes[i].dstSet = sets[currentSet];
 		writes[i].dstArrayElement = 0;
 		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		writes[i].descriptorCount = 1;
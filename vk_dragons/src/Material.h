@@ -18,13 +18,17 @@ private:
 	VkSampler sampler;
 	VkDescriptorSetLayout layout;
 	VkDescriptorPool pool;
-	VkDescriptorSet set;
+	//textures moved by the defragmenter get new views, which are written in the other set since frames in flight may still use the current one
+	VkDescriptorSet sets[2];
+	uint32_t currentSet;
+	std::vector<VkImageView> imageViews;
 
 	Material(const Material& other) = delete;
 	Material& operator = (const Material& other) = delete;
 
 	void CreateLayout();
 	void CreatePool();
-	void CreateSet();
+	void CreateSets();
 	void WriteDescriptors();
+	bool HasMovedTextures();
 };
\ No newline at end of file
@@ -1,13 +1,34 @@
 #include "MemorySystem.h"
 #include <stdexcept>
+#include <sstream>
+#include <algorithm>
 
-Memory::Memory(VkPhysicalDevice physicalDevice, VkDevice device) {
+Memory::Memory(VkPhysicalDevice physicalDevice, VkDevice device, bool dedicatedAllocation, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2) {
+	this->physicalDevice = physicalDevice;
 	this->device = device;
+	this->getMemoryProperties2 = getMemoryProperties2;
+	this->dedicatedAllocation = dedicatedAllocation;
+	pageIdleTime = DEFAULT_PAGE_IDLE_TIME;
 	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
 
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	bufferImageGranularity = properties.limits.bufferImageGranularity;
+
+	getBufferMemoryRequirements2 = nullptr;
+	getImageMemoryRequirements2 = nullptr;
+	if (dedicatedAllocation) {
+		getBufferMemoryRequirements2 = reinterpret_cast<PFN_vkGetBufferMemoryRequirements2KHR>(vkGetDeviceProcAddr(device, "vkGetBufferMemoryRequirements2KHR"));
+		getImageMemoryRequirements2 = reinterpret_cast<PFN_vkGetImageMemoryRequirements2KHR>(vkGetDeviceProcAddr(device, "vkGetImageMemoryRequirements2KHR"));
+		if (getBufferMemoryRequirements2 == nullptr || getImageMemoryRequirements2 == nullptr) this->dedicatedAllocation = false;
+	}
+
 	//host allocator is created once
 	//device allocators are created as needed
 	AllocHostMemory();
+
+	stats = GatherStats();
+	previousStats = stats;
 }
 
 void Memory::Free(Allocation alloc) {
@@ -16,6 +37,59 @@ void Memory::Free(Allocation alloc) {
 	allocatorMap[alloc.memory]->Free(alloc);
 }
 
+bool Memory::GetBufferRequirements(VkBuffer buffer, VkMemoryRequirements& requirements) {
+	if (!dedicatedAllocation) {
+		vkGetBufferMemoryRequirements(device, buffer, &requirements);
+		return false;
+	}
+
+	VkBufferMemoryRequirementsInfo2KHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR;
+	info.buffer = buffer;
+
+	VkMemoryDedicatedRequirementsKHR dedicated = {};
+	dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+	VkMemoryRequirements2KHR result = {};
+	result.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+	result.pNext = &dedicated;
+
+	getBufferMemoryRequirements2(device, &info, &result);
+	requirements = result.memoryRequirements;
+	return dedicated.prefersDedicatedAllocation == VK_TRUE || dedicated.requiresDedicatedAllocation == VK_TRUE;
+}
+
+bool Memory::GetImageRequirements(VkImage image, VkMemoryRequirements& requirements) {
+	if (!dedicatedAllocation) {
+		vkGetImageMemoryRequirements(device, image, &requirements);
+		return false;
+	}
+
+	VkImageMemoryRequirementsInfo2KHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR;
+	info.image = image;
+
+	VkMemoryDedicatedRequirementsKHR dedicated = {};
+	dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+	VkMemoryRequirements2KHR result = {};
+	result.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+	result.pNext = &dedicated;
+
+	getImageMemoryRequirements2(device, &info, &result);
+	requirements = result.memoryRequirements;
+	return dedicated.prefersDedicatedAllocation == VK_TRUE || dedicated.requiresDedicatedAllocation == VK_TRUE;
+}
+
+void Memory::SetPageIdleTime(double seconds) {
+	pageIdleTime = seconds;
+}
+
+void Memory::ReleaseIdlePages() {
+	hostAllocator->ReleaseIdlePages(pageIdleTime);
+	for (auto& allocator : deviceAllocators) {
+		allocator->ReleaseIdlePages(pageIdleTime);
+	}
+}
+
 void Memory::AllocHostMemory() {
 	uint32_t type;
 	bool found = false;
@@ -43,14 +117,26 @@ void Memory::AllocHostMemory() {
 
 	if (!found) throw std::runtime_error("Could not find suitable host memory");
 
-	hostAllocator = std::make_unique<Allocator>(device, type, ALLOCATION_SIZE, allocatorMap);
+	hostAllocator = CreateAllocator(type);
 }
 
 Allocator& Memory::AllocDevice(uint32_t type) {
-	deviceAllocators.emplace_back(std::make_unique<Allocator>(device, type, ALLOCATION_SIZE, allocatorMap));
+	deviceAllocators.emplace_back(CreateAllocator(type));
 	return *deviceAllocators[deviceAllocators.size() - 1];
 }
 
+//page sizes depend on the size of the heap the memory type belongs to
+std::unique_ptr<Allocator> Memory::CreateAllocator(uint32_t type) {
+	VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[type].heapIndex].size;
+	return std::make_unique<Allocator>(device, type, heapSize, bufferImageGranularity, dedicatedAllocation, allocatorMap);
+}
+
+Allocator& Memory::GetAllocator(VkDeviceMemory memory) {
+	auto it = allocatorMap.find(memory);
+	if (it == allocatorMap.end()) throw std::runtime_error("Could not find allocator");
+	return *it->second;
+}
+
 Allocator& Memory::GetHostAllocator() {
 	return *hostAllocator;
 }
@@ -99,4 +185,158 @@ Allocator& Memory::GetDeviceAllocator(uint32_t type) {
 
 void* Memory::GetMapping(VkDeviceMemory memory) {
 	return hostAllocator->GetMapping(memory);
+}
+
+static void Add(MemoryStats& dest, const MemoryStats& stats) {
+	dest.pages += stats.pages;
+	dest.dedicated += stats.dedicated;
+	dest.allocations += stats.allocations;
+	dest.reserved += stats.reserved;
+	dest.used += stats.used;
+	dest.free += stats.free;
+	dest.largestFree = std::max(dest.largestFree, stats.largestFree);
+}
+
+static MemoryStats Subtract(const MemoryStats& a, const MemoryStats& b) {
+	return {
+		a.pages - b.pages,
+		a.dedicated - b.dedicated,
+		a.allocations - b.allocations,
+		a.reserved - b.reserved,
+		a.used - b.used,
+		a.free - b.free,
+		a.largestFree - b.largestFree
+	};
+}
+
+MemoryReport Memory::GatherStats() {
+	MemoryReport report = {};
+	report.types.resize(memoryProperties.memoryTypeCount);
+	report.heaps.resize(memoryProperties.memoryHeapCount);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		report.heaps[i].size = memoryProperties.memoryHeaps[i].size;
+		report.heaps[i].flags = memoryProperties.memoryHeaps[i].flags;
+	}
+
+	Add(report.types[hostAllocator->GetType()], hostAllocator->GetStats());
+	for (auto& allocator : deviceAllocators) {
+		Add(report.types[allocator->GetType()], allocator->GetStats());
+	}
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		Add(report.heaps[memoryProperties.memoryTypes[i].heapIndex].stats, report.types[i]);
+		Add(report.total, report.types[i]);
+	}
+
+	if (getMemoryProperties2 != nullptr) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2KHR properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+		properties.pNext = &budget;
+
+		getMemoryProperties2(physicalDevice, &properties);
+
+		report.budgetAvailable = true;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			report.heaps[i].budget = static_cast<int64_t>(budget.heapBudget[i]);
+			report.heaps[i].usage = static_cast<int64_t>(budget.heapUsage[i]);
+		}
+	}
+
+	return report;
+}
+
+void Memory::UpdateStats() {
+	previousStats = std::move(stats);
+	stats = GatherStats();
+}
+
+const MemoryReport& Memory::GetStats() {
+	return stats;
+}
+
+MemoryReport Memory::GetStatsDelta() {
+	MemoryReport delta = stats;
+	delta.total = Subtract(stats.total, previousStats.total);
+	for (size_t i = 0; i < delta.types.size(); i++) {
+		delta.types[i] = Subtract(stats.types[i], previousStats.types[i]);
+	}
+	for (size_t i = 0; i < delta.heaps.size(); i++) {
+		delta.heaps[i].budget = stats.heaps[i].budget - previousStats.heaps[i].budget;
+		delta.heaps[i].usage = stats.heaps[i].usage - previousStats.heaps[i].usage;
+		delta.heaps[i].stats = Subtract(stats.heaps[i].stats, previousStats.heaps[i].stats);
+	}
+	return delta;
+}
+
+int64_t Memory::GetAvailableBudget(uint32_t heap) {
+	const HeapStats& heapStats = stats.heaps[heap];
+	if (stats.budgetAvailable) {
+		return heapStats.budget - heapStats.usage;
+	}
+	return static_cast<int64_t>(heapStats.size) - heapStats.stats.reserved;
+}
+
+static void WriteStats(std::ostringstream& out, const MemoryStats& stats) {
+	out << "{\"pages\":" << stats.pages
+		<< ",\"dedicated\":" << stats.dedicated
+		<< ",\"allocations\":" << stats.allocations
+		<< ",\"reserved\":" << stats.reserved
+		<< ",\"used\":" << stats.used
+		<< ",\"free\":" << stats.free
+		<< ",\"largestFree\":" << stats.largestFree << "}";
+}
+
+static bool IsEmpty(const MemoryStats& stats) {
+	return stats.pages == 0 && stats.dedicated == 0 && stats.allocations == 0 && stats.reserved == 0
+		&& stats.used == 0 && stats.free == 0 && stats.largestFree == 0;
+}
+
+//types without any memory are left out, or without any change for a delta
+static void WriteReport(std::ostringstream& out, const MemoryReport& report, const VkPhysicalDeviceMemoryProperties& properties) {
+	out << "{\"total\":";
+	WriteStats(out, report.total);
+
+	out << ",\"heaps\":[";
+	for (size_t i = 0; i < report.heaps.size(); i++) {
+		const HeapStats& heap = report.heaps[i];
+		if (i > 0) out << ",";
+		out << "{\"index\":" << i
+			<< ",\"size\":" << heap.size
+			<< ",\"deviceLocal\":" << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 ? "true" : "false");
+		if (report.budgetAvailable) {
+			out << ",\"budget\":" << heap.budget << ",\"usage\":" << heap.usage;
+		}
+		out << ",\"stats\":";
+		WriteStats(out, heap.stats);
+		out << "}";
+	}
+
+	out << "],\"types\":[";
+	bool first = true;
+	for (size_t i = 0; i < report.types.size(); i++) {
+		const MemoryStats& type = report.types[i];
+		if (IsEmpty(type)) continue;
+		if (!first) out << ",";
+		first = false;
+		out << "{\"index\":" << i
+			<< ",\"heap\":" << properties.memoryTypes[i].heapIndex
+			<< ",\"flags\":" << properties.memoryTypes[i].propertyFlags
+			<< ",\"stats\":";
+		WriteStats(out, type);
+		out << "}";
+	}
+	out << "]}";
+}
+
+std::string Memory::DumpStats() {
+	std::ostringstream out;
+	out << "{\"budgetAvailable\":" << (stats.budgetAvailable ? "true" : "false") << ",\"current\":";
+	WriteReport(out, stats, memoryProperties);
+	out << ",\"delta\":";
+	WriteReport(out, GetStatsDelta(), memoryProperties);
+	out << "}";
+	return out.str();
 }
\ No newline at end of file
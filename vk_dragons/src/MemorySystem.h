@@ -4,28 +4,76 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <string>
 
 //file is named "MemorySystem.h" because "Memory.h" conflicts with included headers in visual studio
 
-#define ALLOCATION_SIZE 128 * 1024 * 1024
+//empty pages are given back to the driver after this many seconds, unless they get used again
+#define DEFAULT_PAGE_IDLE_TIME 5.0
+
+struct HeapStats {
+	VkDeviceSize size;
+	VkMemoryHeapFlags flags;
+	//from VK_EXT_memory_budget, 0 when it is not available. usage includes what the driver allocates for the process,
+	//budget is what the process can allocate before it starts hurting, other processes taken into account
+	int64_t budget;
+	int64_t usage;
+	MemoryStats stats;
+};
+
+struct MemoryReport {
+	bool budgetAvailable;
+	MemoryStats total;
+	std::vector<MemoryStats> types;	//indexed by memory type, zero for types without an allocator
+	std::vector<HeapStats> heaps;
+};
 
 class Memory {
 public:
-	Memory(VkPhysicalDevice physicalDevice, VkDevice device);
+	//getMemoryProperties2 is null when VK_EXT_memory_budget is not enabled
+	Memory(VkPhysicalDevice physicalDevice, VkDevice device, bool dedicatedAllocation, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2);
 
 	//only one host allocator, since every staging buffer can go on the same memory heap
 	//multiple device heaps since some buffers and images require different heaps
 	Allocator& GetHostAllocator();
 	Allocator& GetDeviceAllocator(VkMemoryRequirements requirements);
 	Allocator& GetDeviceAllocator(uint32_t);
+	//allocator that owns the memory, page or dedicated
+	Allocator& GetAllocator(VkDeviceMemory memory);
+
+	//return true when the driver prefers or requires a dedicated allocation for the resource (VK_KHR_dedicated_allocation)
+	bool GetBufferRequirements(VkBuffer buffer, VkMemoryRequirements& requirements);
+	bool GetImageRequirements(VkImage image, VkMemoryRequirements& requirements);
 
 	void Free(Allocation alloc);
+	void SetPageIdleTime(double seconds);
+	//call regularly, e.g. once per frame
+	void ReleaseIdlePages();
 
 	void* GetMapping(VkDeviceMemory memory);
 
+	//call once per frame, the delta is between the last two calls
+	void UpdateStats();
+	const MemoryReport& GetStats();
+	MemoryReport GetStatsDelta();
+	//current stats and delta, as a JSON object
+	std::string DumpStats();
+	//bytes that can still be allocated from the heap: the budget when it is known, otherwise the heap size minus what is reserved here
+	int64_t GetAvailableBudget(uint32_t heap);
+
 private:
+	VkPhysicalDevice physicalDevice;
 	VkDevice device;
 	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize bufferImageGranularity;
+	bool dedicatedAllocation;
+	double pageIdleTime;
+	PFN_vkGetBufferMemoryRequirements2KHR getBufferMemoryRequirements2;
+	PFN_vkGetImageMemoryRequirements2KHR getImageMemoryRequirements2;
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2;
+
+	MemoryReport stats;
+	MemoryReport previousStats;
 
 	std::map<VkDeviceMemory, Allocator*> allocatorMap;
 	std::unique_ptr<Allocator> hostAllocator;
@@ -33,5 +81,7 @@ private:
 
 	void AllocHostMemory();
 	Allocator& AllocDevice(uint32_t type);
+	std::unique_ptr<Allocator> CreateAllocator(uint32_t type);
+	MemoryReport GatherStats();
 };
 
@@ -0,0 +1,225 @@
+#include "MeshletCuller.h"
+#include <stdexcept>
+
+//each draw buffer starts with the counter used to compact the commands, padded to 16 bytes
+static const VkDeviceSize drawHeaderSize = 16;
+
+MeshletCuller::MeshletCuller(Renderer& renderer, Model& model) : renderer(renderer), model(model) {
+	meshletCount = static_cast<uint32_t>(model.GetMeshlets().size());
+
+	CreateBuffers();
+	CreateLayout();
+	CreatePool();
+	CreateSets();
+	CreatePipelineLayout();
+	CreatePipeline();
+}
+
+MeshletCuller::~MeshletCuller() {
+	vkDestroyPipeline(renderer.device, pipeline, nullptr);
+	vkDestroyPipelineLayout(renderer.device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(renderer.device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(renderer.device, setLayout, nullptr);
+
+	vkDestroyBuffer(renderer.device, meshletBuffer.buffer, nullptr);
+	renderer.memory->Free(meshletBuffer.alloc);
+	for (auto& buffer : drawBuffers) {
+		vkDestroyBuffer(renderer.device, buffer.buffer, nullptr);
+		renderer.memory->Free(buffer.alloc);
+	}
+}
+
+void MeshletCuller::UploadData(UploadBatch& batch) {
+	const std::vector<meshlet_t>& meshlets = model.GetMeshlets();
+	StagingRange range = renderer.staging->Upload(meshlets.data(), meshlets.size() * sizeof(meshlet_t));
+	renderer.staging->CopyToBuffer(range, meshletBuffer.buffer);
+	batch.buffers.push_back(meshletBuffer.buffer);
+}
+
+void MeshletCuller::Cull(VkCommandBuffer commandBuffer, const glm::mat4& cameraViewProjection, glm::vec3 cameraPosition, const glm::mat4& lightViewProjection) {
+	//the buffers of this frame slot were last read by the frame that used the slot before, which its fence already waited for
+	//there is no draw count in core Vulkan 1.0, so every slot past the compacted ones is left as an empty draw
+	uint32_t first = 2 * renderer.GetFrameIndex();
+	for (uint32_t i = first; i < first + 2; i++) {
+		vkCmdFillBuffer(commandBuffer, drawBuffers[i].buffer, 0, VK_WHOLE_SIZE, 0);
+	}
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	//the light is orthographic and only culled against its frustum
+	Dispatch(commandBuffer, sets[first], cameraViewProjection, glm::vec4(cameraPosition, 1.0f));
+	Dispatch(commandBuffer, sets[first + 1], lightViewProjection, glm::vec4(0.0f));
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void MeshletCuller::Dispatch(VkCommandBuffer commandBuffer, VkDescriptorSet set, const glm::mat4& viewProjection, glm::vec4 viewPosition) {
+	//culling happens in model space, so the planes are extracted from the full model-view-projection matrix
+	glm::mat4 world = model.GetTransform().GetWorldMatrix();
+	glm::mat4 MVP = viewProjection * world;
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(MVP[0][i], MVP[1][i], MVP[2][i], MVP[3][i]);
+	}
+
+	CullConstants constants = {};
+	constants.planes[0] = rows[3] + rows[0];
+	constants.planes[1] = rows[3] - rows[0];
+	constants.planes[2] = rows[3] + rows[1];
+	constants.planes[3] = rows[3] - rows[1];
+	constants.planes[4] = rows[2];	//depth range is [0, 1]
+	constants.planes[5] = rows[3] - rows[2];
+	for (auto& plane : constants.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	if (viewPosition.w != 0.0f) {
+		viewPosition = glm::vec4(glm::vec3(glm::inverse(world) * viewPosition), 1.0f);
+	}
+	constants.viewPosition = viewPosition;
+	constants.meshletCount = meshletCount;
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+	vkCmdDispatch(commandBuffer, (meshletCount + 63) / 64, 1, 1);
+}
+
+void MeshletCuller::DrawCamera(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* camera) {
+	if (model.SelectLod(*camera, 0) > 0) {
+		model.Draw(commandBuffer, pipelineLayout, camera);
+		return;
+	}
+	model.DrawIndirect(commandBuffer, pipelineLayout, drawBuffers[2 * renderer.GetFrameIndex()].buffer, drawHeaderSize, meshletCount);
+}
+
+void MeshletCuller::DrawLight(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* lodCamera, uint32_t lodBias) {
+	if (model.SelectLod(*lodCamera, lodBias) > 0) {
+		model.Draw(commandBuffer, pipelineLayout, lodCamera, lodBias);
+		return;
+	}
+	model.DrawIndirect(commandBuffer, pipelineLayout, drawBuffers[2 * renderer.GetFrameIndex() + 1].buffer, drawHeaderSize, meshletCount);
+}
+
+void MeshletCuller::CreateBuffers() {
+	meshletBuffer = CreateBuffer(renderer, meshletCount * sizeof(meshlet_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	VkDeviceSize drawSize = drawHeaderSize + meshletCount * sizeof(VkDrawIndexedIndirectCommand);
+	drawBuffers.resize(2 * renderer.GetFrameCount());
+	for (auto& buffer : drawBuffers) {
+		buffer = CreateBuffer(renderer, drawSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	}
+}
+
+void MeshletCuller::CreateLayout() {
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	for (uint32_t i = 0; i < 2; i++) {
+		bindings[i].binding = i;	//meshlets, draws
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	info.bindingCount = 2;
+	info.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(renderer.device, &info, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create meshlet set layout");
+	}
+}
+
+void MeshletCuller::CreatePool() {
+	VkDescriptorPoolSize size = {};
+	size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	size.descriptorCount = static_cast<uint32_t>(2 * drawBuffers.size());
+
+	VkDescriptorPoolCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	info.poolSizeCount = 1;
+	info.pPoolSizes = &size;
+	info.maxSets = static_cast<uint32_t>(drawBuffers.size());
+
+	if (vkCreateDescriptorPool(renderer.device, &info, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create descriptor pool");
+	}
+}
+
+void MeshletCuller::CreateSets() {
+	sets.resize(drawBuffers.size());
+	std::vector<VkDescriptorSetLayout> layouts(sets.size(), setLayout);
+	VkDescriptorSetAllocateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	info.descriptorPool = pool;
+	info.descriptorSetCount = static_cast<uint32_t>(sets.size());
+	info.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(renderer.device, &info, sets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Could not allocate meshlet sets");
+	}
+
+	uint32_t writeCount = static_cast<uint32_t>(2 * sets.size());
+	std::vector<VkDescriptorBufferInfo> bufferInfos(writeCount);
+	std::vector<VkWriteDescriptorSet> writes(writeCount);
+	for (uint32_t i = 0; i < writeCount; i++) {
+		uint32_t set = i / 2;
+		uint32_t binding = i % 2;
+		bufferInfos[i] = {};
+		bufferInfos[i].buffer = binding == 0 ? meshletBuffer.buffer : drawBuffers[set].buffer;
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = sets[set];
+		writes[i].dstBinding = binding;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].descriptorCount = 1;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(renderer.device, writeCount, writes.data(), 0, nullptr);
+}
+
+void MeshletCuller::CreatePipelineLayout() {
+	VkPushConstantRange pushConstantInfo = {};
+	pushConstantInfo.offset = 0;
+	pushConstantInfo.size = sizeof(CullConstants);
+	pushConstantInfo.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	info.setLayoutCount = 1;
+	info.pSetLayouts = &setLayout;
+	info.pushConstantRangeCount = 1;
+	info.pPushConstantRanges = &pushConstantInfo;
+
+	if (vkCreatePipelineLayout(renderer.device, &info, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create pipeline layout");
+	}
+}
+
+void MeshletCuller::CreatePipeline() {
+	VkShaderModule comp = CreateShaderModule(renderer.device, "resources/shaders/meshlet_cull.comp.spv");
+
+	VkComputePipelineCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	info.stage.module = comp;
+	info.stage.pName = "main";
+	info.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(renderer.device, renderer.pipelineCache, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create pipeline");
+	}
+
+	vkDestroyShaderModule(renderer.device, comp, nullptr);
+}
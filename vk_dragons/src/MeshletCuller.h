@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "Renderer.h"
+#include "Model.h"
+#include "Camera.h"
+#include "StagingRing.h"
+#include "Uploader.h"
+
+//culls the meshlets of one model against the camera and the light with a compute pass,
+//then draws the surviving ones with indirect draws. Meshlets only cover the full mesh, coarser levels of detail are drawn directly
+class MeshletCuller {
+public:
+	MeshletCuller(Renderer& renderer, Model& model);
+	~MeshletCuller();
+
+	//the copy is recorded when the batch is submitted
+	void UploadData(UploadBatch& batch);
+	//must be recorded outside of a render pass, before the draws
+	void Cull(VkCommandBuffer commandBuffer, const glm::mat4& cameraViewProjection, glm::vec3 cameraPosition, const glm::mat4& lightViewProjection);
+	void DrawCamera(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* camera);
+	void DrawLight(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* lodCamera, uint32_t lodBias);
+
+private:
+	//matches the push constants of meshlet_cull.comp
+	struct CullConstants {
+		glm::vec4 planes[6];
+		glm::vec4 viewPosition;
+		uint32_t meshletCount;
+	};
+
+	Renderer& renderer;
+	Model& model;
+	uint32_t meshletCount;
+
+	Buffer meshletBuffer;
+	//camera then light for each frame in flight, so a frame can cull while the previous ones still draw
+	std::vector<Buffer> drawBuffers;
+	VkDescriptorSetLayout setLayout;
+	VkDescriptorPool pool;
+	std::vector<VkDescriptorSet> sets;	//one per draw buffer
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	MeshletCuller(const MeshletCuller& other) = delete;
+	MeshletCuller& operator = (const MeshletCuller& other) = delete;
+
+	void CreateBuffers();
+	void CreateLayout();
+	void CreatePool();
+	void CreateSets();
+	void CreatePipelineLayout();
+	void CreatePipeline();
+	void Dispatch(VkCommandBuffer commandBuffer, VkDescriptorSet set, const glm::mat4& viewProjection, glm::vec4 viewPosition);
+};
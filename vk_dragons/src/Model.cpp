@@ -1,80 +1,210 @@
 #include "Model.h"
+#include "Defragmenter.h"
+#include <stdexcept>
+#include <cstddef>
+#include <algorithm>
 
-Model::Model(Renderer& renderer, const std::string& fileName) : renderer(renderer) {
-	Init(fileName);
-	for (size_t i = 0; i < buffers.size() - 1; i++) {	//every element except last
-		vkBuffers.push_back(buffers[i].buffer);
-		offsets.push_back(0);
-	}
+//largest error on screen, in pixels, accepted when picking a level of detail
+static const float maxLodPixelError = 1.0f;
+
+Model::Model(Renderer& renderer, const std::string& fileName, VertexFormat format) : renderer(renderer), format(format), drawId(0) {
+	Load(fileName, 0);
+	Create();
+}
+
+Model::Model(Renderer& renderer, JobSystem& jobs, const std::string& fileName, VertexFormat format) : renderer(renderer), format(format), drawId(0) {
+	//the job already runs on a worker, so it doesn't start threads of its own
+	jobs.Run(fileName, [this, fileName]() { Load(fileName, 1); }, [this]() { Create(); });
 }
 
 Model::~Model() {
 	for (auto& buffer : buffers) {
+		renderer.defragmenter->Unregister(buffer.buffer);
 		vkDestroyBuffer(renderer.device, buffer.buffer, nullptr);
 		renderer.memory->Free(buffer.alloc);
 	}
 }
 
-void Model::Init(const std::string& fileName) {
-	loadObj(fileName, mesh, Indexed);
-	centerAndUnitMesh(mesh);
-	computeTangentsAndBinormals(mesh);
+//only reads the renderer's physical device, so it can run on any thread. Processing an uncached mesh uses up to threadCount threads
+void Model::Load(const std::string& fileName, unsigned threadCount) {
+	std::string cachePath = meshCachePath(fileName);
+	cache = MeshCache::Open(cachePath, fileName);
+
+	if (cache) {
+		view = cache->GetView();
+	} else {
+		loadProcessedMesh(fileName, mesh, threadCount);
+		if (mesh.indices.size() == 0) throw std::runtime_error("Could not load mesh " + fileName);
+		//failing to write the cache only means the mesh will be processed again next time
+		MeshCache::Write(cachePath, mesh, fileName);
+		view = makeMeshView(mesh);
+	}
+
+	//meshes without normals only have positions, which are identical in both formats
+	if (format == VertexFormat::Packed && (view.normals == nullptr || !IsPackedFormatSupported())) {
+		format = VertexFormat::Separate;
+	}
+	if (format == VertexFormat::Packed) {
+		packVertices(view, packedVertices);
+	}
+
+	//every index fits in 16 bits when there are at most 65536 vertices, which halves the index buffer
+	if (view.vertexCount <= 65536) {
+		indexType = VK_INDEX_TYPE_UINT16;
+		shortIndices.assign(view.indices, view.indices + view.indexCount);
+	} else {
+		indexType = VK_INDEX_TYPE_UINT32;
+	}
+
+	//all levels of detail share the vertex buffers, each one is a range of the index buffer
+	if (view.lodCount > 0) {
+		lods.assign(view.lods, view.lods + view.lodCount);
+	} else {
+		lods.push_back({ 0, static_cast<uint32_t>(view.indexCount), 0.0f });
+	}
+	//meshes are centered on their origin
+	boundingRadius = 0.0f;
+	for (size_t i = 0; i < view.vertexCount && view.positions != nullptr; i++) {
+		boundingRadius = std::max(boundingRadius, glm::length(view.positions[i]));
+	}
 
+	//clusters of consecutive triangles of the full mesh, culled on the gpu before drawing
+	mesh_view_t fullView = view;
+	fullView.indexCount = lods[0].indexCount;
+	buildMeshlets(fullView, meshlets);
+}
+
+void Model::Create() {
 	CreateBuffers();
-	indexCount = static_cast<uint32_t>(mesh.indices.size());
+	for (size_t i = 0; i < buffers.size() - 1; i++) {	//every element except last
+		vkBuffers.push_back(buffers[i].buffer);
+		offsets.push_back(0);
+	}
 }
 
-void Model::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* camera) {
+void Model::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) {
 	vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(vkBuffers.size()), vkBuffers.data(), offsets.data());
-	vkCmdBindIndexBuffer(commandBuffer, buffers.back().buffer, 0, VK_INDEX_TYPE_UINT32);	//buffers[5] == index buffer
+	vkCmdBindIndexBuffer(commandBuffer, buffers.back().buffer, 0, indexType);	//buffers.back() == index buffer
 
+	//the ID does not change between frames, so command buffers recorded with it stay valid when the model moves
 	if (pipelineLayout != VK_NULL_HANDLE) {
-		//model matrix
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &transform.GetWorldMatrix());
-
-		if (camera != nullptr) {
-			//normal matrix
-			glm::mat4 MV = camera->GetView() * transform.GetWorldMatrix();
-			glm::mat4 normal = glm::transpose(glm::inverse(MV));
-			//shader expects mat3. mat3 in glsl has the same layout as 3 vec4's, where the W component is padding.
-			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), 3 * sizeof(glm::vec4), &normal);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &drawId);
+	}
+}
+
+void Model::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* lodCamera, uint32_t lodBias) {
+	Bind(commandBuffer, pipelineLayout);
+	const mesh_lod_t& lod = lods[lodCamera != nullptr ? SelectLod(*lodCamera, lodBias) : 0];
+	vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+}
+
+uint32_t Model::SelectLod(Camera& camera, uint32_t lodBias) {
+	glm::mat4& world = transform.GetWorldMatrix();
+	float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	float radius = boundingRadius * scale;
+	float distance = glm::length(camera.GetPosition() - glm::vec3(world[3]));
+
+	uint32_t lod = 0;
+	if (distance > radius && boundingRadius > 0.0f) {
+		//radius of the bounding sphere on screen, in pixels. An error of the mesh covers the same fraction of it
+		float projectedRadius = radius / distance * std::abs(camera.GetProjection()[1][1]) * 0.5f * camera.GetHeight();
+		float pixelsPerUnit = projectedRadius / boundingRadius;
+		while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= maxLodPixelError) {
+			lod++;
 		}
 	}
+	return std::min(lod + lodBias, static_cast<uint32_t>(lods.size() - 1));
+}
 
-	vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+void Model::DrawIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount) {
+	Bind(commandBuffer, pipelineLayout);
+
+	uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (renderer.deviceFeatures.multiDrawIndirect == VK_TRUE) {
+		vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+	} else {
+		//without the feature, drawCount must be 0 or 1
+		for (uint32_t i = 0; i < drawCount; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset + i * stride, 1, stride);
+		}
+	}
 }
 
 void Model::CreateBuffers() {
-	if (mesh.positions.size() > 0) buffers.push_back(CreateBuffer(renderer, mesh.positions.size() * sizeof(glm::vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
-	if (mesh.normals.size() > 0) buffers.push_back(CreateBuffer(renderer, mesh.normals.size() * sizeof(glm::vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
-	if (mesh.tangents.size() > 0) buffers.push_back(CreateBuffer(renderer, mesh.tangents.size() * sizeof(glm::vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
-	if (mesh.binormals.size() > 0) buffers.push_back(CreateBuffer(renderer, mesh.binormals.size() * sizeof(glm::vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
-	if (mesh.texcoords.size() > 0) buffers.push_back(CreateBuffer(renderer, mesh.texcoords.size() * sizeof(glm::vec2), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
-	buffers.push_back(CreateBuffer(renderer, mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
-}
-
-void Model::UploadData(VkCommandBuffer commandBuffer, std::vector<std::unique_ptr<StagingBuffer>>& stagingBuffers) {
-	size_t start = stagingBuffers.size();
-	if (mesh.positions.size() > 0) stagingBuffers.emplace_back(std::make_unique<StagingBuffer>(renderer, buffers[0].alloc.size, mesh.positions.data()));
-	if (mesh.normals.size() > 0) stagingBuffers.emplace_back(std::make_unique<StagingBuffer>(renderer, buffers[1].alloc.size, mesh.normals.data()));
-	if (mesh.tangents.size() > 0) stagingBuffers.emplace_back(std::make_unique<StagingBuffer>(renderer, buffers[2].alloc.size, mesh.tangents.data()));
-	if (mesh.binormals.size() > 0) stagingBuffers.emplace_back(std::make_unique<StagingBuffer>(renderer, buffers[3].alloc.size, mesh.binormals.data()));
-	if (mesh.texcoords.size() > 0) stagingBuffers.emplace_back(std::make_unique<StagingBuffer>(renderer, buffers[4].alloc.size, mesh.texcoords.data()));
-	stagingBuffers.emplace_back(std::make_unique<StagingBuffer>(renderer, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data()));
+	//transfer source as well, so that the defragmenter can move them
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if (view.positions != nullptr) AddBuffer(view.vertexCount * sizeof(glm::vec3), usage);
+	if (format == VertexFormat::Packed) {
+		AddBuffer(packedVertices.size() * sizeof(packed_vertex_t), usage);
+	} else {
+		if (view.normals != nullptr) AddBuffer(view.vertexCount * sizeof(glm::vec3), usage);
+		if (view.tangents != nullptr) AddBuffer(view.vertexCount * sizeof(glm::vec3), usage);
+		if (view.binormals != nullptr) AddBuffer(view.vertexCount * sizeof(glm::vec3), usage);
+		if (view.texcoords != nullptr) AddBuffer(view.vertexCount * sizeof(glm::vec2), usage);
+	}
+	AddBuffer(GetIndexBufferSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+}
+
+void Model::AddBuffer(VkDeviceSize size, VkBufferUsageFlags usage) {
+	size_t index = buffers.size();
+	buffers.push_back(CreateBuffer(renderer, size, usage));
+
+	//vertex buffers are bound from vkBuffers, the index buffer directly from buffers
+	renderer.defragmenter->Register(buffers[index], size, usage, [this, index](const Buffer& buffer) {
+		buffers[index] = buffer;
+		if (index < vkBuffers.size()) vkBuffers[index] = buffer.buffer;
+	});
+}
+
+size_t Model::GetIndexBufferSize() {
+	return view.indexCount * (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+bool Model::IsPackedFormatSupported() {
+	VkFormat formats[] = { VK_FORMAT_R16G16_SNORM, VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_FORMAT_R16G16_SFLOAT };
+	for (VkFormat vkFormat : formats) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(renderer.physicalDevice, vkFormat, &properties);
+		if ((properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) == 0) return false;
+	}
+	return true;
+}
+
+void Model::UploadData(UploadBatch& batch) {
+	//the view points straight into the mapped cache when there is one, so it is copied once into the staging memory
+	//streams come in the same order as buffers
+	std::vector<std::pair<const void*, size_t>> streams;
+	if (view.positions != nullptr) streams.push_back({ view.positions, view.vertexCount * sizeof(glm::vec3) });
+	if (format == VertexFormat::Packed) {
+		streams.push_back({ packedVertices.data(), packedVertices.size() * sizeof(packed_vertex_t) });
+	} else {
+		if (view.normals != nullptr) streams.push_back({ view.normals, view.vertexCount * sizeof(glm::vec3) });
+		if (view.tangents != nullptr) streams.push_back({ view.tangents, view.vertexCount * sizeof(glm::vec3) });
+		if (view.binormals != nullptr) streams.push_back({ view.binormals, view.vertexCount * sizeof(glm::vec3) });
+		if (view.texcoords != nullptr) streams.push_back({ view.texcoords, view.vertexCount * sizeof(glm::vec2) });
+	}
+	const void* indices = indexType == VK_INDEX_TYPE_UINT16 ? static_cast<const void*>(shortIndices.data()) : static_cast<const void*>(view.indices);
+	streams.push_back({ indices, GetIndexBufferSize() });
 
 	for (size_t i = 0; i < buffers.size(); i++) {
-		stagingBuffers[i + start]->CopyToBuffer(commandBuffer, buffers[i].buffer);
+		StagingRange range = renderer.staging->Upload(streams[i].first, streams[i].second);
+		renderer.staging->CopyToBuffer(range, buffers[i].buffer);
+		batch.buffers.push_back(buffers[i].buffer);
 	}
 }
 
 std::vector<VkVertexInputBindingDescription> Model::GetBindingDescriptions() {
 	auto bindings = std::vector<VkVertexInputBindingDescription>();
 
-	if (mesh.positions.size() > 0) bindings.push_back({ 0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
-	if (mesh.normals.size() > 0) bindings.push_back({ 1, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
-	if (mesh.tangents.size() > 0) bindings.push_back({ 2, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
-	if (mesh.binormals.size() > 0) bindings.push_back({ 3, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
-	if (mesh.texcoords.size() > 0) bindings.push_back({ 4, sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX });
+	if (view.positions != nullptr) bindings.push_back({ 0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
+	if (format == VertexFormat::Packed) {
+		bindings.push_back({ 1, sizeof(packed_vertex_t), VK_VERTEX_INPUT_RATE_VERTEX });
+		return bindings;
+	}
+	if (view.normals != nullptr) bindings.push_back({ 1, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
+	if (view.tangents != nullptr) bindings.push_back({ 2, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
+	if (view.binormals != nullptr) bindings.push_back({ 3, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX });
+	if (view.texcoords != nullptr) bindings.push_back({ 4, sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX });
 
 	return bindings;
 }
@@ -82,11 +212,18 @@ std::vector<VkVertexInputBindingDescription> Model::GetBindingDescriptions() {
 std::vector<VkVertexInputAttributeDescription> Model::GetAttributeDescriptions() {
 	auto attributes = std::vector<VkVertexInputAttributeDescription>();
 
-	if (mesh.positions.size() > 0) attributes.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 });
-	if (mesh.normals.size() > 0) attributes.push_back({ 1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0 });
-	if (mesh.tangents.size() > 0) attributes.push_back({ 2, 2, VK_FORMAT_R32G32B32_SFLOAT, 0 });
-	if (mesh.binormals.size() > 0) attributes.push_back({ 3, 3, VK_FORMAT_R32G32B32_SFLOAT, 0 });
-	if (mesh.texcoords.size() > 0) attributes.push_back({ 4, 4, VK_FORMAT_R32G32_SFLOAT, 0 });
+	if (view.positions != nullptr) attributes.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+	if (format == VertexFormat::Packed) {
+		//shader locations are kept, binormal (location 3) is rebuilt from the normal, the tangent and its sign
+		attributes.push_back({ 1, 1, VK_FORMAT_R16G16_SNORM, offsetof(packed_vertex_t, normal) });
+		attributes.push_back({ 2, 1, VK_FORMAT_A2B10G10R10_UNORM_PACK32, offsetof(packed_vertex_t, tangent) });
+		attributes.push_back({ 4, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(packed_vertex_t, texcoord) });
+		return attributes;
+	}
+	if (view.normals != nullptr) attributes.push_back({ 1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+	if (view.tangents != nullptr) attributes.push_back({ 2, 2, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+	if (view.binormals != nullptr) attributes.push_back({ 3, 3, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+	if (view.texcoords != nullptr) attributes.push_back({ 4, 4, VK_FORMAT_R32G32_SFLOAT, 0 });
 
 	return attributes;
 }
@@ -105,4 +242,20 @@ std::vector<VkVertexInputAttributeDescription> Model::GetDepthAttributeDescripti
 
 Transform& Model::GetTransform() {
 	return transform;
+}
+
+void Model::SetDrawId(uint32_t id) {
+	drawId = id;
+}
+
+uint32_t Model::GetDrawId() {
+	return drawId;
+}
+
+VertexFormat Model::GetVertexFormat() {
+	return format;
+}
+
+const std::vector<meshlet_t>& Model::GetMeshlets() {
+	return meshlets;
 }
\ No newline at end of file
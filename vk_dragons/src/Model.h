@@ -2,39 +2,74 @@
 #include <string>
 #include <vulkan/vulkan.h>
 #include "MeshUtilities.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
 #include "Renderer.h"
 #include "MemorySystem.h"
 #include "Allocator.h"
 #include "ProgramUtilities.h"
 #include "Transform.h"
 #include "Camera.h"
-#include "StagingBuffer.h"
+#include "StagingRing.h"
+#include "Uploader.h"
+#include "JobSystem.h"
+
+enum class VertexFormat {
+	Separate,	//one float buffer per attribute
+	Packed		//float positions, then quantized normal, tangent and uv interleaved in a second buffer
+};
 
 //manages vertex and index buffers
 class Model {
 public:
-	Model(Renderer& renderer, const std::string& fileName);
+	Model(Renderer& renderer, const std::string& fileName, VertexFormat format = VertexFormat::Separate);
+	//the mesh is loaded by a job, the buffers are created by its completion. The model is usable after jobs.Wait()
+	Model(Renderer& renderer, JobSystem& jobs, const std::string& fileName, VertexFormat format = VertexFormat::Separate);
 	~Model();
-	void UploadData(VkCommandBuffer commandBuffer, std::vector<std::unique_ptr<StagingBuffer>>& stagingBuffers);
-	void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* camera);
+	//the copies are recorded when the batch is submitted
+	void UploadData(UploadBatch& batch);
+	//with a pipeline layout, the draw ID is pushed so the shaders find the transform of the model in the object buffer
+	void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	//lodCamera picks the level of detail from the projected bounding sphere, lodBias levels coarser. Without it the full mesh is drawn
+	void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Camera* lodCamera = nullptr, uint32_t lodBias = 0);
+	void DrawIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount);
 	std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
 	std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
 	static std::vector<VkVertexInputBindingDescription> GetDepthBindingDescriptions();
 	static std::vector<VkVertexInputAttributeDescription> GetDepthAttributeDescriptions();
 
 	Transform& GetTransform();
+	void SetDrawId(uint32_t id);
+	uint32_t GetDrawId();
+	VertexFormat GetVertexFormat();
+	const std::vector<meshlet_t>& GetMeshlets();
+	uint32_t SelectLod(Camera& camera, uint32_t lodBias);
 
 private:
 	Renderer& renderer;
+	//either the mapped .vkmesh cache or the freshly processed mesh backs the view
+	std::unique_ptr<MeshCache> cache;
 	mesh_t mesh;
-	uint32_t indexCount;
+	mesh_view_t view;
+	VertexFormat format;
+	std::vector<packed_vertex_t> packedVertices;
+	std::vector<mesh_lod_t> lods;
+	float boundingRadius;
+	VkIndexType indexType;
+	std::vector<uint16_t> shortIndices;
+	std::vector<meshlet_t> meshlets;
 	std::vector<Buffer> buffers;
 
 	std::vector<VkBuffer> vkBuffers;
 	std::vector<VkDeviceSize> offsets;
 
 	Transform transform;
+	uint32_t drawId;
 
-	void Init(const std::string& fileName);
+	void Load(const std::string& fileName, unsigned threadCount);
+	void Create();
 	void CreateBuffers();
+	void AddBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+	bool IsPackedFormatSupported();
+	size_t GetIndexBufferSize();
 };
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "PipelineBuilder.h"
+#include "FileUtilities.h"
+#include <stdexcept>
+#include <cstring>
+
+PipelineDescription::PipelineDescription() {
+	cullMode = VK_CULL_MODE_BACK_BIT;
+	depthTest = false;
+	depthWrite = false;
+	depthCompareOp = VK_COMPARE_OP_LESS;
+	layout = VK_NULL_HANDLE;
+	renderPass = VK_NULL_HANDLE;
+}
+
+void PipelineDescription::Specialize(uint32_t value) {
+	specialization.push_back(value);
+}
+
+void PipelineDescription::Specialize(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+	specialization.push_back(bits);
+}
+
+template<typename T>
+static void AppendBytes(std::string& key, const T* data, size_t count) {
+	key.append(reinterpret_cast<const char*>(&count), sizeof(size_t));
+	key.append(reinterpret_cast<const char*>(data), sizeof(T) * count);
+}
+
+std::string PipelineDescription::Key() const {
+	//every appended struct is made of 32 or 64 bits fields, so there is no padding to compare
+	uint64_t handles[2] = { reinterpret_cast<uint64_t>(layout), reinterpret_cast<uint64_t>(renderPass) };
+	uint32_t state[4] = { static_cast<uint32_t>(cullMode), depthTest, depthWrite, static_cast<uint32_t>(depthCompareOp) };
+
+	std::string key;
+	AppendBytes(key, vertexShader.data(), vertexShader.size());
+	AppendBytes(key, fragmentShader.data(), fragmentShader.size());
+	AppendBytes(key, bindings.data(), bindings.size());
+	AppendBytes(key, attributes.data(), attributes.size());
+	AppendBytes(key, specialization.data(), specialization.size());
+	AppendBytes(key, state, 4);
+	AppendBytes(key, handles, 2);
+	return key;
+}
+
+size_t PipelineBuilder::KeyHash::operator()(const std::string& key) const {
+	return static_cast<size_t>(hashBuffer(key.data(), key.size()));
+}
+
+PipelineBuilder::PipelineBuilder(Renderer& renderer) : renderer(renderer) {
+	createdCount = 0;
+	sharedCount = 0;
+}
+
+PipelineBuilder::~PipelineBuilder() {
+	for (auto& pipeline : pipelines) {
+		vkDestroyPipeline(renderer.device, pipeline.second.pipeline, nullptr);
+	}
+	for (auto& module : shaderModules) {
+		vkDestroyShaderModule(renderer.device, module.second, nullptr);
+	}
+}
+
+void PipelineBuilder::Add(const PipelineDescription& description, VkPipeline* pipeline) {
+	std::string key = description.Key();
+	if (pipelines.find(key) == pipelines.end()) {
+		pipelines[key] = { description, VK_NULL_HANDLE, 0 };
+	}
+	requests.push_back({ key, pipeline });
+}
+
+void PipelineBuilder::Build(JobSystem& jobs) {
+	createdCount = 0;
+	sharedCount = 0;
+
+	//loaded here, so the jobs only read the modules
+	for (auto& request : requests) {
+		Entry& entry = pipelines[request.key];
+		GetShaderModule(entry.description.vertexShader);
+		GetShaderModule(entry.description.fragmentShader);
+	}
+
+	for (auto& request : requests) {
+		Entry& entry = pipelines[request.key];
+		if (entry.pipeline != VK_NULL_HANDLE || entry.users > 0) {
+			sharedCount++;
+		} else {
+			createdCount++;
+			//entries are not moved by the map while the jobs run, nothing is added to it until Wait returns
+			Entry* target = &entry;
+			jobs.Run("pipeline " + entry.description.fragmentShader, [this, target]() {
+				target->pipeline = Create(target->description);
+			});
+		}
+		entry.users++;
+	}
+	jobs.Wait();
+
+	for (auto& request : requests) {
+		*request.pipeline = pipelines[request.key].pipeline;
+	}
+	requests.clear();
+}
+
+void PipelineBuilder::Release(VkPipeline pipeline) {
+	if (pipeline == VK_NULL_HANDLE) return;
+	for (auto it = pipelines.begin(); it != pipelines.end(); ++it) {
+		if (it->second.pipeline != pipeline) continue;
+		if (--it->second.users == 0) {
+			vkDestroyPipeline(renderer.device, pipeline, nullptr);
+			pipelines.erase(it);
+		}
+		return;
+	}
+}
+
+size_t PipelineBuilder::GetCreatedCount() {
+	return createdCount;
+}
+
+size_t PipelineBuilder::GetSharedCount() {
+	return sharedCount;
+}
+
+VkShaderModule PipelineBuilder::GetShaderModule(const std::string& filename) {
+	auto it = shaderModules.find(filename);
+	if (it != shaderModules.end()) return it->second;
+
+	VkShaderModule module = CreateShaderModule(renderer.device, filename);
+	shaderModules[filename] = module;
+	return module;
+}
+
+//runs on the worker threads. Pipeline caches are internally synchronized, so every job can use the one of the renderer
+VkPipeline PipelineBuilder::Create(const PipelineDescription& description) {
+	std::vector<VkSpecializationMapEntry> entries(description.specialization.size());
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		entries[i].constantID = i;
+		entries[i].offset = i * sizeof(uint32_t);
+		entries[i].size = sizeof(uint32_t);
+	}
+
+	VkSpecializationInfo specialization = {};
+	specialization.dataSize = description.specialization.size() * sizeof(uint32_t);
+	specialization.pData = description.specialization.data();
+	specialization.mapEntryCount = static_cast<uint32_t>(entries.size());
+	specialization.pMapEntries = entries.data();
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = shaderModules.at(description.vertexShader);
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = shaderModules.at(description.fragmentShader);
+	shaderStages[1].pName = "main";
+	shaderStages[1].pSpecializationInfo = entries.empty() ? nullptr : &specialization;
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(description.bindings.size());
+	vertexInputInfo.pVertexBindingDescriptions = description.bindings.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.attributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = description.attributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = description.cullMode;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = description.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = description.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = description.depthCompareOp;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
+	VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDepthStencilState = description.depthTest ? &depthStencil : nullptr;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = description.layout;
+	pipelineInfo.renderPass = description.renderPass;
+	pipelineInfo.subpass = 0;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(renderer.device, renderer.pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create graphics pipeline");
+	}
+	return pipeline;
+}
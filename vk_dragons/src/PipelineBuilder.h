@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ProgramUtilities.h"
+#include "JobSystem.h"
+
+//what makes a graphics pipeline different from the others. The rest of the state is shared by every pipeline:
+//triangle lists, filled polygons, counter clockwise front faces, one sample, one color attachment without blending,
+//and dynamic viewport and scissor
+struct PipelineDescription {
+	std::string vertexShader;
+	std::string fragmentShader;
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+	VkCullModeFlags cullMode;
+	bool depthTest;	//without it, the pipeline has no depth stencil state
+	bool depthWrite;
+	VkCompareOp depthCompareOp;
+	//constants of the fragment shader, 4 bytes each, with IDs in the order they are added
+	std::vector<uint32_t> specialization;
+	VkPipelineLayout layout;
+	VkRenderPass renderPass;
+
+	PipelineDescription();
+	void Specialize(uint32_t value);
+	void Specialize(float value);
+	//every field, with the handles, as bytes. Equal keys give identical pipelines
+	std::string Key() const;
+};
+
+//creates pipelines from descriptions. Shader modules are loaded once per file, identical descriptions share one pipeline,
+//and the pipelines queued before Build are compiled on worker threads, with the pipeline cache of the renderer
+class PipelineBuilder {
+public:
+	PipelineBuilder(Renderer& renderer);
+	~PipelineBuilder();
+
+	//the handle is written by Build
+	void Add(const PipelineDescription& description, VkPipeline* pipeline);
+	//the calling thread compiles too while it waits for the jobs
+	void Build(JobSystem& jobs);
+	//a pipeline is destroyed once every Add that returned it is released
+	void Release(VkPipeline pipeline);
+
+	//pipelines created and pipelines shared in the last Build
+	size_t GetCreatedCount();
+	size_t GetSharedCount();
+
+private:
+	struct KeyHash {
+		size_t operator()(const std::string& key) const;
+	};
+
+	struct Entry {
+		PipelineDescription description;
+		VkPipeline pipeline;
+		uint32_t users;
+	};
+
+	struct Request {
+		std::string key;
+		VkPipeline* pipeline;
+	};
+
+	Renderer& renderer;
+	std::unordered_map<std::string, VkShaderModule> shaderModules;
+	std::unordered_map<std::string, Entry, KeyHash> pipelines;
+	std::vector<Request> requests;
+	size_t createdCount;
+	size_t sharedCount;
+
+	PipelineBuilder(const PipelineBuilder& other) = delete;
+	PipelineBuilder& operator = (const PipelineBuilder& other) = delete;
+
+	VkShaderModule GetShaderModule(const std::string& filename);
+	VkPipeline Create(const PipelineDescription& description);
+};
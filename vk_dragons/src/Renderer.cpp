@@ -1,59 +1,151 @@
 #include "Renderer.h"
+#include "Defragmenter.h"
+#include "StagingRing.h"
+#include "Uploader.h"
+#include "FileUtilities.h"
 #include <stdexcept>
+#include <fstream>
+#include <cstdio>
 #include <set>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
 
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_LUNARG_standard_validation",
 	//"VK_LAYER_LUNARG_api_dump"
 };
 
-Renderer::Renderer(GLFWwindow* window, uint32_t width, uint32_t height) {
+//bump when the layout of the pipeline cache file changes
+#define PIPELINE_CACHE_VERSION 1
+
+static const char pipelineCacheMagic[8] = { 'V', 'K', 'P', 'S', 'O', 0, 0, 0 };
+
+//written before the data of vkGetPipelineCacheData. Drivers don't all reject data from another driver version,
+//and a corrupt file can crash them, so nothing reaches the driver unless all of this matches
+struct PipelineCacheFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t dataHash;
+};
+
+Renderer::Renderer(GLFWwindow* window, uint32_t width, uint32_t height, uint32_t framesInFlight) {
 	this->window = window;
 	this->width = width;
 	this->height = height;
 	vsync = true;
 	swapchain = VK_NULL_HANDLE;
+	frames.resize(std::max(1u, framesInFlight));
+	frameIndex = 0;
+	frameStart = std::chrono::steady_clock::now();
+	frameTime = 0.0;
+	waitTime = 0.0;
 
 	createInstance();
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
-	createCommandPool();
+	createPipelineCache();
 	recreateSwapchain();
-	createSemaphores();
-	memory = std::make_unique<Memory>(physicalDevice, device);
+	createFrames();
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+	if (memoryBudget) {
+		getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+	}
+	memory = std::make_unique<Memory>(physicalDevice, device, dedicatedAllocation, getMemoryProperties2);
+	defragmenter = std::make_unique<Defragmenter>(*this);
+	staging = std::make_unique<StagingRing>(*this);
+	uploader = std::make_unique<Uploader>(*this);
 }
 
 Renderer::~Renderer() {
 	vkDeviceWaitIdle(device);
+	savePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+	uploader.reset();
+	staging.reset();
+	defragmenter.reset();	//frees the resources it retired
 	memory.reset();	//must be destroyed before instance
 	cleanupSwapchain();
 	vkDestroySwapchainKHR(device, swapchain, nullptr);
-	vkDestroyCommandPool(device, commandPool, nullptr);
-	vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-	vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
+	for (auto& frame : frames) {
+		vkDestroyCommandPool(device, frame.commandPool, nullptr);
+		vkDestroyFence(device, frame.fence, nullptr);
+		vkDestroySemaphore(device, frame.imageAvailableSemaphore, nullptr);
+		vkDestroySemaphore(device, frame.renderFinishedSemaphore, nullptr);
+	}
 	vkDestroyDevice(device, nullptr);
 	vkDestroySurfaceKHR(instance, surface, nullptr);
 	vkDestroyInstance(instance, nullptr);
 }
 
 void Renderer::Acquire() {
-	vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+	auto start = std::chrono::steady_clock::now();
+	frameTime = std::chrono::duration<double, std::milli>(start - frameStart).count();
+	frameStart = start;
+
+	//the slot is free once the frame that used it, framesInFlight frames ago, is done. Its semaphores and commands can be reused
+	Frame& frame = frames[frameIndex];
+	vkWaitForFences(device, 1, &frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+	vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+	//with more slots than swapchain images, or images returned out of order, another frame may still render to this one
+	if (imageFences[imageIndex] != VK_NULL_HANDLE && imageFences[imageIndex] != frame.fence) {
+		vkWaitForFences(device, 1, &imageFences[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+	imageFences[imageIndex] = frame.fence;
+
+	waitTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	staging->BeginFrame(frameIndex);
+
+	vkResetCommandPool(device, frame.commandPool, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	//these fences make sure rendering is done from the last use of the same imageIndex
-	//for example, frames using imageIndex 0 wait for the last use of imageIndex 0 to finish
-	vkWaitForFences(device, 1, &fences[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
-	vkResetFences(device, 1, &fences[imageIndex]);
+	vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
 }
 
 uint32_t Renderer::GetImageIndex() {
 	return imageIndex;
 }
 
-void Renderer::Render(VkCommandBuffer commandBuffer) {
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
+uint32_t Renderer::GetFrameIndex() {
+	return frameIndex;
+}
+
+uint32_t Renderer::GetFrameCount() {
+	return static_cast<uint32_t>(frames.size());
+}
+
+VkCommandBuffer Renderer::GetCommandBuffer() {
+	return frames[frameIndex].commandBuffer;
+}
+
+double Renderer::GetFrameTime() {
+	return frameTime;
+}
+
+double Renderer::GetWaitTime() {
+	return waitTime;
+}
+
+void Renderer::Render(VkCommandBuffer recorded) {
+	Frame& frame = frames[frameIndex];
+
+	if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Could not record command buffer");
+	}
+	VkCommandBuffer commandBuffers[] = { frame.commandBuffer, recorded };
+
+	VkSemaphore waitSemaphores[] = { frame.imageAvailableSemaphore };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
 	VkSubmitInfo submitInfo = {};
@@ -61,26 +153,30 @@ void Renderer::Render(VkCommandBuffer commandBuffer) {
 	submitInfo.waitSemaphoreCount = 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.commandBufferCount = recorded != VK_NULL_HANDLE ? 2 : 1;
+	submitInfo.pCommandBuffers = commandBuffers;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &renderFinishedSemaphore;
+	submitInfo.pSignalSemaphores = &frame.renderFinishedSemaphore;
 
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fences[imageIndex]) != VK_SUCCESS) {
+	//reset only now, a fence left unsignaled without a submission would block the next wait forever
+	vkResetFences(device, 1, &frame.fence);
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.fence) != VK_SUCCESS) {
 		throw std::runtime_error("Could not submit draw command buffer");
 	}
+	staging->EndFrame(frameIndex);
 }
 
 void Renderer::Present() {
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
+	presentInfo.pWaitSemaphores = &frames[frameIndex].renderFinishedSemaphore;
 	presentInfo.swapchainCount = 1;
 	presentInfo.pSwapchains = &swapchain;
 	presentInfo.pImageIndices = &imageIndex;
 
 	vkQueuePresentKHR(presentQueue, &presentInfo);
+	frameIndex = (frameIndex + 1) % static_cast<uint32_t>(frames.size());
 }
 
 void Renderer::Resize(uint32_t width, uint32_t height) {
@@ -88,6 +184,8 @@ void Renderer::Resize(uint32_t width, uint32_t height) {
 	this->height = height;
 
 	vkDeviceWaitIdle(device);
+	defragmenter->ReleaseRetired();	//the device is idle, so the frames that copied them are done
+	staging->ReleaseSubmitted();
 	cleanupSwapchain();
 	recreateSwapchain();
 }
@@ -108,52 +206,20 @@ bool Renderer::IsGamma() {
 	return gamma;
 }
 
+bool Renderer::IsPipelineCacheWarm() {
+	return pipelineCacheWarm;
+}
+
 void Renderer::recreateSwapchain() {
 	createSwapchain();
 	createImageViews();
-	createFences();
+	imageFences.assign(swapchainImages.size(), VK_NULL_HANDLE);
 }
 
 void Renderer::cleanupSwapchain() {
 	for (auto& imageView : swapchainImageViews) {
 		vkDestroyImageView(device, imageView, nullptr);
 	}
-	for (auto& fence : fences) {
-		vkDestroyFence(device, fence, nullptr);
-	}
-}
-
-VkCommandBuffer Renderer::GetSingleUseCommandBuffer() {
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = commandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-	VkCommandBufferBeginInfo beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	return commandBuffer;
-}
-
-void Renderer::SubmitCommandBuffer(VkCommandBuffer commandBuffer) {
-	vkEndCommandBuffer(commandBuffer);
-
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphicsQueue);
-
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
 //From https://vulkan-tutorial.com/
@@ -173,9 +239,22 @@ void Renderer::createInstance() {
 	const char** glfwExtensions;
 
 	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
-	createInfo.enabledExtensionCount = glfwExtensionCount;
-	createInfo.ppEnabledExtensionNames = glfwExtensions;
+	//optional, only used for memory statistics
+	uint32_t extensionCount;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+	physicalDeviceProperties2 = false;
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) physicalDeviceProperties2 = true;
+	}
+	if (physicalDeviceProperties2) extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (checkValidationSupport(validationLayers)) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -272,6 +351,16 @@ QueueFamilyIndices Renderer::findQueueFamilies(VkPhysicalDevice device) {
 		i++;
 	}
 
+	//a family that can transfer but not draw or compute is usually a separate copy engine
+	indices.transferFamily = indices.graphicsFamily;
+	for (uint32_t j = 0; j < queueFamilyCount; j++) {
+		VkQueueFlags flags = queueFamilies[j].queueFlags;
+		if (queueFamilies[j].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			indices.transferFamily = j;
+			break;
+		}
+	}
+
 	return indices;
 }
 
@@ -286,13 +375,46 @@ void Renderer::SelectFeatures(VkPhysicalDeviceFeatures& features) {
 	if (availableFeatures.shaderCullDistance == VK_TRUE) {
 		features.shaderCullDistance = VK_TRUE;
 	}
+	if (availableFeatures.multiDrawIndirect == VK_TRUE) {
+		features.multiDrawIndirect = VK_TRUE;
+	}
+	if (availableFeatures.textureCompressionBC == VK_TRUE) {
+		features.textureCompressionBC = VK_TRUE;
+	}
+}
+
+void Renderer::SelectExtensions(std::vector<const char*>& extensions) {
+	extensions = deviceExtensions;
+
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+	std::set<std::string> missing(dedicatedAllocationExtensions.begin(), dedicatedAllocationExtensions.end());
+	for (const auto& extension : availableExtensions) {
+		missing.erase(extension.extensionName);
+	}
+
+	dedicatedAllocation = missing.empty();
+	if (dedicatedAllocation) {
+		extensions.insert(extensions.end(), dedicatedAllocationExtensions.begin(), dedicatedAllocationExtensions.end());
+	}
+
+	memoryBudget = false;
+	if (physicalDeviceProperties2) {
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) memoryBudget = true;
+		}
+	}
+	if (memoryBudget) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 }
 
 void Renderer::createLogicalDevice() {
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+	std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.transferFamily };
 
 	float queuePriority = 1.0f;
 	for (int queueFamily : uniqueQueueFamilies) {
@@ -305,14 +427,16 @@ void Renderer::createLogicalDevice() {
 	}
 
 	SelectFeatures(deviceFeatures);
+	std::vector<const char*> extensions;
+	SelectExtensions(extensions);
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
 		throw std::runtime_error("Could not create logical device");
@@ -320,6 +444,102 @@ void Renderer::createLogicalDevice() {
 
 	vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
 	vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+	vkGetDeviceQueue(device, indices.transferFamily, 0, &transferQueue);
+	graphicsFamily = static_cast<uint32_t>(indices.graphicsFamily);
+	transferFamily = static_cast<uint32_t>(indices.transferFamily);
+}
+
+//starts from the cache saved by a previous run when it was written for this device and driver, empty otherwise
+void Renderer::createPipelineCache() {
+	MappedFile file;
+	const char* initialData = nullptr;
+	size_t initialSize = 0;
+
+	if (file.Open(PIPELINE_CACHE_PATH)) {
+		PipelineCacheFileHeader header = {};
+		const char* data = nullptr;
+
+		//nothing past the file header is read before its sizes are known to be inside the file
+		bool intact = file.GetSize() >= sizeof(PipelineCacheFileHeader);
+		if (intact) {
+			memcpy(&header, file.GetData(), sizeof(PipelineCacheFileHeader));
+			data = file.GetData() + sizeof(PipelineCacheFileHeader);
+			intact = memcmp(header.magic, pipelineCacheMagic, sizeof(pipelineCacheMagic)) == 0 &&
+				header.dataSize == file.GetSize() - sizeof(PipelineCacheFileHeader) &&
+				header.dataSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+				header.dataHash == hashBuffer(data, static_cast<size_t>(header.dataSize));
+		}
+
+		if (!intact) {
+			std::cout << "Ignoring " << PIPELINE_CACHE_PATH << ", it is truncated or corrupt" << std::endl;
+		} else if (header.version != PIPELINE_CACHE_VERSION) {
+			std::cout << "Ignoring " << PIPELINE_CACHE_PATH << ", it was written with another version of the file format" << std::endl;
+		} else {
+			//the data starts with the header defined by Vulkan, which is checked too
+			VkPipelineCacheHeaderVersionOne cacheHeader;
+			memcpy(&cacheHeader, data, sizeof(VkPipelineCacheHeaderVersionOne));
+
+			if (header.vendorID == deviceProperties.vendorID && header.deviceID == deviceProperties.deviceID &&
+				header.driverVersion == deviceProperties.driverVersion &&
+				memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+				cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && cacheHeader.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+				cacheHeader.headerSize <= header.dataSize &&
+				cacheHeader.vendorID == deviceProperties.vendorID && cacheHeader.deviceID == deviceProperties.deviceID &&
+				memcmp(cacheHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0) {
+				initialData = data;
+				initialSize = static_cast<size_t>(header.dataSize);
+			} else {
+				std::cout << "Ignoring " << PIPELINE_CACHE_PATH << ", it was written for another device or driver" << std::endl;
+			}
+		}
+	}
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = initialSize;
+	createInfo.pInitialData = initialData;
+
+	//the data was copied, so the file can be unmapped once this returns
+	if (vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create pipeline cache");
+	}
+	pipelineCacheWarm = initialSize > 0;
+}
+
+void Renderer::savePipelineCache() {
+	size_t size = 0;
+	if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+
+	PipelineCacheFileHeader header = {};
+	memcpy(header.magic, pipelineCacheMagic, sizeof(pipelineCacheMagic));
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = size;
+	header.dataHash = hashBuffer(data.data(), size);
+
+	//write to a temporary file first, so that a failed write never leaves a truncated cache behind
+	std::string path = PIPELINE_CACHE_PATH;
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) return;
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(PipelineCacheFileHeader));
+		out.write(data.data(), static_cast<std::streamsize>(size));
+		if (!out) {
+			out.close();
+			std::remove(tempPath.c_str());
+			return;
+		}
+	}
+
+	std::remove(path.c_str());
+	std::rename(tempPath.c_str(), path.c_str());
 }
 
 void Renderer::createSurface() {
@@ -534,39 +754,45 @@ void Renderer::createImageViews() {
 	}
 }
 
-void Renderer::createFences() {
-	fences.resize(swapchainImages.size());
+void Renderer::createFrames() {
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
-	for (size_t i = 0; i < swapchainImages.size(); i++) {
-		VkFenceCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	for (auto& frame : frames) {
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		if (vkCreateFence(device, &info, nullptr, &fences[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Could not create fences");
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.renderFinishedSemaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Could not create semaphores");
 		}
-	}
-}
 
-void Renderer::createSemaphores() {
-	VkSemaphoreCreateInfo semaphoreInfo = {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		//signaled, so the first wait on each slot returns at once
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create semaphores");
-	}
-}
+		if (vkCreateFence(device, &fenceInfo, nullptr, &frame.fence) != VK_SUCCESS) {
+			throw std::runtime_error("Could not create fences");
+		}
 
-void Renderer::createCommandPool() {
-	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+		//the whole pool is reset at the start of the frame, instead of each command buffer
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-	VkCommandPoolCreateInfo poolInfo = {};
-	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Could not create command pool");
+		}
 
-	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create command pool");
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = frame.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Could not allocate command buffers");
+		}
 	}
 }
\ No newline at end of file
@@ -3,11 +3,22 @@
 #include<GLFW/glfw3.h>
 #include <vector>
 #include <memory>
+#include <chrono>
 #include "MemorySystem.h"
 
+//frames the CPU can record while the GPU still renders the previous ones
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+//pipeline cache of the device, loaded at startup and saved at shutdown, in the working directory
+#define PIPELINE_CACHE_PATH "pipelines.vkcache"
+
+class Defragmenter;
+class StagingRing;
+class Uploader;
+
 struct QueueFamilyIndices {
 	int graphicsFamily = -1;
 	int presentFamily = -1;
+	int transferFamily = -1;	//the graphics family when there is no dedicated one
 
 	bool isComplete() {
 		return graphicsFamily >= 0 && presentFamily >= 0;
@@ -20,16 +31,35 @@ struct SwapChainSupportDetails {
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
+//sync objects and commands of one frame in flight, reused once its fence is signaled
+struct Frame {
+	VkSemaphore imageAvailableSemaphore;
+	VkSemaphore renderFinishedSemaphore;
+	VkFence fence;
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer;
+};
+
 class Renderer {
 public:
-	Renderer(GLFWwindow* window, uint32_t width, uint32_t height);
+	Renderer(GLFWwindow* window, uint32_t width, uint32_t height, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
 	~Renderer();
 
+	//waits for the frame that last used the next slot, then acquires a swapchain image. The slot's command buffer is reset and begun
 	void Acquire();
 	uint32_t GetImageIndex();
-	void Render(VkCommandBuffer commandBuffer);
+	//slot of the current frame, per-frame resources are indexed with it
+	uint32_t GetFrameIndex();
+	uint32_t GetFrameCount();
+	VkCommandBuffer GetCommandBuffer();
+	//ends and submits the command buffer of the current frame, followed by recorded if there is one, in the same batch
+	void Render(VkCommandBuffer recorded = VK_NULL_HANDLE);
 	void Present();
 
+	//of the last frame, in milliseconds: time between the last two calls to Acquire, and time Acquire spent blocked on the GPU
+	double GetFrameTime();
+	double GetWaitTime();
+
 	void Resize(uint32_t width, uint32_t height);
 	void ToggleVSync();
 
@@ -37,18 +67,25 @@ public:
 	uint32_t GetHeight();
 
 	bool IsGamma();
-
-	VkCommandBuffer GetSingleUseCommandBuffer();
-	void SubmitCommandBuffer(VkCommandBuffer commandBuffer);
+	//the pipeline cache was loaded from disk, so pipelines created with it should not need compiling
+	bool IsPipelineCacheWarm();
 
 	std::unique_ptr<Memory> memory;
+	std::unique_ptr<Defragmenter> defragmenter;
+	std::unique_ptr<StagingRing> staging;
+	std::unique_ptr<Uploader> uploader;
 
 	VkPhysicalDevice physicalDevice;
 	VkPhysicalDeviceProperties deviceProperties;
 	VkPhysicalDeviceFeatures deviceFeatures;
+	bool dedicatedAllocation;	//VK_KHR_dedicated_allocation is enabled
+	bool memoryBudget;	//VK_EXT_memory_budget is enabled
 	VkDevice device;
+	uint32_t graphicsFamily;
+	uint32_t transferFamily;
+	VkQueue transferQueue;	//same as the graphics queue when the families are the same
+	VkPipelineCache pipelineCache;	//shared by every pipeline creation
 	VkExtent2D swapchainExtent;
-	VkCommandPool commandPool;
 	std::vector<VkImage> swapchainImages;
 	VkFormat swapchainImageFormat;
 	std::vector<VkImageView> swapchainImageViews;
@@ -59,21 +96,32 @@ private:
 	uint32_t height;
 	bool vsync;
 	bool gamma;
+	bool pipelineCacheWarm;
 
 	VkInstance instance;
+	bool physicalDeviceProperties2;	//VK_KHR_get_physical_device_properties2 is enabled, needed to query the memory budget
 	VkQueue graphicsQueue;
 	VkSurfaceKHR surface;
 	VkQueue presentQueue;
 	VkSwapchainKHR swapchain;
 
-	VkSemaphore imageAvailableSemaphore;
-	VkSemaphore renderFinishedSemaphore;
+	std::vector<Frame> frames;
+	uint32_t frameIndex;
 	uint32_t imageIndex;
-	std::vector<VkFence> fences;
+	std::vector<VkFence> imageFences;	//fence of the frame that last rendered to each swapchain image, VK_NULL_HANDLE if none
+
+	std::chrono::steady_clock::time_point frameStart;
+	double frameTime;
+	double waitTime;
 
 	const std::vector<const char*> deviceExtensions = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
+	//enabled only when every extension of the group is available
+	const std::vector<const char*> dedicatedAllocationExtensions = {
+		VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+		VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME
+	};
 
 	void createInstance();
 	bool checkValidationSupport(const std::vector<const char*>& layers);
@@ -81,7 +129,10 @@ private:
 	bool isDeviceSuitable(VkPhysicalDevice device);
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 	void SelectFeatures(VkPhysicalDeviceFeatures& features);
+	void SelectExtensions(std::vector<const char*>& extensions);
 	void createLogicalDevice();
+	void createPipelineCache();
+	void savePipelineCache();
 	void createSurface();
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 	SwapChainSupportDetails querySwapchainSupport(VkPhysicalDevice device);
@@ -90,9 +141,7 @@ private:
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 	void createSwapchain();
 	void createImageViews();
-	void createFences();
-	void createSemaphores();
-	void createCommandPool();
+	void createFrames();
 	void recreateSwapchain();
 	void cleanupSwapchain();
 };
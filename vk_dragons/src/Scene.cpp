@@ -1,7 +1,16 @@
 #include "Scene.h"
-
-Scene::Scene(GLFWwindow* window, uint32_t width, uint32_t height)
-	: renderer(window, width, height),
+#include "Defragmenter.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+//the shadow map is low resolution and blurred, so shadow casters can use coarser levels of detail than the geometry pass
+static const uint32_t shadowLodBias = 1;
+//models with transforms in the object buffer: the dragon, suzanne and the plane
+static const uint32_t objectCount = 3;
+
+Scene::Scene(GLFWwindow* window, uint32_t width, uint32_t height, uint32_t framesInFlight)
+	: renderer(window, width, height, framesInFlight),
 	camera(45.0f, width, height),
 	input(window, camera, *this, renderer) {
 
@@ -11,19 +20,59 @@ Scene::Scene(GLFWwindow* window, uint32_t width, uint32_t height)
 	CreateSampler();
 	CreateTextureSetLayout();
 	CreateUniformSetLayout();
+	CreateObjectSetLayout();
 	CreateModelTextureSetLayout();
+	CreateCommandPool();
 
 	camUniform = std::make_unique<UniformBuffer>(renderer, sizeof(CameraUniform), uniformSetLayout);
 	lightUniform = std::make_unique<UniformBuffer>(renderer, sizeof(LightUniform), uniformSetLayout);
+	objectBuffer = std::make_unique<UniformBuffer>(renderer, sizeof(ObjectData) * objectCount, objectSetLayout, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
 	time = 0.0f;
+	loaded = false;
+	reuseCommands = true;
+	structureVersion = 1;
+	recordTime = 0.0;
+	//the thread waiting for the recording jobs runs them too
+	recordThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	recordJobs = std::make_unique<JobSystem>(std::max(1u, recordThreadCount - 1), false);
+	pipelineBuilder = std::make_unique<PipelineBuilder>(renderer);
 	camera.SetPosition(glm::vec3(0, 0, 1.0f));
 
-	dragon = std::make_unique<Model>(renderer, "resources/dragon.obj");
-	suzanne = std::make_unique<Model>(renderer, "resources/suzanne.obj");
-	plane = std::make_unique<Model>(renderer, "resources/plane.obj");
-	skybox = std::make_unique<Model>(renderer, "resources/skybox.obj");
-	quad = std::make_unique<Model>(renderer, "resources/screenquad.obj");
+	//every mesh and image file is loaded by its own job, cold start is bounded by the slowest one instead of their sum
+	//the vulkan objects are created on this thread as the jobs complete
+	JobSystem jobs;
+
+	//the dragon has the most vertices, so it is the one worth the quantized vertex format
+	dragon = std::make_unique<Model>(renderer, jobs, "resources/dragon.obj", VertexFormat::Packed);
+	suzanne = std::make_unique<Model>(renderer, jobs, "resources/suzanne.obj");
+	plane = std::make_unique<Model>(renderer, jobs, "resources/plane.obj");
+	skybox = std::make_unique<Model>(renderer, jobs, "resources/skybox.obj");
+	quad = std::make_unique<Model>(renderer, jobs, "resources/screenquad.obj");
+
+	auto dragonColor = std::make_shared<Texture>(renderer, jobs, _Image, "resources/dragon_texture_color.png", ColorTexture);
+	auto dragonNormal = std::make_shared<Texture>(renderer, jobs, _Image, "resources/dragon_texture_normal.png", NormalTexture);
+	auto dragonEffects = std::make_shared<Texture>(renderer, jobs, _Image, "resources/dragon_texture_ao_specular_reflection.png", EffectsTexture);
+
+	auto suzanneColor = std::make_shared<Texture>(renderer, jobs, _Image, "resources/suzanne_texture_color.png", ColorTexture);
+	auto suzanneNormal = std::make_shared<Texture>(renderer, jobs, _Image, "resources/suzanne_texture_normal.png", NormalTexture);
+	auto suzanneEffects = std::make_shared<Texture>(renderer, jobs, _Image, "resources/suzanne_texture_ao_specular_reflection.png", EffectsTexture);
+
+	auto planeColor = std::make_shared<Texture>(renderer, jobs, _Image, "resources/plane_texture_color.png", ColorTexture);
+	auto planeNormal = std::make_shared<Texture>(renderer, jobs, _Image, "resources/plane_texture_normal.png", NormalTexture);
+	auto planeEffects = std::make_shared<Texture>(renderer, jobs, _Image, "resources/plane_texture_depthmap.png", EffectsTexture);
+
+	auto skyColor = std::make_shared<Texture>(renderer, jobs, Cubemap, "resources/cubemap/cubemap", ColorTexture);
+	auto skySmallColor = std::make_shared<Texture>(renderer, jobs, Cubemap, "resources/cubemap/cubemap_diff", ColorTexture);
+
+	jobs.Wait();
+	jobs.PrintTimeline(std::cout);
+
+	dragonCuller = std::make_unique<MeshletCuller>(renderer, *dragon);
+
+	dragon->SetDrawId(0);
+	suzanne->SetDrawId(1);
+	plane->SetDrawId(2);
 
 	dragon->GetTransform().SetScale(glm::vec3(0.5f));
 	dragon->GetTransform().SetPosition(glm::vec3(-0.1f, 0.0f, -0.25f));
@@ -34,21 +83,6 @@ Scene::Scene(GLFWwindow* window, uint32_t width, uint32_t height)
 	plane->GetTransform().SetScale(glm::vec3(2.0f));
 	plane->GetTransform().SetPosition(glm::vec3(0.0f, -0.35f, -0.5f));
 
-	auto dragonColor = std::make_shared<Texture>(renderer, _Image, "resources/dragon_texture_color.png", true);
-	auto dragonNormal = std::make_shared<Texture>(renderer, _Image, "resources/dragon_texture_normal.png");
-	auto dragonEffects = std::make_shared<Texture>(renderer, _Image, "resources/dragon_texture_ao_specular_reflection.png");
-
-	auto suzanneColor = std::make_shared<Texture>(renderer, _Image, "resources/suzanne_texture_color.png", true);
-	auto suzanneNormal = std::make_shared<Texture>(renderer, _Image, "resources/suzanne_texture_normal.png");
-	auto suzanneEffects = std::make_shared<Texture>(renderer, _Image, "resources/suzanne_texture_ao_specular_reflection.png");
-
-	auto planeColor = std::make_shared<Texture>(renderer, _Image, "resources/plane_texture_color.png", true);
-	auto planeNormal = std::make_shared<Texture>(renderer, _Image, "resources/plane_texture_normal.png");
-	auto planeEffects = std::make_shared<Texture>(renderer, _Image, "resources/plane_texture_depthmap.png");
-
-	auto skyColor = std::make_shared<Texture>(renderer, Cubemap, "resources/cubemap/cubemap", true);
-	auto skySmallColor = std::make_shared<Texture>(renderer, Cubemap, "resources/cubemap/cubemap_diff", true);
-
 	std::vector<std::shared_ptr<Texture>> textures = {
 		dragonColor, dragonNormal, dragonEffects,
 		suzanneColor, suzanneNormal, suzanneEffects,
@@ -76,9 +110,11 @@ Scene::Scene(GLFWwindow* window, uint32_t width, uint32_t height)
 	CreateBoxBlurRenderPass();
 	CreateBoxBlurFramebuffer();
 
+	auto pipelineStart = std::chrono::steady_clock::now();
 	CreatePipelines();
-
-	AllocateCommandBuffers();
+	std::cout << "Created " << pipelineBuilder->GetCreatedCount() << " pipelines (" << pipelineBuilder->GetSharedCount() << " shared) in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count()
+		<< " ms with a " << (renderer.IsPipelineCacheWarm() ? "warm" : "cold") << " pipeline cache" << std::endl;
 }
 
 uint32_t Scene::GetWidth() {
@@ -89,6 +125,24 @@ uint32_t Scene::GetHeight() {
 	return height;
 }
 
+double Scene::GetFrameTime() {
+	return renderer.GetFrameTime();
+}
+
+double Scene::GetWaitTime() {
+	return renderer.GetWaitTime();
+}
+
+double Scene::GetRecordTime() {
+	return recordTime;
+}
+
+void Scene::ToggleCommandReuse() {
+	reuseCommands = !reuseCommands;
+	Invalidate();
+	std::cout << (reuseCommands ? "Reusing recorded passes" : "Recording passes every frame") << std::endl;
+}
+
 Scene::~Scene() {
 	vkDeviceWaitIdle(renderer.device);
 	CleanupSwapchainResources();
@@ -97,14 +151,22 @@ Scene::~Scene() {
 	vkDestroyRenderPass(renderer.device, boxBlurRenderPass, nullptr);
 	vkDestroyFramebuffer(renderer.device, boxBlurFramebuffer, nullptr);
 	vkDestroyRenderPass(renderer.device, screenQuadRenderPass, nullptr);
+	vkDestroyCommandPool(renderer.device, commandPool, nullptr);
 	vkDestroyDescriptorSetLayout(renderer.device, uniformSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(renderer.device, objectSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(renderer.device, modelTextureSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(renderer.device, textureSetLayout, nullptr);
 	vkDestroySampler(renderer.device, sampler, nullptr);
 	DestroyPipelines();
+	pipelineBuilder.reset();	//and the shader modules
 }
 
 void Scene::CleanupSwapchainResources() {
+	if (!passCommandBuffers.empty()) {
+		vkFreeCommandBuffers(renderer.device, commandPool, static_cast<uint32_t>(passCommandBuffers.size()), passCommandBuffers.data());
+		passCommandBuffers.clear();
+	}
+	DestroyRecorders();
 	depth.reset();
 	geometryTarget.reset();
 	fxaaTarget.reset();
@@ -118,21 +180,27 @@ void Scene::CleanupSwapchainResources() {
 }
 
 void Scene::UploadResources(std::vector<std::shared_ptr<Texture>>& textures) {
-	VkCommandBuffer commandBuffer = renderer.GetSingleUseCommandBuffer();
-
-	std::vector<std::unique_ptr<StagingBuffer>> stagingBuffers;
+	UploadBatch batch = renderer.uploader->Begin();
 
 	for (auto& ptr : textures) {
-		ptr->UploadData(commandBuffer, stagingBuffers);
+		ptr->UploadData(batch);
 	}
 
-	dragon->UploadData(commandBuffer, stagingBuffers);
-	suzanne->UploadData(commandBuffer, stagingBuffers);
-	plane->UploadData(commandBuffer, stagingBuffers);
-	skybox->UploadData(commandBuffer, stagingBuffers);
-	quad->UploadData(commandBuffer, stagingBuffers);
-
-	renderer.SubmitCommandBuffer(commandBuffer);
+	dragon->UploadData(batch);
+	suzanne->UploadData(batch);
+	plane->UploadData(batch);
+	skybox->UploadData(batch);
+	quad->UploadData(batch);
+	dragonCuller->UploadData(batch);
+
+	//the textures are kept alive by the callback until then
+	renderer.uploader->Submit(batch, [this, textures](VkCommandBuffer commandBuffer) {
+		for (auto& ptr : textures) {
+			ptr->FinishUpload(commandBuffer);
+		}
+		loaded = true;
+		Invalidate();
+	});
 }
 
 void Scene::UpdateUniform() {
@@ -150,6 +218,17 @@ void Scene::UpdateUniform() {
 	lightUniform->lightId = light.GetId();
 	lightUniform->lightIs = light.GetIs();
 	lightUniform->lightShininess = light.GetShininess();
+
+	//the shaders only find the transforms here, so moving a model needs no new commands
+	ObjectData* objects = reinterpret_cast<ObjectData*>(objectBuffer->GetData());
+	for (Model* model : { dragon.get(), suzanne.get(), plane.get() }) {
+		ObjectData& object = objects[model->GetDrawId()];
+		object.matrix = model->GetTransform().GetWorldMatrix();
+		glm::mat4 normal = glm::transpose(glm::inverse(camera.GetView() * object.matrix));
+		for (int i = 0; i < 3; i++) {
+			object.normalMatrix[i] = normal[i];
+		}
+	}
 }
 
 void Scene::Update(double elapsed) {
@@ -157,16 +236,23 @@ void Scene::Update(double elapsed) {
 	input.Update(elapsed);
 	camera.Update();
 	light.SetPosition(glm::vec3(2.0f, (1.5f + sin(0.5*time)), 2.0f));
-	UpdateUniform();
 
 	suzanne->GetTransform().SetRotation(time, glm::vec3(0, 1, 0));
+
+	renderer.memory->ReleaseIdlePages();
+	renderer.memory->UpdateStats();
 }
 
 void Scene::Render() {
+	//the uniforms and the command buffer of this frame slot are written once the GPU is done with its previous use
 	renderer.Acquire();
-	uint32_t index = renderer.GetImageIndex();
-	RecordCommandBuffer(index);
-	renderer.Render(commandBuffers[index]);
+	UpdateUniform();
+
+	auto start = std::chrono::steady_clock::now();
+	VkCommandBuffer passes = RecordCommandBuffer(renderer.GetImageIndex());
+	recordTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	renderer.Render(passes);
 	renderer.Present();
 }
 
@@ -180,7 +266,6 @@ void Scene::Resize(uint32_t width, uint32_t height) {
 
 	createSwapchainResources(width, height);
 	RecreatePipelines();
-	AllocateCommandBuffers();
 }
 
 void Scene::createSwapchainResources(uint32_t width, uint32_t height) {
@@ -194,210 +279,422 @@ void Scene::createSwapchainResources(uint32_t width, uint32_t height) {
 	CreateFXAAFramebuffer(width, height);
 	geometryMat = std::make_unique<Material>(renderer, sampler, std::vector<std::shared_ptr<Texture>>{ geometryTarget });
 	fxaaMat = std::make_unique<Material>(renderer, sampler, std::vector<std::shared_ptr<Texture>>{ fxaaTarget });
+	AllocatePassCommandBuffers();
 }
 
-void Scene::AllocateCommandBuffers() {
-	if (commandBuffers.size() > 0) vkFreeCommandBuffers(renderer.device, renderer.commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-	commandBuffers.clear();
-	commandBuffers.resize(swapChainFramebuffers.size());
+void Scene::CreateCommandPool() {
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = renderer.graphicsFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(renderer.device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create command pool");
+	}
+}
+
+//one per frame slot and swapchain image: the uniforms are bound per slot, the main pass draws to the image
+void Scene::AllocatePassCommandBuffers() {
+	passCommandBuffers.resize(renderer.GetFrameCount() * renderer.swapchainImages.size());
 
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = renderer.commandPool;
+	allocInfo.commandPool = commandPool;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+	allocInfo.commandBufferCount = static_cast<uint32_t>(passCommandBuffers.size());
 
-	if (vkAllocateCommandBuffers(renderer.device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+	if (vkAllocateCommandBuffers(renderer.device, &allocInfo, passCommandBuffers.data()) != VK_SUCCESS) {
 		throw std::runtime_error("Could not allocate command buffers");
 	}
-}
-
-void Scene::RecordCommandBuffer(uint32_t imageIndex) {
-	VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
-
-	vkResetCommandBuffer(commandBuffer, 0);
 
-	VkCommandBufferBeginInfo beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	RecordDepthPass(commandBuffer);
-	RecordBoxBlurPass(commandBuffer);
-	RecordGeometryPass(commandBuffer);
-	RecordFXAAPass(commandBuffer);
-	RecordMainPass(commandBuffer, imageIndex);
-
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("Could not record command buffer");
-	}
+	recordedVersions.assign(passCommandBuffers.size(), 0);
 }
 
-void Scene::RecordDepthPass(VkCommandBuffer commandBuffer) {
-	VkRenderPassBeginInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = lightRenderPass;
-	renderPassInfo.framebuffer = lightFramebuffer;
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = { lightDepth->GetWidth(), lightDepth->GetHeight() };
-
-	VkClearValue clearColors[2];
-	clearColors[0].color = { 1.0f, 1.0f, 1.0f, 0.0f };
-	clearColors[1].depthStencil = { 1.0f, 0 };
-
-	renderPassInfo.clearValueCount = 2;
-	renderPassInfo.pClearValues = clearColors;
-
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-	VkViewport viewport = {};
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = static_cast<float>(lightDepth->GetWidth());
-	viewport.height = static_cast<float>(lightDepth->GetHeight());
-	viewport.minDepth = 0;
-	viewport.maxDepth = 1;
-
-	VkRect2D scissor = {};
-	scissor.extent.width = lightDepth->GetWidth();
-	scissor.extent.height = lightDepth->GetHeight();
-
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipeline);
-	camUniform->Bind(commandBuffer, lightPipelineLayout, 0);
-	lightUniform->Bind(commandBuffer, lightPipelineLayout, 1);
-
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-	dragon->Draw(commandBuffer, lightPipelineLayout, nullptr);
-	suzanne->Draw(commandBuffer, lightPipelineLayout, nullptr);
-	plane->Draw(commandBuffer, lightPipelineLayout, nullptr);
+//every recorded pass is recorded again the next time its frame slot and image come up
+void Scene::Invalidate() {
+	structureVersion++;
+}
 
-	vkCmdEndRenderPass(commandBuffer);
+//every level of detail picked while recording the passes, by DepthPass and GeometryPass
+std::vector<uint32_t> Scene::SelectLods() {
+	return {
+		dragon->SelectLod(camera, 0), dragon->SelectLod(camera, shadowLodBias),
+		suzanne->SelectLod(camera, 0), suzanne->SelectLod(camera, shadowLodBias),
+		plane->SelectLod(camera, 0), plane->SelectLod(camera, shadowLodBias)
+	};
 }
 
-void Scene::RecordBoxBlurPass(VkCommandBuffer commandBuffer) {
-	VkRenderPassBeginInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = boxBlurRenderPass;
-	renderPassInfo.framebuffer = boxBlurFramebuffer;
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = { boxBlur->GetWidth(), boxBlur->GetHeight() };
+//the command buffer of the frame slot is begun by Acquire and ended by Render. It gets the work that changes every frame
+//the passes follow in it, or come from a command buffer recorded in an earlier frame, which is returned to be submitted after it
+VkCommandBuffer Scene::RecordCommandBuffer(uint32_t imageIndex) {
+	VkCommandBuffer commandBuffer = renderer.GetCommandBuffer();
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	//finished uploads are handed over to this command buffer first
+	renderer.uploader->Update(commandBuffer);
 
-	VkViewport viewport = {};
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = static_cast<float>(boxBlur->GetWidth());
-	viewport.height = static_cast<float>(boxBlur->GetHeight());
-	viewport.minDepth = 0;
-	viewport.maxDepth = 1;
+	if (loaded) {
+		//moved resources get their new handles here, before anything is recorded with them
+		if (renderer.defragmenter->Step(commandBuffer)) Invalidate();
+		dragonCuller->Cull(commandBuffer, camera.GetProjection() * camera.GetView(), camera.GetPosition(), light.GetProjection() * light.GetView());
+	}
 
-	VkRect2D scissor = {};
-	scissor.extent.width = boxBlur->GetWidth();
-	scissor.extent.height = boxBlur->GetHeight();
+	//levels of detail are picked on the CPU, so a new one needs new draws
+	std::vector<uint32_t> lods = SelectLods();
+	if (lods != recordedLods) {
+		recordedLods = lods;
+		Invalidate();
+	}
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boxBlurPipeline);
-	lightMat->Bind(commandBuffer, screenQuadPipelineLayout, 0);
+	if (!reuseCommands) {
+		RecordPasses(commandBuffer, imageIndex);
+		return VK_NULL_HANDLE;
+	}
 
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	size_t index = renderer.GetFrameIndex() * renderer.swapchainImages.size() + imageIndex;
+	VkCommandBuffer passes = passCommandBuffers[index];
+	if (recordedVersions[index] != structureVersion) {
+		//it was last submitted with the fence of this frame slot, which Acquire waited on
+		vkResetCommandBuffer(passes, 0);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+		vkBeginCommandBuffer(passes, &beginInfo);
+		RecordPasses(passes, imageIndex);
+		if (vkEndCommandBuffer(passes) != VK_SUCCESS) {
+			throw std::runtime_error("Could not record command buffer");
+		}
+		recordedVersions[index] = structureVersion;
+	}
+	return passes;
+}
 
-	quad->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+void Scene::RecordPasses(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+	if (!loaded) {
+		RecordLoadingPass(commandBuffer, imageIndex);
+		return;
+	}
 
-	vkCmdEndRenderPass(commandBuffer);
+	std::vector<ScenePass> passes;
+	passes.push_back(DepthPass());
+	passes.push_back(BoxBlurPass());
+	passes.push_back(GeometryPass());
+	passes.push_back(FXAAPass());
+	passes.push_back(MainPass(imageIndex));
+
+	//every part gets the secondary command buffer of its recorder for this frame slot and image
+	size_t partCount = 0;
+	for (auto& pass : passes) partCount += pass.parts.size();
+	size_t index = renderer.GetFrameIndex() * renderer.swapchainImages.size() + imageIndex;
+	std::vector<VkCommandBuffer> secondaries = PrepareRecorders(partCount, index);
+
+	size_t part = 0;
+	for (auto& pass : passes) {
+		for (auto& record : pass.parts) {
+			VkCommandBuffer secondary = secondaries[part++];
+			VkRenderPass renderPass = pass.beginInfo.renderPass;
+			VkFramebuffer framebuffer = pass.beginInfo.framebuffer;
+			std::function<void(VkCommandBuffer)>* function = &record;
+
+			recordJobs->Run("record", [secondary, renderPass, framebuffer, function]() {
+				//previously executed by a command buffer of this frame slot, whose fence Acquire waited on
+				vkResetCommandBuffer(secondary, 0);
+
+				VkCommandBufferInheritanceInfo inheritanceInfo = {};
+				inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+				inheritanceInfo.renderPass = renderPass;
+				inheritanceInfo.subpass = 0;
+				inheritanceInfo.framebuffer = framebuffer;
+
+				VkCommandBufferBeginInfo beginInfo = {};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+				beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+				vkBeginCommandBuffer(secondary, &beginInfo);
+				(*function)(secondary);
+				if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+					throw std::runtime_error("Could not record secondary command buffer");
+				}
+			});
+		}
+	}
+	//the main thread records parts too while it waits
+	recordJobs->Wait();
+
+	//secondary command buffers can't begin render passes, so the passes themselves stay in the primary one
+	part = 0;
+	for (auto& pass : passes) {
+		pass.beginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+		pass.beginInfo.pClearValues = pass.clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &pass.beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(pass.parts.size()), &secondaries[part]);
+		vkCmdEndRenderPass(commandBuffer);
+		part += pass.parts.size();
+	}
 }
 
-void Scene::RecordGeometryPass(VkCommandBuffer commandBuffer) {
-	VkRenderPassBeginInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = geometryRenderPass;
-	renderPassInfo.framebuffer = geometryFramebuffer;
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = renderer.swapchainExtent;
+//one recorder per part, so the threads recording the parts never share a command pool
+std::vector<VkCommandBuffer> Scene::PrepareRecorders(size_t partCount, size_t index) {
+	size_t bufferCount = renderer.GetFrameCount() * renderer.swapchainImages.size();
+	while (recorders.size() < partCount) {
+		CommandRecorder recorder;
+
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = renderer.graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(renderer.device, &poolInfo, nullptr, &recorder.pool) != VK_SUCCESS) {
+			throw std::runtime_error("Could not create command pool");
+		}
+		recorder.commandBuffers.assign(bufferCount, VK_NULL_HANDLE);
+		recorders.push_back(recorder);
+	}
 
-	VkClearValue clearColors[2];
-	//clearColors[0] is ignored becaues the color attachment isn't being cleared
-	clearColors[1].depthStencil = { 1.0f, 0 };
-	renderPassInfo.clearValueCount = 2;
-	renderPassInfo.pClearValues = clearColors;
+	std::vector<VkCommandBuffer> secondaries(partCount);
+	for (size_t i = 0; i < partCount; i++) {
+		CommandRecorder& recorder = recorders[i];
+		if (recorder.commandBuffers[index] == VK_NULL_HANDLE) {
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = recorder.pool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(renderer.device, &allocInfo, &recorder.commandBuffers[index]) != VK_SUCCESS) {
+				throw std::runtime_error("Could not allocate command buffers");
+			}
+		}
+		secondaries[i] = recorder.commandBuffers[index];
+	}
+	return secondaries;
+}
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+void Scene::DestroyRecorders() {
+	//destroying a pool frees its command buffers
+	for (auto& recorder : recorders) {
+		vkDestroyCommandPool(renderer.device, recorder.pool, nullptr);
+	}
+	recorders.clear();
+}
 
-	VkViewport viewport = {};
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = static_cast<float>(width);
-	viewport.height = static_cast<float>(height);
-	viewport.minDepth = 0;
-	viewport.maxDepth = 1;
+//the draws are split in contiguous chunks, one per recording thread at most. Every chunk starts with setup,
+//since secondary command buffers inherit no state from each other
+void Scene::AddDrawParts(ScenePass& pass, std::function<void(VkCommandBuffer)> setup, std::vector<std::function<void(VkCommandBuffer)>> draws) {
+	size_t chunkCount = std::min(draws.size(), static_cast<size_t>(recordThreadCount));
+	auto shared = std::make_shared<std::vector<std::function<void(VkCommandBuffer)>>>(std::move(draws));
+	for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+		size_t begin = shared->size() * chunk / chunkCount;
+		size_t end = shared->size() * (chunk + 1) / chunkCount;
+		pass.parts.push_back([setup, shared, begin, end](VkCommandBuffer commandBuffer) {
+			setup(commandBuffer);
+			for (size_t i = begin; i < end; i++) {
+				(*shared)[i](commandBuffer);
+			}
+		});
+	}
+}
 
-	VkRect2D scissor = {};
-	scissor.extent = renderer.swapchainExtent;
+Scene::ScenePass Scene::DepthPass() {
+	ScenePass pass = {};
+	pass.beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	pass.beginInfo.renderPass = lightRenderPass;
+	pass.beginInfo.framebuffer = lightFramebuffer;
+	pass.beginInfo.renderArea.offset = { 0, 0 };
+	pass.beginInfo.renderArea.extent = { lightDepth->GetWidth(), lightDepth->GetHeight() };
+
+	pass.clearValues.resize(2);
+	pass.clearValues[0].color = { 1.0f, 1.0f, 1.0f, 0.0f };
+	pass.clearValues[1].depthStencil = { 1.0f, 0 };
+
+	AddDrawParts(pass, [this](VkCommandBuffer commandBuffer) {
+		VkViewport viewport = {};
+		viewport.x = 0;
+		viewport.y = 0;
+		viewport.width = static_cast<float>(lightDepth->GetWidth());
+		viewport.height = static_cast<float>(lightDepth->GetHeight());
+		viewport.minDepth = 0;
+		viewport.maxDepth = 1;
+
+		VkRect2D scissor = {};
+		scissor.extent.width = lightDepth->GetWidth();
+		scissor.extent.height = lightDepth->GetHeight();
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipeline);
+		camUniform->Bind(commandBuffer, lightPipelineLayout, 0);
+		lightUniform->Bind(commandBuffer, lightPipelineLayout, 1);
+		objectBuffer->Bind(commandBuffer, lightPipelineLayout, 2);
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}, {
+		[this](VkCommandBuffer commandBuffer) { dragonCuller->DrawLight(commandBuffer, lightPipelineLayout, &camera, shadowLodBias); },
+		[this](VkCommandBuffer commandBuffer) { suzanne->Draw(commandBuffer, lightPipelineLayout, &camera, shadowLodBias); },
+		[this](VkCommandBuffer commandBuffer) { plane->Draw(commandBuffer, lightPipelineLayout, &camera, shadowLodBias); }
+	});
+
+	return pass;
+}
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline);
-	camUniform->Bind(commandBuffer, modelPipelineLayout, 0);
-	lightUniform->Bind(commandBuffer, modelPipelineLayout, 1);
+Scene::ScenePass Scene::BoxBlurPass() {
+	ScenePass pass = {};
+	pass.beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	pass.beginInfo.renderPass = boxBlurRenderPass;
+	pass.beginInfo.framebuffer = boxBlurFramebuffer;
+	pass.beginInfo.renderArea.offset = { 0, 0 };
+	pass.beginInfo.renderArea.extent = { boxBlur->GetWidth(), boxBlur->GetHeight() };
+
+	pass.parts.push_back([this](VkCommandBuffer commandBuffer) {
+		VkViewport viewport = {};
+		viewport.x = 0;
+		viewport.y = 0;
+		viewport.width = static_cast<float>(boxBlur->GetWidth());
+		viewport.height = static_cast<float>(boxBlur->GetHeight());
+		viewport.minDepth = 0;
+		viewport.maxDepth = 1;
+
+		VkRect2D scissor = {};
+		scissor.extent.width = boxBlur->GetWidth();
+		scissor.extent.height = boxBlur->GetHeight();
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boxBlurPipeline);
+		lightMat->Bind(commandBuffer, screenQuadPipelineLayout, 0);
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		quad->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+	});
+
+	return pass;
+}
 
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+Scene::ScenePass Scene::GeometryPass() {
+	ScenePass pass = {};
+	pass.beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	pass.beginInfo.renderPass = geometryRenderPass;
+	pass.beginInfo.framebuffer = geometryFramebuffer;
+	pass.beginInfo.renderArea.offset = { 0, 0 };
+	pass.beginInfo.renderArea.extent = renderer.swapchainExtent;
+
+	pass.clearValues.resize(2);
+	//clearValues[0] is ignored becaues the color attachment isn't being cleared
+	pass.clearValues[1].depthStencil = { 1.0f, 0 };
+
+	//each draw binds its own pipeline, since a chunk can start with any of them
+	AddDrawParts(pass, [this](VkCommandBuffer commandBuffer) {
+		VkViewport viewport = {};
+		viewport.x = 0;
+		viewport.y = 0;
+		viewport.width = static_cast<float>(width);
+		viewport.height = static_cast<float>(height);
+		viewport.minDepth = 0;
+		viewport.maxDepth = 1;
+
+		VkRect2D scissor = {};
+		scissor.extent = renderer.swapchainExtent;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline);
+		camUniform->Bind(commandBuffer, modelPipelineLayout, 0);
+		lightUniform->Bind(commandBuffer, modelPipelineLayout, 1);
+		objectBuffer->Bind(commandBuffer, modelPipelineLayout, 3);
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}, {
+		[this](VkCommandBuffer commandBuffer) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline);
+			dragonMat->Bind(commandBuffer, modelPipelineLayout, 2);
+			dragonCuller->DrawCamera(commandBuffer, modelPipelineLayout, &camera);
+		},
+		[this](VkCommandBuffer commandBuffer) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline);
+			suzanneMat->Bind(commandBuffer, modelPipelineLayout, 2);
+			suzanne->Draw(commandBuffer, modelPipelineLayout, &camera);
+		},
+		[this](VkCommandBuffer commandBuffer) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, planePipeline);
+			planeMat->Bind(commandBuffer, modelPipelineLayout, 2);
+			plane->Draw(commandBuffer, modelPipelineLayout, &camera);
+		},
+		[this](VkCommandBuffer commandBuffer) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipeline);
+			skyboxMat->Bind(commandBuffer, skyboxPipelineLayout, 1);
+			skybox->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+		}
+	});
+
+	return pass;
+}
 
-	dragonMat->Bind(commandBuffer, modelPipelineLayout, 2);
-	dragon->Draw(commandBuffer, modelPipelineLayout, &camera);
+Scene::ScenePass Scene::FXAAPass() {
+	ScenePass pass = {};
+	pass.beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	pass.beginInfo.renderPass = screenQuadRenderPass;
+	pass.beginInfo.framebuffer = fxaaFramebuffer;
+	pass.beginInfo.renderArea.offset = { 0, 0 };
+	pass.beginInfo.renderArea.extent = renderer.swapchainExtent;
 
-	suzanneMat->Bind(commandBuffer, modelPipelineLayout, 2);
-	suzanne->Draw(commandBuffer, modelPipelineLayout, &camera);
+	pass.parts.push_back([this](VkCommandBuffer commandBuffer) {
+		VkViewport viewport = {};
+		viewport.x = 0;
+		viewport.y = 0;
+		viewport.width = static_cast<float>(width);
+		viewport.height = static_cast<float>(height);
+		viewport.minDepth = 0;
+		viewport.maxDepth = 1;
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, planePipeline);
-	planeMat->Bind(commandBuffer, modelPipelineLayout, 2);
-	plane->Draw(commandBuffer, modelPipelineLayout, &camera);
+		VkRect2D scissor = {};
+		scissor.extent = renderer.swapchainExtent;
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipeline);
-	skyboxMat->Bind(commandBuffer, skyboxPipelineLayout, 1);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, fxaaPipeline);
+		geometryMat->Bind(commandBuffer, screenQuadPipelineLayout, 0);
 
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	skybox->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+		quad->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+	});
 
-	vkCmdEndRenderPass(commandBuffer);
+	return pass;
 }
 
-void Scene::RecordFXAAPass(VkCommandBuffer commandBuffer) {
-	VkRenderPassBeginInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = screenQuadRenderPass;
-	renderPassInfo.framebuffer = fxaaFramebuffer;
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = renderer.swapchainExtent;
-
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+Scene::ScenePass Scene::MainPass(uint32_t imageIndex) {
+	ScenePass pass = {};
+	pass.beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	pass.beginInfo.renderPass = mainRenderPass;
+	pass.beginInfo.framebuffer = swapChainFramebuffers[imageIndex];
+	pass.beginInfo.renderArea.offset = { 0, 0 };
+	pass.beginInfo.renderArea.extent = renderer.swapchainExtent;
 
-	VkViewport viewport = {};
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = static_cast<float>(width);
-	viewport.height = static_cast<float>(height);
-	viewport.minDepth = 0;
-	viewport.maxDepth = 1;
+	pass.parts.push_back([this](VkCommandBuffer commandBuffer) {
+		VkViewport viewport = {};
+		viewport.x = 0;
+		viewport.y = 0;
+		viewport.width = static_cast<float>(width);
+		viewport.height = static_cast<float>(height);
+		viewport.minDepth = 0;
+		viewport.maxDepth = 1;
 
-	VkRect2D scissor = {};
-	scissor.extent = renderer.swapchainExtent;
+		VkRect2D scissor = {};
+		scissor.extent = renderer.swapchainExtent;
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, fxaaPipeline);
-	geometryMat->Bind(commandBuffer, screenQuadPipelineLayout, 0);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, finalPipeline);
+		fxaaMat->Bind(commandBuffer, screenQuadPipelineLayout, 0);
 
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	quad->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+		quad->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+	});
 
-	vkCmdEndRenderPass(commandBuffer);
+	return pass;
 }
 
-void Scene::RecordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+//the main pass does not clear, so it is cleared by hand while nothing can be drawn
+void Scene::RecordLoadingPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
 	VkRenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = mainRenderPass;
@@ -407,24 +704,17 @@ void Scene::RecordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
 
 	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	VkViewport viewport = {};
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = static_cast<float>(width);
-	viewport.height = static_cast<float>(height);
-	viewport.minDepth = 0;
-	viewport.maxDepth = 1;
-
-	VkRect2D scissor = {};
-	scissor.extent = renderer.swapchainExtent;
+	VkClearAttachment clear = {};
+	clear.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	clear.colorAttachment = 0;
+	clear.clearValue.color = { 0.0f, 0.0f, 0.0f, 1.0f };
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, finalPipeline);
-	fxaaMat->Bind(commandBuffer, screenQuadPipelineLayout, 0);
+	VkClearRect rect = {};
+	rect.rect.extent = renderer.swapchainExtent;
+	rect.baseArrayLayer = 0;
+	rect.layerCount = 1;
 
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-	quad->Draw(commandBuffer, VK_NULL_HANDLE, nullptr);
+	vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &rect);
 
 	vkCmdEndRenderPass(commandBuffer);
 }
@@ -788,6 +1078,23 @@ void Scene::CreateUniformSetLayout() {
 	}
 }
 
+void Scene::CreateObjectSetLayout() {
+	VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+	objectLayoutBinding.binding = 0;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &objectLayoutBinding;
+
+	if (vkCreateDescriptorSetLayout(renderer.device, &layoutInfo, nullptr, &objectSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create object set layout");
+	}
+}
+
 void Scene::CreateModelTextureSetLayout() {
 	std::vector<VkDescriptorSetLayoutBinding> bindings(6);
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <functional>
 #include "Renderer.h"
 #include "Model.h"
 #include "Texture.h"
@@ -9,7 +10,11 @@
 #include "Light.h"
 #include "Material.h"
 #include "UniformBuffer.h"
-#include "StagingBuffer.h"
+#include "StagingRing.h"
+#include "Uploader.h"
+#include "MeshletCuller.h"
+#include "JobSystem.h"
+#include "PipelineBuilder.h"
 
 struct CameraUniform {
 	glm::mat4 camProjection;
@@ -28,9 +33,15 @@ struct LightUniform {
 	float lightShininess;
 };
 
+//per-object data of the model shaders, indexed by the draw ID of each model
+struct ObjectData {
+	glm::mat4 matrix;
+	glm::vec4 normalMatrix[3];	//mat3 in glsl has the same layout as 3 vec4's, where the W component is padding
+};
+
 class Scene {
 public:
-	Scene(GLFWwindow* window, uint32_t width, uint32_t height);
+	Scene(GLFWwindow* window, uint32_t width, uint32_t height, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
 	~Scene();
 
 	void Update(double elapsed);
@@ -39,6 +50,17 @@ public:
 
 	uint32_t GetWidth();
 	uint32_t GetHeight();
+	//of the last frame, in milliseconds. The wait is the time the CPU was blocked on the GPU, it is close to 0 while they overlap
+	double GetFrameTime();
+	double GetWaitTime();
+	//CPU time spent recording command buffers in the last frame, in milliseconds
+	double GetRecordTime();
+
+	//switches between recording the passes every frame and reusing the ones recorded in earlier frames
+	void ToggleCommandReuse();
+
+	//prints the time to create every pipeline with an empty pipeline cache, then with the one of the renderer
+	void BenchmarkPipelines();
 
 private:
 	uint32_t width;
@@ -47,11 +69,13 @@ private:
 	Camera camera;
 	Input input;
 	float time;
+	bool loaded;	//set once the upload of every model and texture is done, only the main pass is cleared until then
 
 	Light light;
 
 	std::unique_ptr<UniformBuffer> camUniform;
 	std::unique_ptr<UniformBuffer> lightUniform;
+	std::unique_ptr<UniformBuffer> objectBuffer;
 
 	std::unique_ptr<Model> dragon;
 	std::unique_ptr<Model> suzanne;
@@ -59,6 +83,8 @@ private:
 	std::unique_ptr<Model> skybox;
 	std::unique_ptr<Model> quad;
 
+	std::unique_ptr<MeshletCuller> dragonCuller;
+
 	std::unique_ptr<Material> dragonMat;
 	std::unique_ptr<Material> suzanneMat;
 	std::unique_ptr<Material> planeMat;
@@ -79,9 +105,9 @@ private:
 
 	VkRenderPass mainRenderPass;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
-	std::vector<VkCommandBuffer> commandBuffers;
 	VkSampler sampler;
 	VkDescriptorSetLayout uniformSetLayout;
+	VkDescriptorSetLayout objectSetLayout;
 	VkDescriptorSetLayout modelTextureSetLayout;
 	VkDescriptorSetLayout textureSetLayout;
 
@@ -97,6 +123,32 @@ private:
 	VkRenderPass screenQuadRenderPass;
 	VkFramebuffer fxaaFramebuffer;
 
+	//the passes are recorded once per frame slot and swapchain image, and again only when structureVersion changes
+	bool reuseCommands;
+	VkCommandPool commandPool;
+	std::vector<VkCommandBuffer> passCommandBuffers;	//frame slot * swapchain image count + image index
+	std::vector<uint64_t> recordedVersions;
+	uint64_t structureVersion;
+	std::vector<uint32_t> recordedLods;
+	double recordTime;
+
+	//a render pass, whose content is split in parts recorded in parallel into secondary command buffers
+	struct ScenePass {
+		VkRenderPassBeginInfo beginInfo;	//clear values are set when it begins
+		std::vector<VkClearValue> clearValues;
+		std::vector<std::function<void(VkCommandBuffer)>> parts;
+	};
+
+	//command pools can only be used by one thread at a time, so every part of the passes is recorded from its own
+	struct CommandRecorder {
+		VkCommandPool pool;
+		std::vector<VkCommandBuffer> commandBuffers;	//secondary, frame slot * swapchain image count + image index
+	};
+
+	std::unique_ptr<JobSystem> recordJobs;
+	unsigned int recordThreadCount;
+	std::vector<CommandRecorder> recorders;
+
 	void UploadResources(std::vector<std::shared_ptr<Texture>>& textures);
 	void UpdateUniform();
 
@@ -110,15 +162,24 @@ private:
 	void CreateFXAAFramebuffer(uint32_t width, uint32_t height);
 	void CreateMainRenderPass();
 	void CreateMainFramebuffers(uint32_t width, uint32_t height);
-	void AllocateCommandBuffers();
-	void RecordCommandBuffer(uint32_t imageIndex);
-	void RecordDepthPass(VkCommandBuffer commandBuffer);
-	void RecordBoxBlurPass(VkCommandBuffer commandBuffer);
-	void RecordGeometryPass(VkCommandBuffer commandBuffer);
-	void RecordFXAAPass(VkCommandBuffer commandBuffer);
-	void RecordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void CreateCommandPool();
+	void AllocatePassCommandBuffers();
+	void Invalidate();
+	std::vector<uint32_t> SelectLods();
+	VkCommandBuffer RecordCommandBuffer(uint32_t imageIndex);
+	void RecordPasses(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	std::vector<VkCommandBuffer> PrepareRecorders(size_t partCount, size_t index);
+	void DestroyRecorders();
+	void AddDrawParts(ScenePass& pass, std::function<void(VkCommandBuffer)> setup, std::vector<std::function<void(VkCommandBuffer)>> draws);
+	ScenePass DepthPass();
+	ScenePass BoxBlurPass();
+	ScenePass GeometryPass();
+	ScenePass FXAAPass();
+	ScenePass MainPass(uint32_t imageIndex);
+	void RecordLoadingPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 	void CreateSampler();
 	void CreateUniformSetLayout();
+	void CreateObjectSetLayout();
 	void CreateModelTextureSetLayout();
 	void CreateTextureSetLayout();
 
@@ -137,19 +198,20 @@ private:
 	VkPipeline boxBlurPipeline;
 	VkPipeline fxaaPipeline;
 	VkPipeline finalPipeline;
+	std::unique_ptr<PipelineBuilder> pipelineBuilder;
 	void CreatePipelines();
 	void DestroyPipelines();
 	void RecreatePipelines();
 	void CreateModelPipelineLayout();
-	void CreateModelPipeline();
-	void CreatePlanePipeline();
 	void CreateSkyboxPipelineLayout();
-	void CreateSkyboxPipeline();
 	void CreateLightPipelineLayout();
-	void CreateLightPipeline();
 	void CreateScreenQuadPipelineLayout();
-	void CreateBoxBlurPipeline();
-	void CreateFXAAPipeline();
-	void CreateFinalPipeline();
+	PipelineDescription ModelPipeline();
+	PipelineDescription PlanePipeline();
+	PipelineDescription SkyboxPipeline();
+	PipelineDescription LightPipeline();
+	PipelineDescription BoxBlurPipeline();
+	PipelineDescription FXAAPipeline();
+	PipelineDescription FinalPipeline();
 };
 
@@ -1,51 +1,93 @@
 #include "Scene.h"
+#include <iostream>
+#include <chrono>
 
+//the layouts first, then every pipeline at once, so they compile in parallel
 void Scene::CreatePipelines() {
-	fxaaPipeline = VK_NULL_HANDLE;
-	finalPipeline = VK_NULL_HANDLE;
 	CreateModelPipelineLayout();
-	CreateModelPipeline();
-	CreatePlanePipeline();
 	CreateSkyboxPipelineLayout();
-	CreateSkyboxPipeline();
 	CreateLightPipelineLayout();
-	CreateLightPipeline();
 	CreateScreenQuadPipelineLayout();
-	CreateBoxBlurPipeline();
-	CreateFXAAPipeline();
-	CreateFinalPipeline();
+
+	pipelineBuilder->Add(ModelPipeline(), &modelPipeline);
+	pipelineBuilder->Add(PlanePipeline(), &planePipeline);
+	pipelineBuilder->Add(SkyboxPipeline(), &skyboxPipeline);
+	pipelineBuilder->Add(LightPipeline(), &lightPipeline);
+	pipelineBuilder->Add(BoxBlurPipeline(), &boxBlurPipeline);
+	pipelineBuilder->Add(FXAAPipeline(), &fxaaPipeline);
+	pipelineBuilder->Add(FinalPipeline(), &finalPipeline);
+	pipelineBuilder->Build(*recordJobs);
 }
 
 void Scene::DestroyPipelines() {
 	vkDestroyPipelineLayout(renderer.device, modelPipelineLayout, nullptr);
-	vkDestroyPipeline(renderer.device, modelPipeline, nullptr);
-	vkDestroyPipeline(renderer.device, planePipeline, nullptr);
 	vkDestroyPipelineLayout(renderer.device, skyboxPipelineLayout, nullptr);
-	vkDestroyPipeline(renderer.device, skyboxPipeline, nullptr);
 	vkDestroyPipelineLayout(renderer.device, lightPipelineLayout, nullptr);
-	vkDestroyPipeline(renderer.device, lightPipeline, nullptr);
 	vkDestroyPipelineLayout(renderer.device, screenQuadPipelineLayout, nullptr);
-	vkDestroyPipeline(renderer.device, boxBlurPipeline, nullptr);
-	vkDestroyPipeline(renderer.device, fxaaPipeline, nullptr);
-	vkDestroyPipeline(renderer.device, finalPipeline, nullptr);
+	pipelineBuilder->Release(modelPipeline);
+	pipelineBuilder->Release(planePipeline);
+	pipelineBuilder->Release(skyboxPipeline);
+	pipelineBuilder->Release(lightPipeline);
+	pipelineBuilder->Release(boxBlurPipeline);
+	pipelineBuilder->Release(fxaaPipeline);
+	pipelineBuilder->Release(finalPipeline);
 }
 
 void Scene::RecreatePipelines() {
-	//only these pipelines depend on Renderer's state via their specialization constants
-	CreateFXAAPipeline();
-	CreateFinalPipeline();
+	//only these pipelines depend on Renderer's state via their specialization constants and the main render pass
+	//the new ones are built before the old ones are released, so a description that didn't change keeps its pipeline
+	VkPipeline oldFXAA = fxaaPipeline;
+	VkPipeline oldFinal = finalPipeline;
+	pipelineBuilder->Add(FXAAPipeline(), &fxaaPipeline);
+	pipelineBuilder->Add(FinalPipeline(), &finalPipeline);
+	pipelineBuilder->Build(*recordJobs);
+	pipelineBuilder->Release(oldFXAA);
+	pipelineBuilder->Release(oldFinal);
+}
+
+//the driver may keep its own cache on disk, in which case the cold run is not entirely cold
+void Scene::BenchmarkPipelines() {
+	VkPipelineCache shared = renderer.pipelineCache;
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	VkPipelineCache empty;
+	if (vkCreatePipelineCache(renderer.device, &createInfo, nullptr, &empty) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create pipeline cache");
+	}
+
+	vkDeviceWaitIdle(renderer.device);
+	DestroyPipelines();
+
+	renderer.pipelineCache = empty;
+	auto start = std::chrono::steady_clock::now();
+	CreatePipelines();
+	double cold = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	DestroyPipelines();
+
+	//holds every pipeline by now, even if it started empty
+	renderer.pipelineCache = shared;
+	start = std::chrono::steady_clock::now();
+	CreatePipelines();
+	double warm = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	vkDestroyPipelineCache(renderer.device, empty, nullptr);
+	Invalidate();
+
+	std::cout << "Pipeline creation: " << cold << " ms cold, " << warm << " ms warm" << std::endl;
 }
 
 void Scene::CreateModelPipelineLayout() {
-	VkDescriptorSetLayout setLayouts[] = { uniformSetLayout, uniformSetLayout, modelTextureSetLayout };
+	VkDescriptorSetLayout setLayouts[] = { uniformSetLayout, uniformSetLayout, modelTextureSetLayout, objectSetLayout };
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 3;
+	pipelineLayoutInfo.setLayoutCount = 4;
 	pipelineLayoutInfo.pSetLayouts = setLayouts;
 
 	VkPushConstantRange pushConstantInfo;
 	pushConstantInfo.offset = 0;
-	pushConstantInfo.size = sizeof(glm::mat4) + sizeof(glm::vec4) * 3;	//size of mat3 under std430 rules
+	pushConstantInfo.size = sizeof(uint32_t);	//draw ID
 	pushConstantInfo.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 	pipelineLayoutInfo.pushConstantRangeCount = 1;
@@ -56,216 +98,6 @@ void Scene::CreateModelPipelineLayout() {
 	}
 }
 
-void Scene::CreateModelPipeline() {
-	VkShaderModule vert = CreateShaderModule(renderer.device, "resources/shaders/object.vert.spv");
-	VkShaderModule frag = CreateShaderModule(renderer.device, "resources/shaders/object.frag.spv");
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vert;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = frag;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	auto bindings = dragon->GetBindingDescriptions();
-	auto attributes = dragon->GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-	vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.stencilTestEnable = VK_FALSE;
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = modelPipelineLayout;
-	pipelineInfo.renderPass = geometryRenderPass;
-	pipelineInfo.subpass = 0;
-
-	if (vkCreateGraphicsPipelines(renderer.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &modelPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create graphics pipeline");
-	}
-
-	vkDestroyShaderModule(renderer.device, vert, nullptr);
-	vkDestroyShaderModule(renderer.device, frag, nullptr);
-}
-
-void Scene::CreatePlanePipeline() {
-	VkShaderModule vert = CreateShaderModule(renderer.device, "resources/shaders/plane.vert.spv");
-	VkShaderModule frag = CreateShaderModule(renderer.device, "resources/shaders/plane.frag.spv");
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vert;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = frag;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	auto bindings = plane->GetBindingDescriptions();
-	auto attributes = plane->GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-	vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.stencilTestEnable = VK_FALSE;
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = modelPipelineLayout;
-	pipelineInfo.renderPass = geometryRenderPass;
-	pipelineInfo.subpass = 0;
-
-	if (vkCreateGraphicsPipelines(renderer.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &planePipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create graphics pipeline");
-	}
-
-	vkDestroyShaderModule(renderer.device, vert, nullptr);
-	vkDestroyShaderModule(renderer.device, frag, nullptr);
-}
-
 void Scene::CreateSkyboxPipelineLayout() {
 	VkDescriptorSetLayout setLayouts[] = { uniformSetLayout, textureSetLayout };
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
@@ -278,121 +110,16 @@ void Scene::CreateSkyboxPipelineLayout() {
 	}
 }
 
-void Scene::CreateSkyboxPipeline() {
-	VkShaderModule vert = CreateShaderModule(renderer.device, "resources/shaders/cube.vert.spv");
-	VkShaderModule frag = CreateShaderModule(renderer.device, "resources/shaders/cube.frag.spv");
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vert;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = frag;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	auto bindings = skybox->GetBindingDescriptions();
-	auto attributes = skybox->GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-	vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_NONE;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_FALSE;	//no need to write to the depth buffer
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.stencilTestEnable = VK_FALSE;
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = skyboxPipelineLayout;
-	pipelineInfo.renderPass = geometryRenderPass;
-	pipelineInfo.subpass = 0;
-
-	if (vkCreateGraphicsPipelines(renderer.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &skyboxPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create graphics pipeline");
-	}
-
-	vkDestroyShaderModule(renderer.device, vert, nullptr);
-	vkDestroyShaderModule(renderer.device, frag, nullptr);
-}
-
 void Scene::CreateLightPipelineLayout() {
-	VkDescriptorSetLayout layouts[] = { uniformSetLayout, uniformSetLayout };
+	VkDescriptorSetLayout layouts[] = { uniformSetLayout, uniformSetLayout, objectSetLayout };
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 2;
+	pipelineLayoutInfo.setLayoutCount = 3;
 	pipelineLayoutInfo.pSetLayouts = layouts;
 
 	VkPushConstantRange pushConstantInfo = {};
 	pushConstantInfo.offset = 0;
-	pushConstantInfo.size = sizeof(glm::mat4);
+	pushConstantInfo.size = sizeof(uint32_t);	//draw ID
 	pushConstantInfo.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 	pipelineLayoutInfo.pushConstantRangeCount = 1;
@@ -403,111 +130,6 @@ void Scene::CreateLightPipelineLayout() {
 	}
 }
 
-void Scene::CreateLightPipeline() {
-	VkShaderModule vert = CreateShaderModule(renderer.device, "resources/shaders/object_depth.vert.spv");
-	VkShaderModule frag = CreateShaderModule(renderer.device, "resources/shaders/object_depth.frag.spv");
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vert;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = frag;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	auto bindings = Model::GetDepthBindingDescriptions();
-	auto attributes = Model::GetDepthAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-	vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.stencilTestEnable = VK_FALSE;
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = lightPipelineLayout;
-	pipelineInfo.renderPass = lightRenderPass;
-	pipelineInfo.subpass = 0;
-
-	if (vkCreateGraphicsPipelines(renderer.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &lightPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create graphics pipeline");
-	}
-
-	vkDestroyShaderModule(renderer.device, vert, nullptr);
-	vkDestroyShaderModule(renderer.device, frag, nullptr);
-}
-
 void Scene::CreateScreenQuadPipelineLayout() {
 	VkDescriptorSetLayout setLayouts[] = { textureSetLayout };
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
@@ -520,344 +142,97 @@ void Scene::CreateScreenQuadPipelineLayout() {
 	}
 }
 
-void Scene::CreateBoxBlurPipeline() {
-	VkShaderModule vert = CreateShaderModule(renderer.device, "resources/shaders/boxblur.vert.spv");
-	VkShaderModule frag = CreateShaderModule(renderer.device, "resources/shaders/boxblur.frag.spv");
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vert;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = frag;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	auto bindings = quad->GetBindingDescriptions();
-	auto attributes = quad->GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-	vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_NONE;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = screenQuadPipelineLayout;
-	pipelineInfo.renderPass = boxBlurRenderPass;
-	pipelineInfo.subpass = 0;
-
-	if (vkCreateGraphicsPipelines(renderer.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &boxBlurPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create graphics pipeline");
-	}
-
-	vkDestroyShaderModule(renderer.device, vert, nullptr);
-	vkDestroyShaderModule(renderer.device, frag, nullptr);
+PipelineDescription Scene::ModelPipeline() {
+	PipelineDescription description;
+	description.vertexShader = dragon->GetVertexFormat() == VertexFormat::Packed ? "resources/shaders/object_packed.vert.spv" : "resources/shaders/object.vert.spv";
+	description.fragmentShader = "resources/shaders/object.frag.spv";
+	description.bindings = dragon->GetBindingDescriptions();
+	description.attributes = dragon->GetAttributeDescriptions();
+	description.depthTest = true;
+	description.depthWrite = true;
+	description.layout = modelPipelineLayout;
+	description.renderPass = geometryRenderPass;
+	return description;
 }
 
-void Scene::CreateFXAAPipeline() {
-	VkShaderModule vert = CreateShaderModule(renderer.device, "resources/shaders/screenquad.vert.spv");
-	VkShaderModule frag = CreateShaderModule(renderer.device, "resources/shaders/fxaa.frag.spv");
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vert;
-	vertShaderStageInfo.pName = "main";
-
-	float specializationData[2] = { 1.0f / renderer.swapchainExtent.width, 1.0f / renderer.swapchainExtent.height };
-
-	VkSpecializationMapEntry entries[2];
-	entries[0].constantID = 0;
-	entries[0].offset = 0;
-	entries[0].size = sizeof(float);
-	entries[1].constantID = 1;
-	entries[1].offset = sizeof(float);
-	entries[1].size = sizeof(float);
-
-	VkSpecializationInfo specialization = {};
-	specialization.dataSize = sizeof(specializationData);
-	specialization.pData = &specializationData;
-	specialization.mapEntryCount = 2;
-	specialization.pMapEntries = entries;
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = frag;
-	fragShaderStageInfo.pName = "main";
-	fragShaderStageInfo.pSpecializationInfo = &specialization;	//use specialization constants
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	auto bindings = quad->GetBindingDescriptions();
-	auto attributes = quad->GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-	vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_NONE;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkPipeline oldPipeline = fxaaPipeline;
-
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = screenQuadPipelineLayout;
-	pipelineInfo.renderPass = screenQuadRenderPass;
-	pipelineInfo.basePipelineHandle = oldPipeline;
-	pipelineInfo.subpass = 0;
-
-	if (vkCreateGraphicsPipelines(renderer.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &fxaaPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create graphics pipeline");
-	}
-
-	vkDestroyShaderModule(renderer.device, vert, nullptr);
-	vkDestroyShaderModule(renderer.device, frag, nullptr);
-
-	if (oldPipeline != VK_NULL_HANDLE) {
-		vkDestroyPipeline(renderer.device, oldPipeline, nullptr);
-	}
+PipelineDescription Scene::PlanePipeline() {
+	PipelineDescription description;
+	description.vertexShader = plane->GetVertexFormat() == VertexFormat::Packed ? "resources/shaders/plane_packed.vert.spv" : "resources/shaders/plane.vert.spv";
+	description.fragmentShader = "resources/shaders/plane.frag.spv";
+	description.bindings = plane->GetBindingDescriptions();
+	description.attributes = plane->GetAttributeDescriptions();
+	description.depthTest = true;
+	description.depthWrite = true;
+	description.layout = modelPipelineLayout;
+	description.renderPass = geometryRenderPass;
+	return description;
 }
 
-void Scene::CreateFinalPipeline() {
-	VkShaderModule vert = CreateShaderModule(renderer.device, "resources/shaders/screenquad.vert.spv");
-	VkShaderModule frag = CreateShaderModule(renderer.device, "resources/shaders/final_screenquad.frag.spv");
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vert;
-	vertShaderStageInfo.pName = "main";
-
-	struct Gamma {
-		uint32_t enableGamma;	//glsl bool is 32 bits
-		float gamma;
-	} gamma;
-
-	gamma.enableGamma = !renderer.IsGamma();
-	gamma.gamma = 2.2f;
-
-	VkSpecializationMapEntry entries[2];
-	entries[0].constantID = 0;
-	entries[0].offset = 0;
-	entries[0].size = sizeof(uint32_t);
-	entries[1].constantID = 1;
-	entries[1].offset = sizeof(uint32_t);
-	entries[1].size = sizeof(float);
-
-	VkSpecializationInfo specialization = {};
-	specialization.dataSize = sizeof(Gamma);
-	specialization.pData = &gamma;
-	specialization.mapEntryCount = 2;
-	specialization.pMapEntries = entries;
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = frag;
-	fragShaderStageInfo.pName = "main";
-	fragShaderStageInfo.pSpecializationInfo = &specialization;
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	auto bindings = quad->GetBindingDescriptions();
-	auto attributes = quad->GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
-	vertexInputInfo.pVertexBindingDescriptions = bindings.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_NONE;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkPipeline oldPipeline = finalPipeline;
+PipelineDescription Scene::SkyboxPipeline() {
+	PipelineDescription description;
+	description.vertexShader = "resources/shaders/cube.vert.spv";
+	description.fragmentShader = "resources/shaders/cube.frag.spv";
+	description.bindings = skybox->GetBindingDescriptions();
+	description.attributes = skybox->GetAttributeDescriptions();
+	description.cullMode = VK_CULL_MODE_NONE;
+	description.depthTest = true;
+	description.depthWrite = false;	//no need to write to the depth buffer
+	description.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	description.layout = skyboxPipelineLayout;
+	description.renderPass = geometryRenderPass;
+	return description;
+}
 
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = screenQuadPipelineLayout;
-	pipelineInfo.renderPass = mainRenderPass;
-	pipelineInfo.basePipelineHandle = oldPipeline;
-	pipelineInfo.subpass = 0;
+PipelineDescription Scene::LightPipeline() {
+	PipelineDescription description;
+	description.vertexShader = "resources/shaders/object_depth.vert.spv";
+	description.fragmentShader = "resources/shaders/object_depth.frag.spv";
+	description.bindings = Model::GetDepthBindingDescriptions();
+	description.attributes = Model::GetDepthAttributeDescriptions();
+	description.depthTest = true;
+	description.depthWrite = true;
+	description.layout = lightPipelineLayout;
+	description.renderPass = lightRenderPass;
+	return description;
+}
 
-	if (vkCreateGraphicsPipelines(renderer.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &finalPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create graphics pipeline");
-	}
+PipelineDescription Scene::BoxBlurPipeline() {
+	PipelineDescription description;
+	description.vertexShader = "resources/shaders/boxblur.vert.spv";
+	description.fragmentShader = "resources/shaders/boxblur.frag.spv";
+	description.bindings = quad->GetBindingDescriptions();
+	description.attributes = quad->GetAttributeDescriptions();
+	description.cullMode = VK_CULL_MODE_NONE;
+	description.layout = screenQuadPipelineLayout;
+	description.renderPass = boxBlurRenderPass;
+	return description;
+}
 
-	vkDestroyShaderModule(renderer.device, vert, nullptr);
-	vkDestroyShaderModule(renderer.device, frag, nullptr);
+PipelineDescription Scene::FXAAPipeline() {
+	PipelineDescription description;
+	description.vertexShader = "resources/shaders/screenquad.vert.spv";
+	description.fragmentShader = "resources/shaders/fxaa.frag.spv";
+	description.bindings = quad->GetBindingDescriptions();
+	description.attributes = quad->GetAttributeDescriptions();
+	description.cullMode = VK_CULL_MODE_NONE;
+	//size of a pixel
+	description.Specialize(1.0f / renderer.swapchainExtent.width);
+	description.Specialize(1.0f / renderer.swapchainExtent.height);
+	description.layout = screenQuadPipelineLayout;
+	description.renderPass = screenQuadRenderPass;
+	return description;
+}
 
-	if (oldPipeline != VK_NULL_HANDLE) {
-		vkDestroyPipeline(renderer.device, oldPipeline, nullptr);
-	}
-}
\ No newline at end of file
+PipelineDescription Scene::FinalPipeline() {
+	PipelineDescription description;
+	description.vertexShader = "resources/shaders/screenquad.vert.spv";
+	description.fragmentShader = "resources/shaders/final_screenquad.frag.spv";
+	description.bindings = quad->GetBindingDescriptions();
+	description.attributes = quad->GetAttributeDescriptions();
+	description.cullMode = VK_CULL_MODE_NONE;
+	description.Specialize(static_cast<uint32_t>(!renderer.IsGamma()));	//enable gamma, glsl bool is 32 bits
+	description.Specialize(2.2f);	//gamma
+	description.layout = screenQuadPipelineLayout;
+	description.renderPass = mainRenderPass;
+	return description;
+}
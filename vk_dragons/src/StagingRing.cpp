@@ -0,0 +1,146 @@
+#include "StagingRing.h"
+#include <map>
+#include <cstring>
+
+StagingRing::StagingRing(Renderer& renderer, VkDeviceSize size) : renderer(renderer) {
+	this->size = size;
+	buffer = CreateHostBuffer(renderer, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	mapping = static_cast<char*>(renderer.memory->GetMapping(buffer.alloc.memory)) + buffer.alloc.offset;
+
+	head = 0;
+	tail = 0;
+	overflowStart = 0;
+	nextUpload = 0;
+}
+
+StagingRing::~StagingRing() {
+	ReleaseOverflow(overflowStart + overflow.size());
+	renderer.memory->GetHostAllocator().Free(buffer.alloc);
+	vkDestroyBuffer(renderer.device, buffer.buffer, nullptr);
+}
+
+StagingRange StagingRing::Alloc(VkDeviceSize size, VkDeviceSize alignment) {
+	VkDeviceSize position = head % this->size;
+	VkDeviceSize padding = (alignment - position % alignment) % alignment;
+
+	//ranges are contiguous, so one that would cross the end starts over at the beginning
+	if (position + padding + size > this->size) {
+		padding = this->size - position;
+	}
+
+	if (head + padding + size - tail > this->size) {
+		return AllocOverflow(size);
+	}
+
+	head += padding;
+	VkDeviceSize offset = head % this->size;
+	head += size;
+
+	return { mapping + offset, buffer.buffer, offset, size };
+}
+
+StagingRange StagingRing::Upload(const void* data, size_t size, VkDeviceSize alignment) {
+	StagingRange range = Alloc(size, alignment);
+	memcpy(range.data, data, size);
+	return range;
+}
+
+void StagingRing::CopyToBuffer(const StagingRange& range, VkBuffer dest, VkDeviceSize destOffset) {
+	VkBufferCopy region = {};
+	region.srcOffset = range.offset;
+	region.dstOffset = destOffset;
+	region.size = range.size;
+
+	pendingCopies.push_back({ range.buffer, dest, region });
+}
+
+void StagingRing::Flush(VkCommandBuffer commandBuffer) {
+	std::map<std::pair<VkBuffer, VkBuffer>, std::vector<VkBufferCopy>> groups;
+	for (auto& copy : pendingCopies) {
+		groups[std::make_pair(copy.source, copy.dest)].push_back(copy.region);
+	}
+
+	for (auto& pair : groups) {
+		vkCmdCopyBuffer(commandBuffer, pair.first.first, pair.first.second, static_cast<uint32_t>(pair.second.size()), pair.second.data());
+	}
+
+	pendingCopies.clear();
+}
+
+void StagingRing::CopyToImage(VkCommandBuffer commandBuffer, const StagingRange& range, VkImage dest, std::vector<VkBufferImageCopy> regions) {
+	for (auto& region : regions) {
+		region.bufferOffset += range.offset;
+	}
+
+	vkCmdCopyBufferToImage(commandBuffer, range.buffer, dest, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void StagingRing::BeginFrame(uint32_t frameIndex) {
+	//frames finish in order, so every frame up to the last one that used this slot is done
+	size_t last = markers.size();
+	for (size_t i = 0; i < markers.size(); i++) {
+		if (!markers[i].upload && markers[i].id == frameIndex) last = i;
+	}
+	if (last == markers.size()) return;
+
+	for (size_t i = 0; i <= last; i++) {
+		if (!markers[i].upload) markers[i].done = true;
+	}
+	Retire();
+}
+
+void StagingRing::EndFrame(uint32_t frameIndex) {
+	PushMarker(false, frameIndex);
+}
+
+//uploads may still be in flight on the transfer queue, they are given back by CompleteUpload
+void StagingRing::ReleaseSubmitted() {
+	for (auto& marker : markers) {
+		if (!marker.upload) marker.done = true;
+	}
+	Retire();
+}
+
+uint32_t StagingRing::EndUpload() {
+	uint32_t id = nextUpload++;
+	PushMarker(true, id);
+	return id;
+}
+
+void StagingRing::CompleteUpload(uint32_t id) {
+	for (auto& marker : markers) {
+		if (marker.upload && marker.id == id) marker.done = true;
+	}
+	Retire();
+}
+
+void StagingRing::PushMarker(bool upload, uint32_t id) {
+	markers.push_back({ upload, id, head, overflowStart + overflow.size(), false });
+}
+
+//space is given back in order, so a submission still in flight holds back everything after it
+void StagingRing::Retire() {
+	while (!markers.empty() && markers.front().done) {
+		tail = markers.front().head;
+		ReleaseOverflow(markers.front().overflowEnd);
+		markers.pop_front();
+	}
+}
+
+StagingRange StagingRing::AllocOverflow(VkDeviceSize size) {
+	overflow.push_back(CreateHostBuffer(renderer, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT));
+	Buffer& temporary = overflow.back();
+
+	char* data = static_cast<char*>(renderer.memory->GetMapping(temporary.alloc.memory)) + temporary.alloc.offset;
+	return { data, temporary.buffer, 0, size };
+}
+
+void StagingRing::ReleaseOverflow(uint64_t end) {
+	while (overflowStart < end) {
+		Buffer& temporary = overflow.front();
+		renderer.memory->GetHostAllocator().Free(temporary.alloc);
+		vkDestroyBuffer(renderer.device, temporary.buffer, nullptr);
+		overflow.pop_front();
+		overflowStart++;
+	}
+}
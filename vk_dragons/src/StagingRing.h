@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include "ProgramUtilities.h"
+
+#define DEFAULT_STAGING_RING_SIZE 32 * 1024 * 1024
+
+//sub-range of the staging memory, data is mapped at offset in buffer
+struct StagingRange {
+	void* data;
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+//one persistently mapped host buffer used as a ring for every upload
+//space is handed out in order and given back once the frame or the upload that read it is done
+//requests that do not fit get a temporary buffer instead, with the same lifetime
+class StagingRing {
+public:
+	StagingRing(Renderer& renderer, VkDeviceSize size = DEFAULT_STAGING_RING_SIZE);
+	~StagingRing();
+
+	StagingRange Alloc(VkDeviceSize size, VkDeviceSize alignment = 16);
+	StagingRange Upload(const void* data, size_t size, VkDeviceSize alignment = 16);
+
+	//buffer copies are recorded by Flush, one vkCmdCopyBuffer per source and destination pair, so it must come before the destinations are used
+	void CopyToBuffer(const StagingRange& range, VkBuffer dest, VkDeviceSize destOffset = 0);
+	void Flush(VkCommandBuffer commandBuffer);
+	//recorded immediately, with a single command, for an image in the transfer destination layout. The buffer offsets of the regions are relative to the range
+	void CopyToImage(VkCommandBuffer commandBuffer, const StagingRange& range, VkImage dest, std::vector<VkBufferImageCopy> regions);
+
+	//called by the renderer: after waiting for the fence of the frame slot, when submitting a frame with it, and once the device is idle
+	void BeginFrame(uint32_t frameIndex);
+	void EndFrame(uint32_t frameIndex);
+	void ReleaseSubmitted();
+	//called by the uploader: when submitting an upload, and once its fence is signaled. Uploads finish in any order relative to frames
+	uint32_t EndUpload();
+	void CompleteUpload(uint32_t id);
+
+private:
+	struct PendingCopy {
+		VkBuffer source;
+		VkBuffer dest;
+		VkBufferCopy region;
+	};
+
+	//position of the ring head, and count of temporary buffers, at the end of a submission
+	struct Marker {
+		bool upload;
+		uint32_t id;	//frame slot, or upload id
+		VkDeviceSize head;
+		uint64_t overflowEnd;
+		bool done;
+	};
+
+	Renderer& renderer;
+	Buffer buffer;
+	char* mapping;
+	VkDeviceSize size;
+	//head and tail only grow, positions in the buffer are modulo size
+	VkDeviceSize head;
+	VkDeviceSize tail;
+
+	std::deque<Marker> markers;
+	std::deque<Buffer> overflow;
+	uint64_t overflowStart;	//number of temporary buffers released so far
+	uint32_t nextUpload;
+	std::vector<PendingCopy> pendingCopies;
+
+	StagingRing(const StagingRing& other) = delete;
+	StagingRing& operator = (const StagingRing& other) = delete;
+
+	void PushMarker(bool upload, uint32_t id);
+	void Retire();
+	StagingRange AllocOverflow(VkDeviceSize size);
+	void ReleaseOverflow(uint64_t end);
+};
@@ -1,23 +1,50 @@
 #include "Texture.h"
 #include <iostream>
-#include "lodepng\lodepng.h"
 #include "ProgramUtilities.h"
+#include "Defragmenter.h"
 #include <stdexcept>
-
-Texture::Texture(Renderer& renderer, TextureType type, const std::string& filename, bool gammaSpace) : renderer(renderer) {
-	switch (type) {
-	case _Image:
-		Init(filename, gammaSpace);
-		break;
-	case Cubemap:
-		InitCubemap(filename, gammaSpace);
-		break;
-	default:
-		throw std::runtime_error("Unsupported");
+#include <cstring>
+
+Texture::Texture(Renderer& renderer, TextureType type, const std::string& filename, TextureRole role) : renderer(renderer) {
+	oldImageView = VK_NULL_HANDLE;
+	std::vector<std::string> filenames = GetFilenames(type, filename);
+	Open(filename, filenames, role);
+	Stage(role);
+	Create(type);
+
+	std::vector<std::string> sources = cache ? std::vector<std::string>{ textureCachePath(filename) } : filenames;
+	for (size_t i = 0; i < sources.size(); i++) {
+		Fill(sources[i], i, 0);
 	}
+	cache.reset();
+	files.clear();
+}
+
+Texture::Texture(Renderer& renderer, JobSystem& jobs, TextureType type, const std::string& filename, TextureRole role) : renderer(renderer) {
+	oldImageView = VK_NULL_HANDLE;
+	std::vector<std::string> filenames = GetFilenames(type, filename);
+
+	//once the cache or the headers are read, the layers are decoded and filtered, or the baked levels copied, into the staging ring while the image is created
+	jobs.Run(filename, [this, filename, filenames, role]() {
+		Open(filename, filenames, role);
+	}, [this, &jobs, filename, filenames, type, role]() {
+		Stage(role);
+		std::vector<std::string> sources = cache ? std::vector<std::string>{ textureCachePath(filename) } : filenames;
+		for (size_t i = 0; i < sources.size(); i++) {
+			std::string name = sources[i];
+			jobs.Run("Fill " + name, [this, name, i]() {
+				Fill(name, i, 1);
+			}, [this, i]() {
+				if (cache) cache.reset();
+				else files[i].reset();
+			});
+		}
+		Create(type);
+	});
 }
 
 Texture::Texture(Renderer& renderer, TextureType type, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkFormat format) : renderer(renderer) {
+	oldImageView = VK_NULL_HANDLE;
 	switch (type) {
 	case _Image:
 		Init(width, height, format, usage);
@@ -31,60 +58,56 @@ Texture::Texture(Renderer& renderer, TextureType type, uint32_t width, uint32_t
 }
 
 Texture::~Texture() {
+	renderer.defragmenter->Unregister(image.image);
 	renderer.memory->Free(image.alloc);
 	vkDestroyImage(renderer.device, image.image, nullptr);
 	vkDestroyImageView(renderer.device, imageView, nullptr);
+	if (oldImageView != VK_NULL_HANDLE) vkDestroyImageView(renderer.device, oldImageView, nullptr);
 }
 
-void Texture::Init(const std::string& filename, bool gammaSpace) {
-	LoadImages(std::vector<std::string>{ filename });
-	CalulateMipChain();
-
-	if (gammaSpace) {
-		format = VK_FORMAT_R8G8B8A8_SRGB;
-	}
-	else {
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+std::vector<std::string> Texture::GetFilenames(TextureType type, const std::string& filename) {
+	switch (type) {
+	case _Image:
+		return { filename };
+	case Cubemap:
+		//to create a cubemap, there must 6 layers in an image
+		//the layers correspond to +X, -X, +Y, -Y, +Z, -Z
+		//Vulkan uses Y-down convention, so +Y corresponds to down, the _d file
+		return cubemapFacePaths(filename);
+	default:
+		throw std::runtime_error("Unsupported");
 	}
+}
+
+//the size and format are already known
+void Texture::Create(TextureType type) {
+	VkImageCreateFlags flags = type == Cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+	VkImageViewType viewType = type == Cubemap ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
 
 	image = CreateImage(renderer,
 		format,
 		width, height,
 		mipLevels, arrayLayers,
 		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		0);
-	imageView = CreateImageView(renderer.device, image.image, format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, mipLevels, arrayLayers);
+		flags);
+	imageView = CreateImageView(renderer.device, image.image, format, VK_IMAGE_ASPECT_COLOR_BIT, viewType, mipLevels, arrayLayers);
+	MakeMovable(flags, viewType);
 }
 
-void Texture::InitCubemap(const std::string& filenameRoot, bool gammaSpace) {
-	//to create a cubemap, there must 6 layers in an image
-	//the layers correspond to +X, -X, +Y, -Y, +Z, -Z
-	//Vulkan uses Y-down convention, so +Y corresponds to down
-	std::vector<std::string> filenames = {
-		filenameRoot + "_r.png",
-		filenameRoot + "_l.png",
-		filenameRoot + "_d.png",
-		filenameRoot + "_u.png",
-		filenameRoot + "_b.png",
-		filenameRoot + "_f.png",
-	};
-
-	LoadImages(filenames);
-	CalulateMipChain();
-
-	if (gammaSpace) {
-		format = VK_FORMAT_R8G8B8A8_SRGB;
-	} else {
-		format = VK_FORMAT_R8G8B8A8_UNORM;
-	}
+//only textures loaded from files are moved. Render targets are referenced by framebuffers, and are cheap to recreate anyway
+void Texture::MakeMovable(VkImageCreateFlags flags, VkImageViewType viewType) {
+	renderer.defragmenter->Register(image, format, width, height, mipLevels, arrayLayers,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, flags,
+		[this, viewType](const Image& image) { Relocate(image, viewType); });
+}
 
-	image = CreateImage(renderer,
-		format,
-		width, height,
-		mipLevels, arrayLayers,
-		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
-	imageView = CreateImageView(renderer.device, image.image, format, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_CUBE, mipLevels, arrayLayers);
+void Texture::Relocate(const Image& image, VkImageViewType viewType) {
+	//the defragmenter only moves again once the frames using the previous view are done
+	if (oldImageView != VK_NULL_HANDLE) vkDestroyImageView(renderer.device, oldImageView, nullptr);
+	oldImageView = imageView;
+
+	this->image = image;
+	imageView = CreateImageView(renderer.device, image.image, format, VK_IMAGE_ASPECT_COLOR_BIT, viewType, mipLevels, arrayLayers);
 }
 
 void Texture::Init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage) {
@@ -116,22 +139,119 @@ void Texture::InitDepth(uint32_t width, uint32_t height, VkImageUsageFlags flags
 		VK_IMAGE_VIEW_TYPE_2D, 1, 1);
 }
 
-void Texture::LoadImages(std::vector<std::string>& filenames) {
-	data.resize(filenames.size());
-	unsigned int width, height;
+//touches nothing but the cache and the files, so it can run on any thread
+//a baked cache is used if it is up to date and its format is the one of the role, or RGBA8
+void Texture::Open(const std::string& filename, const std::vector<std::string>& filenames, TextureRole role) {
+	std::string cachePath = textureCachePath(filename);
+	cache = TextureCache::Open(cachePath, filenames);
+	if (cache) {
+		TextureCacheFormat stored = cache->GetFormat();
+		bool compressed = stored == textureCacheFormat(role) && renderer.deviceFeatures.textureCompressionBC == VK_TRUE;
+		if (stored == CacheRGBA8 || compressed) {
+			std::cout << "Loading: " + cachePath + "\n";
+			return;
+		}
+		cache.reset();
+	}
+
+	for (auto& name : filenames) {
+		std::cout << "Loading: " + name + "\n";
+		files.push_back(std::make_unique<PngImage>());
+		if (!files.back()->Open(name)) {
+			throw std::runtime_error("Could not load texture " + name);
+		}
+	}
+}
+
+//main thread only, the staging ring isn't thread safe
+void Texture::Stage(TextureRole role) {
+	bool srgb = role == ColorTexture;
+	format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+
+	if (cache) {
+		width = cache->GetWidth();
+		height = cache->GetHeight();
+		arrayLayers = cache->GetLayerCount();
+		mipLevels = static_cast<uint32_t>(cache->GetLevels().size());
+
+		switch (cache->GetFormat()) {
+		case CacheBC1:
+			format = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+			break;
+		case CacheBC5:
+			format = VK_FORMAT_BC5_UNORM_BLOCK;
+			break;
+		case CacheBC7:
+			format = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+			break;
+		default:
+			break;
+		}
 
-	for (size_t i = 0; i < filenames.size(); i++) {
-		std::cout << "Loading: " << filenames[i] << std::endl;
-		unsigned int error = lodepng::decode(data[i], width, height, filenames[i]);
-		if (error != 0) {
-			std::cerr << "Unable to load the texture at path " << filenames[i] << std::endl;
+		//the levels are contiguous in the cache, and each holds every layer
+		for (auto& level : cache->GetLevels()) {
+			AddRegion(level.width, level.height, level.offset);
 		}
-		flipImage(data[i], width, height);
+
+		staged = renderer.staging->Alloc(cache->GetDataSize());
+		return;
 	}
 
-	this->width = static_cast<uint32_t>(width);
-	this->height = static_cast<uint32_t>(height);
-	arrayLayers = static_cast<uint32_t>(data.size());
+	width = files[0]->GetWidth();
+	height = files[0]->GetHeight();
+	arrayLayers = static_cast<uint32_t>(files.size());
+
+	for (auto& file : files) {
+		if (file->GetWidth() != width || file->GetHeight() != height) {
+			throw std::runtime_error("Could not load texture, layers have different sizes");
+		}
+	}
+
+	//same layout as a cache, the levels are generated from the decoded files by Fill
+	mipContent = textureMipContent(role);
+	mipLevels = mipLevelCount(width, height);
+	VkDeviceSize size = 0;
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		unsigned w, h;
+		mipLevelSize(width, height, level, w, h);
+		AddRegion(w, h, size);
+		size += (VkDeviceSize(w) * h * 4 * arrayLayers + 15) & ~VkDeviceSize(15);
+	}
+
+	staged = renderer.staging->Alloc(size);
+}
+
+void Texture::AddRegion(uint32_t width, uint32_t height, VkDeviceSize offset) {
+	VkBufferImageCopy copy = {};
+	copy.bufferOffset = offset;
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.mipLevel = static_cast<uint32_t>(regions.size());
+	copy.imageSubresource.baseArrayLayer = 0;
+	copy.imageSubresource.layerCount = arrayLayers;
+	copy.imageExtent = { width, height, 1 };
+	regions.push_back(copy);
+}
+
+//each layer writes to its own part of every level of the staging range, so they can run on any thread. A cache is copied at once
+//the levels are filtered from a copy in cached memory, the staging memory is slow to read
+void Texture::Fill(const std::string& filename, size_t index, unsigned threadCount) {
+	if (cache) {
+		memcpy(staged.data, cache->GetData(), cache->GetDataSize());
+		return;
+	}
+
+	std::vector<unsigned char> base(files[index]->GetDecodedSize());
+	if (!files[index]->Decode(base.data())) {
+		throw std::runtime_error("Could not decode texture " + filename);
+	}
+	std::vector<std::vector<unsigned char>> levels;
+	generateMipChain(base.data(), width, height, mipContent, levels, threadCount);
+
+	unsigned char* dest = static_cast<unsigned char*>(staged.data);
+	memcpy(dest + regions[0].bufferOffset + index * base.size(), base.data(), base.size());
+	for (size_t level = 0; level < levels.size(); level++) {
+		memcpy(dest + regions[level + 1].bufferOffset + index * levels[level].size(), levels[level].data(), levels[level].size());
+	}
 }
 
 uint32_t Texture::GetWidth() {
@@ -142,69 +262,19 @@ uint32_t Texture::GetHeight() {
 	return height;
 }
 
-void Texture::UploadData(VkCommandBuffer commandBuffer, std::vector<std::unique_ptr<StagingBuffer>>& stagingBuffers) {
-	Transition(commandBuffer, VK_FORMAT_R8G8B8A8_UNORM, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, mipLevels, arrayLayers);
-
-	for (size_t i = 0; i < data.size(); i++) {
-		stagingBuffers.emplace_back(std::make_unique<StagingBuffer>(renderer, data[i].size(), data[i].data()));
-		stagingBuffers.back()->CopyToImage(commandBuffer, image.image, width, height, static_cast<uint32_t>(i));
-	}
+void Texture::UploadData(UploadBatch& batch) {
+	VkCommandBuffer commandBuffer = batch.commandBuffer;
+	Transition(commandBuffer, format, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, arrayLayers);
 
-	GenerateMipChain(commandBuffer);
+	//every level is already in one range and goes in one copy
+	renderer.staging->CopyToImage(commandBuffer, staged, image.image, regions);
 
-	Transition(commandBuffer, VK_FORMAT_R8G8B8A8_UNORM, image.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels, arrayLayers);
+	batch.images.push_back({ image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, arrayLayers });
 }
 
-void Texture::CalulateMipChain() {
-	uint32_t w = width;
-	uint32_t h = height;
-
-	while (w != 1 && h != 1) {
-		mipChain.push_back({ w, h });
-		if (w > 1) w /= 2;
-		if (h > 1) h /= 2;
-	}
-
-	mipLevels = static_cast<uint32_t>(mipChain.size());
-}
-
-void Texture::GenerateMipChain(VkCommandBuffer commandBuffer) {
-	if (mipChain.size() == 1) return;
-
-	//start from i == 1, blit level (i - 1) to (i)
-	for (size_t i = 1; i < mipChain.size(); i++) {
-		glm::vec2 src = mipChain[i - 1];
-		glm::vec2 dst = mipChain[i];
-		int32_t srcW = static_cast<int32_t>(src.x);
-		int32_t srcH = static_cast<int32_t>(src.y);
-		int32_t dstW = static_cast<int32_t>(dst.x);
-		int32_t dstH = static_cast<int32_t>(dst.y);
-
-		VkImageBlit blit = {};
-		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.srcSubresource.baseArrayLayer = 0;
-		blit.srcSubresource.layerCount = static_cast<uint32_t>(data.size());
-		blit.srcSubresource.mipLevel = static_cast<uint32_t>(i - 1);
-		blit.srcOffsets[0] = { 0, 0, 0 };
-		blit.srcOffsets[1] = { srcW, srcH, 1 };
-		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.dstSubresource.baseArrayLayer = 0;
-		blit.dstSubresource.layerCount = static_cast<uint32_t>(data.size());
-		blit.dstSubresource.mipLevel = static_cast<uint32_t>(i);
-		blit.dstOffsets[0] = { 0, 0, 0 };
-		blit.dstOffsets[1] = { dstW, dstH, 1 };
-
-		vkCmdBlitImage(commandBuffer,
-			image.image, VK_IMAGE_LAYOUT_GENERAL,
-			image.image, VK_IMAGE_LAYOUT_GENERAL,
-			1, &blit,
-			VK_FILTER_LINEAR
-		);
-
-		Transition(commandBuffer, format, image.image,
-			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
-			mipLevels, arrayLayers);
-	}
+//the image is only sampled on the graphics queue
+void Texture::FinishUpload(VkCommandBuffer commandBuffer) {
+	Transition(commandBuffer, format, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels, arrayLayers);
 }
 
 VkFormat Texture::findSupportedFormat(const std::vector<VkFormat>& candidates, VkFormatFeatureFlags features) {
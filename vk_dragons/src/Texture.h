@@ -4,7 +4,11 @@
 #include "Renderer.h"
 #include "glm/glm.hpp"
 #include "ProgramUtilities.h"
-#include "StagingBuffer.h"
+#include "StagingRing.h"
+#include "Uploader.h"
+#include "JobSystem.h"
+#include "PngDecoder.h"
+#include "TextureCache.h"
 
 enum TextureType {
 	_Image,
@@ -14,35 +18,48 @@ enum TextureType {
 
 class Texture {
 public:
-	Texture(Renderer& renderer, TextureType type, const std::string& filename, bool gammaSpace = false);
+	//loads the baked .vktex next to the file when there is a usable one, the png files otherwise
+	Texture(Renderer& renderer, TextureType type, const std::string& filename, TextureRole role = EffectsTexture);
+	//the cache or the headers are read by a job, then the image is created and each file is decoded by its own job. The texture is usable after jobs.Wait()
+	Texture(Renderer& renderer, JobSystem& jobs, TextureType type, const std::string& filename, TextureRole role = EffectsTexture);
 	Texture(Renderer& renderer, TextureType type, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkFormat format = VK_FORMAT_UNDEFINED);
 	~Texture();
 
-	void UploadData(VkCommandBuffer commandBuffer, std::vector<std::unique_ptr<StagingBuffer>>& stagingBuffers);
+	//copies every level on the transfer queue, then FinishUpload makes the image readable by shaders on the graphics queue
+	//the levels are staged while loading, so this must be recorded in the first upload after loading
+	void UploadData(UploadBatch& batch);
+	void FinishUpload(VkCommandBuffer commandBuffer);
 
 	uint32_t GetWidth();
 	uint32_t GetHeight();
 
 	Image image;
-	VkImageView imageView;
+	VkImageView imageView;	//changes when the defragmenter moves the image
 	VkFormat format;
 
 private:
 	Renderer& renderer;
 	uint32_t width;
 	uint32_t height;
-	std::vector<std::vector<unsigned char>> data;
-	std::vector<glm::vec2> mipChain;
+	std::unique_ptr<TextureCache> cache;	//released once copied
+	std::vector<std::unique_ptr<PngImage>> files;	//released once decoded
+	StagingRange staged;	//every level, each holding every layer bottom row first, like a baked cache
+	std::vector<VkBufferImageCopy> regions;	//one per level
+	MipContent mipContent;	//how the levels of the files are filtered
 	uint32_t mipLevels;
 	uint32_t arrayLayers;
+	VkImageView oldImageView;	//view of the image before the last move, frames in flight may still use it
 
-	void Init(const std::string& filename, bool gammaSpace = false);
-	void InitCubemap(const std::string& filenameRoot, bool gammaSpace = false);
+	void Create(TextureType type);
 	void Init(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage);
 	void InitDepth(uint32_t width, uint32_t height, VkImageUsageFlags flags);
-	void LoadImages(std::vector<std::string>& filenames);
-	void CalulateMipChain();
-	void GenerateMipChain(VkCommandBuffer commandBuffer);
+	void MakeMovable(VkImageCreateFlags flags, VkImageViewType viewType);
+	void Relocate(const Image& image, VkImageViewType viewType);
+	static std::vector<std::string> GetFilenames(TextureType type, const std::string& filename);
+	void Open(const std::string& filename, const std::vector<std::string>& filenames, TextureRole role);
+	void Stage(TextureRole role);
+	void AddRegion(uint32_t width, uint32_t height, VkDeviceSize offset);
+	void Fill(const std::string& filename, size_t index, unsigned threadCount);
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkFormatFeatureFlags features);
 	VkFormat findDepthFormat();
 };
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "Tlsf.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//index of the lowest and highest set bits, the value must not be 0
+static uint32_t LowestBit(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+static uint32_t HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(63 - __builtin_clzll(value));
+#endif
+}
+
+Tlsf::Tlsf() {
+	Reset();
+}
+
+uint32_t Tlsf::AddRegion(size_t size) {
+	uint32_t region;
+	if (!unusedRegions.empty()) {
+		region = unusedRegions.back();
+		unusedRegions.pop_back();
+	} else {
+		region = static_cast<uint32_t>(regionSizes.size());
+		regionSizes.push_back(0);
+		regionUsed.push_back(0);
+		regionFirstBlocks.push_back(static_cast<uint32_t>(InvalidBlock));
+		regionFrozen.push_back(false);
+	}
+
+	regionSizes[region] = size;
+	InitRegion(region);
+	return region;
+}
+
+void Tlsf::RemoveRegion(uint32_t region) {
+	uint32_t block = regionFirstBlocks[region];
+	RemoveFree(block);
+	ReleaseBlock(block);
+
+	regionSizes[region] = 0;
+	regionFirstBlocks[region] = InvalidBlock;
+	unusedRegions.push_back(region);
+}
+
+bool Tlsf::IsRegionEmpty(uint32_t region) {
+	return regionUsed[region] == 0;
+}
+
+size_t Tlsf::GetRegionUsed(uint32_t region) {
+	return regionUsed[region];
+}
+
+size_t Tlsf::GetAllocationCount() {
+	return allocationCount;
+}
+
+//every block of the highest non-empty class is a candidate, the class only bounds their size
+size_t Tlsf::GetLargestFree() {
+	if (firstLevelBitmap == 0) return 0;
+
+	uint32_t firstLevel = HighestBit(firstLevelBitmap);
+	uint32_t secondLevel = HighestBit(secondLevelBitmaps[firstLevel]);
+
+	size_t largest = 0;
+	for (uint32_t block = freeLists[firstLevel][secondLevel]; block != InvalidBlock; block = blocks[block].nextFree) {
+		if (blocks[block].size > largest) largest = blocks[block].size;
+	}
+	return largest;
+}
+
+void Tlsf::SetRegionFrozen(uint32_t region, bool frozen) {
+	if (regionFrozen[region] == frozen) return;
+
+	//blocks are removed while the region is still listed, and inserted once it is not frozen anymore
+	if (frozen) {
+		for (uint32_t block = regionFirstBlocks[region]; block != InvalidBlock; block = blocks[block].nextPhysical) {
+			if (blocks[block].free) RemoveFree(block);
+		}
+		regionFrozen[region] = true;
+	} else {
+		regionFrozen[region] = false;
+		for (uint32_t block = regionFirstBlocks[region]; block != InvalidBlock; block = blocks[block].nextPhysical) {
+			if (blocks[block].free) InsertFree(block);
+		}
+	}
+}
+
+Tlsf::Range Tlsf::Alloc(size_t size, size_t alignment) {
+	if (size == 0) size = 1;
+	if (alignment == 0) alignment = 1;
+
+	//the first block of the size class is usually aligned already, otherwise look for one with room for the padding
+	uint32_t block = FindFree(size);
+	if (block != InvalidBlock) {
+		size_t padding = (alignment - blocks[block].offset % alignment) % alignment;
+		if (padding + size > blocks[block].size) block = InvalidBlock;
+	}
+	if (block == InvalidBlock && alignment > 1) {
+		block = FindFree(size + alignment - 1);
+	}
+	if (block == InvalidBlock) return { InvalidBlock };
+
+	RemoveFree(block);
+	blocks[block].free = false;
+
+	size_t padding = (alignment - blocks[block].offset % alignment) % alignment;
+	if (padding > 0) {
+		//the block in front is in use, otherwise it would have been merged with this one
+		uint32_t front = block;
+		block = Split(front, padding);
+		blocks[front].free = true;
+		InsertFree(front);
+	}
+	if (blocks[block].size > size) {
+		uint32_t back = Split(block, size);
+		blocks[back].free = true;
+		InsertFree(back);
+	}
+
+	regionUsed[blocks[block].region] += blocks[block].size;
+	allocationCount++;
+	return { block, blocks[block].region, blocks[block].offset, blocks[block].size };
+}
+
+uint32_t Tlsf::Free(uint32_t block) {
+	uint32_t region = blocks[block].region;
+	regionUsed[region] -= blocks[block].size;
+	allocationCount--;
+	blocks[block].free = true;
+
+	uint32_t next = blocks[block].nextPhysical;
+	if (next != InvalidBlock && blocks[next].free) {
+		RemoveFree(next);
+		Merge(block, next);
+	}
+
+	uint32_t prev = blocks[block].prevPhysical;
+	if (prev != InvalidBlock && blocks[prev].free) {
+		RemoveFree(prev);
+		Merge(prev, block);
+		block = prev;
+	}
+
+	InsertFree(block);
+	return region;
+}
+
+void Tlsf::Reset() {
+	blocks.clear();
+	unusedBlocks.clear();
+	allocationCount = 0;
+
+	firstLevelBitmap = 0;
+	for (uint32_t i = 0; i < FirstLevelCount; i++) {
+		secondLevelBitmaps[i] = 0;
+		for (uint32_t j = 0; j < SecondLevelCount; j++) {
+			freeLists[i][j] = InvalidBlock;
+		}
+	}
+
+	//region ids are kept
+	for (uint32_t region = 0; region < regionSizes.size(); region++) {
+		if (regionSizes[region] > 0) InitRegion(region);
+	}
+}
+
+void Tlsf::InitRegion(uint32_t region) {
+	uint32_t block = NewBlock();
+	blocks[block] = { 0, regionSizes[region], region, InvalidBlock, InvalidBlock, InvalidBlock, InvalidBlock, true };
+	regionFrozen[region] = false;
+	InsertFree(block);
+	regionUsed[region] = 0;
+	regionFirstBlocks[region] = block;
+}
+
+uint32_t Tlsf::NewBlock() {
+	if (!unusedBlocks.empty()) {
+		uint32_t block = unusedBlocks.back();
+		unusedBlocks.pop_back();
+		return block;
+	}
+	blocks.push_back({});
+	return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void Tlsf::ReleaseBlock(uint32_t block) {
+	unusedBlocks.push_back(block);
+}
+
+void Tlsf::InsertFree(uint32_t block) {
+	//free blocks of frozen regions stay out of the lists
+	if (regionFrozen[blocks[block].region]) return;
+
+	uint32_t firstLevel, secondLevel;
+	Mapping(blocks[block].size, firstLevel, secondLevel);
+
+	uint32_t head = freeLists[firstLevel][secondLevel];
+	blocks[block].prevFree = InvalidBlock;
+	blocks[block].nextFree = head;
+	if (head != InvalidBlock) blocks[head].prevFree = block;
+	freeLists[firstLevel][secondLevel] = block;
+
+	firstLevelBitmap |= uint64_t(1) << firstLevel;
+	secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void Tlsf::RemoveFree(uint32_t block) {
+	Block& b = blocks[block];
+	if (regionFrozen[b.region]) return;
+
+	if (b.prevFree != InvalidBlock) blocks[b.prevFree].nextFree = b.nextFree;
+	if (b.nextFree != InvalidBlock) blocks[b.nextFree].prevFree = b.prevFree;
+
+	uint32_t firstLevel, secondLevel;
+	Mapping(b.size, firstLevel, secondLevel);
+	if (freeLists[firstLevel][secondLevel] == block) {
+		freeLists[firstLevel][secondLevel] = b.nextFree;
+		if (b.nextFree == InvalidBlock) {
+			secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (secondLevelBitmaps[firstLevel] == 0) firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+		}
+	}
+}
+
+//first free block of the smallest size class whose blocks are all at least size bytes
+uint32_t Tlsf::FindFree(size_t size) {
+	//round up to the next class boundary, so that any block of the class fits
+	if (size >= SecondLevelCount) {
+		size_t step = size_t(1) << (HighestBit(size) - SecondLevelLog2);
+		if (size > SIZE_MAX - step) return InvalidBlock;
+		size += step - 1;
+	}
+
+	uint32_t firstLevel, secondLevel;
+	Mapping(size, firstLevel, secondLevel);
+
+	uint32_t secondMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if (secondMap == 0) {
+		uint64_t firstMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+		if (firstMap == 0) return InvalidBlock;
+		firstLevel = LowestBit(firstMap);
+		secondMap = secondLevelBitmaps[firstLevel];
+	}
+	secondLevel = LowestBit(secondMap);
+
+	return freeLists[firstLevel][secondLevel];
+}
+
+//cut the first size bytes of a block, the rest goes in a new block that is returned
+uint32_t Tlsf::Split(uint32_t block, size_t size) {
+	uint32_t rest = NewBlock();
+	Block& b = blocks[block];
+	blocks[rest] = { b.offset + size, b.size - size, b.region, block, b.nextPhysical, InvalidBlock, InvalidBlock, false };
+	if (b.nextPhysical != InvalidBlock) blocks[b.nextPhysical].prevPhysical = rest;
+	b.nextPhysical = rest;
+	b.size = size;
+	return rest;
+}
+
+//absorb the next physical block, which must not be in a free list
+void Tlsf::Merge(uint32_t block, uint32_t next) {
+	Block& b = blocks[block];
+	b.size += blocks[next].size;
+	b.nextPhysical = blocks[next].nextPhysical;
+	if (b.nextPhysical != InvalidBlock) blocks[b.nextPhysical].prevPhysical = block;
+	ReleaseBlock(next);
+}
+
+void Tlsf::Mapping(size_t size, uint32_t& firstLevel, uint32_t& secondLevel) {
+	if (size < SecondLevelCount) {
+		firstLevel = 0;
+		secondLevel = static_cast<uint32_t>(size);
+	} else {
+		uint32_t log2 = HighestBit(size);
+		secondLevel = static_cast<uint32_t>(size >> (log2 - SecondLevelLog2)) - SecondLevelCount;
+		firstLevel = log2 - SecondLevelLog2 + 1;
+	}
+}
\ No newline at end of file
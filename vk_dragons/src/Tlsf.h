@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//two-level segregated fit allocator of ranges inside one or more regions, in constant time
+//free blocks are kept in lists by size class: first by power of two, then in 32 linear steps between two powers of two
+//bitmaps of the non-empty lists give the smallest class that fits a request with a couple of bit scans
+//block metadata lives in a pooled array and blocks are referred to by their index in it
+class Tlsf {
+public:
+	static const uint32_t InvalidBlock = 0xFFFFFFFF;
+
+	struct Range {
+		uint32_t block;	//InvalidBlock if the allocation failed
+		uint32_t region;
+		size_t offset;
+		size_t size;
+	};
+
+	Tlsf();
+
+	//ids of removed regions are reused
+	uint32_t AddRegion(size_t size);
+	//the region must be empty
+	void RemoveRegion(uint32_t region);
+	bool IsRegionEmpty(uint32_t region);
+	size_t GetRegionUsed(uint32_t region);
+	//the free blocks of a frozen region are taken out of the free lists, so allocations go to the other regions while it is emptied
+	void SetRegionFrozen(uint32_t region, bool frozen);
+	size_t GetAllocationCount();
+	//largest block that can be allocated, frozen regions excluded
+	size_t GetLargestFree();
+	Range Alloc(size_t size, size_t alignment);
+	//returns the region of the block
+	uint32_t Free(uint32_t block);
+	void Reset();
+
+private:
+	static const uint32_t SecondLevelLog2 = 5;
+	static const uint32_t SecondLevelCount = 1 << SecondLevelLog2;
+	static const uint32_t FirstLevelCount = 64 - SecondLevelLog2 + 1;
+
+	struct Block {
+		size_t offset;
+		size_t size;
+		uint32_t region;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	std::vector<Block> blocks;
+	std::vector<uint32_t> unusedBlocks;
+	std::vector<size_t> regionSizes;	//0 for removed regions
+	std::vector<size_t> regionUsed;
+	std::vector<uint32_t> regionFirstBlocks;	//the block at offset 0 keeps its index through splits and merges
+	std::vector<uint32_t> unusedRegions;
+	std::vector<bool> regionFrozen;
+	size_t allocationCount;
+
+	uint64_t firstLevelBitmap;
+	uint32_t secondLevelBitmaps[FirstLevelCount];
+	uint32_t freeLists[FirstLevelCount][SecondLevelCount];
+
+	void InitRegion(uint32_t region);
+	uint32_t NewBlock();
+	void ReleaseBlock(uint32_t block);
+	void InsertFree(uint32_t block);
+	void RemoveFree(uint32_t block);
+	uint32_t FindFree(size_t size);
+	uint32_t Split(uint32_t block, size_t size);
+	void Merge(uint32_t block, uint32_t next);
+	static void Mapping(size_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+};
\ No newline at end of file
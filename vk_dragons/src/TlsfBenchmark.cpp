@@ -0,0 +1,326 @@
+#include "TlsfBenchmark.h"
+#include "Tlsf.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <iterator>
+
+//pages start at 32 MB and double up to 256 MB, like the allocator of a large heap
+static const size_t firstRegionSize = 32 * 1024 * 1024;
+static const size_t maxRegionSize = 256 * 1024 * 1024;
+static const size_t operationCount = 200000;
+//sizes are log-uniform in this range, a quarter of the allocations are images taking whole granularity pages
+static const size_t minAllocSize = 256;
+static const size_t maxAllocSize = 1024 * 1024;
+static const size_t bufferAlignment = 256;
+static const size_t imageAlignment = 64 * 1024;
+static const size_t imageGranularity = 1024;
+
+namespace {
+	struct TraceRequest {
+		size_t size;
+		size_t alignment;
+		uint32_t pick;	//chooses between alloc and free, and which allocation is freed
+	};
+
+	struct TraceAllocation {
+		Tlsf::Range range;
+		size_t alignment;
+	};
+
+	class TlsfStrategy {
+	public:
+		Tlsf tlsf;
+
+		uint32_t AddRegion(size_t size) {
+			return tlsf.AddRegion(size);
+		}
+
+		bool Alloc(size_t size, size_t alignment, Tlsf::Range& range) {
+			range = tlsf.Alloc(size, alignment);
+			return range.block != Tlsf::InvalidBlock;
+		}
+
+		void Free(const Tlsf::Range& range) {
+			tlsf.Free(range.block);
+		}
+	};
+
+	//the allocator Tlsf replaced: a std::list of free nodes per page, searched first-fit in every page on each alloc and walked again on each free
+	class FirstFitStrategy {
+	public:
+		uint32_t AddRegion(size_t size) {
+			pages.push_back({ { 0, size } });
+			return static_cast<uint32_t>(pages.size() - 1);
+		}
+
+		bool Alloc(size_t size, size_t alignment, Tlsf::Range& range) {
+			for (size_t page = 0; page < pages.size(); page++) {
+				std::list<Node>& nodes = pages[page];
+				for (auto iter = nodes.begin(); iter != nodes.end(); iter++) {
+					if (iter->size < size) continue;
+					size_t align = (alignment - iter->offset % alignment) % alignment;
+					if (align + size > iter->size) continue;
+
+					range = { 0, static_cast<uint32_t>(page), iter->offset + align, size };
+					SplitNode(nodes, iter, range.offset, size);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//unlike the original, a range after the last free node is appended instead of being dropped, so both allocators keep the same free space
+		void Free(const Tlsf::Range& range) {
+			std::list<Node>& nodes = pages[range.region];
+			auto iter = nodes.begin();
+			while (iter != nodes.end() && iter->offset < range.offset) iter++;
+			auto middle = nodes.insert(iter, { range.offset, range.size });
+			if (iter != nodes.end()) CombineNode(nodes, iter);
+			CombineNode(nodes, middle);
+		}
+
+	private:
+		struct Node {
+			size_t offset;
+			size_t size;
+		};
+
+		std::vector<std::list<Node>> pages;
+
+		void SplitNode(std::list<Node>& nodes, std::list<Node>::iterator iter, size_t offset, size_t size) {
+			size_t frontSlack = offset - iter->offset;
+			size_t endSlack = (iter->offset + iter->size) - (offset + size);
+
+			if (frontSlack == 0 && endSlack == 0) {
+				nodes.erase(iter);
+			} else if (frontSlack == 0) {
+				iter->offset = offset + size;
+				iter->size = endSlack;
+			} else if (endSlack == 0) {
+				iter->size = frontSlack;
+			} else {
+				nodes.insert(iter, { iter->offset, frontSlack });
+				iter->offset = offset + size;
+				iter->size = endSlack;
+			}
+		}
+
+		//if the node in front of iter exists and touches it, they become one
+		void CombineNode(std::list<Node>& nodes, std::list<Node>::iterator iter) {
+			if (iter == nodes.begin()) return;
+			auto prev = std::prev(iter);
+			if (prev->offset + prev->size == iter->offset) {
+				prev->size += iter->size;
+				nodes.erase(iter);
+			}
+		}
+	};
+
+	//the requests are generated up front, so that only the allocator is timed and every strategy replays the same trace
+	std::vector<TraceRequest> GenerateRequests(unsigned seed) {
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<double> logSize(std::log(double(minAllocSize)), std::log(double(maxAllocSize)));
+		std::vector<TraceRequest> requests(operationCount);
+		for (auto& request : requests) {
+			request.size = static_cast<size_t>(std::exp(logSize(random)));
+			request.alignment = bufferAlignment;
+			if (random() % 4 == 0) {
+				request.alignment = imageAlignment;
+				request.size = (request.size + imageGranularity - 1) / imageGranularity * imageGranularity;
+			}
+			request.pick = static_cast<uint32_t>(random());
+		}
+		return requests;
+	}
+
+	template<typename Strategy>
+	class Trace {
+	public:
+		Trace(const std::vector<TraceRequest>& requests) : requests(requests), next(0) {}
+
+		Strategy strategy;
+		std::vector<size_t> regionSizes;
+		std::vector<TraceAllocation> live;
+
+		//adds a page when nothing fits, as the allocator does
+		void Alloc() {
+			const TraceRequest& request = Next();
+			size_t size = request.size;
+			size_t alignment = request.alignment;
+
+			Tlsf::Range range;
+			if (!strategy.Alloc(size, alignment, range)) {
+				size_t regionSize = regionSizes.empty() ? firstRegionSize : std::min(regionSizes.back() * 2, maxRegionSize);
+				regionSize = std::max(regionSize, size + alignment);
+				uint32_t region = strategy.AddRegion(regionSize);
+				regionSizes.resize(std::max(regionSizes.size(), size_t(region) + 1));
+				regionSizes[region] = regionSize;
+				strategy.Alloc(size, alignment, range);
+			}
+			live.push_back({ range, alignment });
+		}
+
+		void Free() {
+			size_t index = Next().pick % live.size();
+			strategy.Free(live[index].range);
+			live[index] = live.back();
+			live.pop_back();
+		}
+
+		//stays around the target count of live allocations
+		void Step(size_t target) {
+			if (live.empty() || (live.size() < 2 * target && requests[next].pick % 2 == 0)) Alloc();
+			else Free();
+		}
+
+		//nanoseconds per operation
+		double Run(size_t target) {
+			while (live.size() < target) Alloc();
+
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < operationCount; i++) Step(target);
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / operationCount;
+		}
+
+	private:
+		const std::vector<TraceRequest>& requests;
+		size_t next;
+
+		const TraceRequest& Next() {
+			const TraceRequest& request = requests[next];
+			next = (next + 1) % requests.size();
+			return request;
+		}
+	};
+
+	std::vector<Tlsf::Range> SortedRanges(const std::vector<TraceAllocation>& live) {
+		std::vector<Tlsf::Range> ranges;
+		for (auto& allocation : live) ranges.push_back(allocation.range);
+		std::sort(ranges.begin(), ranges.end(), [](const Tlsf::Range& a, const Tlsf::Range& b) {
+			return a.region != b.region ? a.region < b.region : a.offset < b.offset;
+		});
+		return ranges;
+	}
+
+	template<typename Strategy>
+	bool RangesValid(const Trace<Strategy>& trace) {
+		for (auto& allocation : trace.live) {
+			const Tlsf::Range& range = allocation.range;
+			if (range.offset % allocation.alignment != 0) return false;
+			if (range.offset + range.size > trace.regionSizes[range.region]) return false;
+		}
+		std::vector<Tlsf::Range> ranges = SortedRanges(trace.live);
+		for (size_t i = 1; i < ranges.size(); i++) {
+			if (ranges[i].region == ranges[i - 1].region && ranges[i - 1].offset + ranges[i - 1].size > ranges[i].offset) return false;
+		}
+		return true;
+	}
+
+	//the free space is measured from the gaps between the live ranges, the same way for every strategy
+	template<typename Strategy>
+	void PrintResult(const char* name, const Trace<Strategy>& trace, double nanoseconds) {
+		size_t reserved = 0;
+		for (size_t size : trace.regionSizes) reserved += size;
+
+		size_t freeBytes = 0;
+		size_t freeRanges = 0;
+		size_t largestFree = 0;
+		auto addGap = [&](size_t gap) {
+			if (gap == 0) return;
+			freeBytes += gap;
+			freeRanges++;
+			largestFree = std::max(largestFree, gap);
+		};
+		std::vector<Tlsf::Range> ranges = SortedRanges(trace.live);
+		size_t index = 0;
+		for (uint32_t region = 0; region < trace.regionSizes.size(); region++) {
+			size_t end = 0;
+			for (; index < ranges.size() && ranges[index].region == region; index++) {
+				addGap(ranges[index].offset - end);
+				end = ranges[index].offset + ranges[index].size;
+			}
+			addGap(trace.regionSizes[region] - end);
+		}
+
+		//0 when all the free space is in one block, close to 1 when it is scattered in small ones
+		double fragmentation = freeBytes > 0 ? 1.0 - double(largestFree) / double(freeBytes) : 0.0;
+		std::cout << "  " << std::left << std::setw(16) << name << std::right << std::setw(7) << static_cast<int>(nanoseconds) << " ns per alloc or free, "
+			<< trace.regionSizes.size() << " regions (" << reserved / (1024 * 1024) << " MB, " << 100 * (reserved - freeBytes) / reserved << "% used), " << freeRanges << " free ranges, largest "
+			<< std::fixed << std::setprecision(1) << largestFree / (1024.0 * 1024.0) << " MB, fragmentation " << std::setprecision(2) << fragmentation << std::endl;
+	}
+
+	//the allocations made while the first region is frozen go to the other ones, and are freed afterwards
+	bool FrozenRegionSkipped(Trace<TlsfStrategy>& trace) {
+		Tlsf& tlsf = trace.strategy.tlsf;
+		tlsf.SetRegionFrozen(0, true);
+		size_t first = trace.live.size();
+		for (size_t i = 0; i < 1000; i++) trace.Alloc();
+
+		bool skipped = true;
+		for (size_t i = first; i < trace.live.size(); i++) {
+			if (trace.live[i].range.region == 0) skipped = false;
+		}
+		while (trace.live.size() > first) {
+			tlsf.Free(trace.live.back().range.block);
+			trace.live.pop_back();
+		}
+		tlsf.SetRegionFrozen(0, false);
+		return skipped;
+	}
+
+	//once everything is freed, each region alone must offer a single block of its whole size
+	bool RegionsCoalesced(Trace<TlsfStrategy>& trace) {
+		Tlsf& tlsf = trace.strategy.tlsf;
+		while (!trace.live.empty()) trace.Free();
+		if (tlsf.GetAllocationCount() != 0) return false;
+
+		uint32_t regionCount = static_cast<uint32_t>(trace.regionSizes.size());
+		bool coalesced = true;
+		for (uint32_t region = 0; region < regionCount; region++) {
+			for (uint32_t other = 0; other < regionCount; other++) {
+				tlsf.SetRegionFrozen(other, other != region);
+			}
+			if (!tlsf.IsRegionEmpty(region) || tlsf.GetLargestFree() != trace.regionSizes[region]) coalesced = false;
+		}
+		for (uint32_t region = 0; region < regionCount; region++) {
+			tlsf.SetRegionFrozen(region, false);
+		}
+		return coalesced;
+	}
+
+	int Check(bool success, const std::string& name) {
+		std::cout << (success ? "  PASS: " : "  FAIL: ") << name << std::endl;
+		return success ? 0 : 1;
+	}
+}
+
+int BenchmarkTlsf() {
+	int failures = 0;
+
+	for (size_t target : { 100, 1000, 5000 }) {
+		std::vector<TraceRequest> requests = GenerateRequests(static_cast<unsigned>(target));
+		std::cout << target << " live allocations, " << operationCount << " operations" << std::endl;
+
+		Trace<FirstFitStrategy> firstFit(requests);
+		double firstFitTime = firstFit.Run(target);
+		PrintResult("first-fit lists", firstFit, firstFitTime);
+
+		Trace<TlsfStrategy> tlsf(requests);
+		double tlsfTime = tlsf.Run(target);
+		PrintResult("tlsf", tlsf, tlsfTime);
+		std::cout << "  tlsf is " << std::fixed << std::setprecision(1) << firstFitTime / tlsfTime << "x faster" << std::endl;
+
+		failures += Check(RangesValid(firstFit), "first-fit ranges aligned, inside their region and disjoint");
+		failures += Check(RangesValid(tlsf), "tlsf ranges aligned, inside their region and disjoint");
+		failures += Check(FrozenRegionSkipped(tlsf), "no allocation in a frozen region");
+		failures += Check(RegionsCoalesced(tlsf), "empty regions coalesced to a single block");
+	}
+
+	return failures;
+}
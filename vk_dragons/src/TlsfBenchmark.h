@@ -0,0 +1,7 @@
+#pragma once
+
+//replays randomised alloc/free traces with the page sizes and alignments of the device allocator, on a Tlsf and on a copy of the
+//first-fit free lists it replaced, and prints the time per operation and the fragmentation left by both
+//the ranges are checked for overlaps and alignment, frozen regions must not receive allocations and empty regions must coalesce to one block
+//returns the number of failed checks
+int BenchmarkTlsf();
@@ -1,12 +1,17 @@
 #include "UniformBuffer.h"
 
-UniformBuffer::UniformBuffer(Renderer& renderer, size_t size, VkDescriptorSetLayout layout) : renderer(renderer) {
+UniformBuffer::UniformBuffer(Renderer& renderer, size_t size, VkDescriptorSetLayout layout, VkDescriptorType type) : renderer(renderer) {
 	this->size = size;
 	this->layout = layout;
+	this->type = type;
 
-	buffer = CreateHostBuffer(renderer, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	bool storage = type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	VkDeviceSize alignment = storage ? renderer.deviceProperties.limits.minStorageBufferOffsetAlignment : renderer.deviceProperties.limits.minUniformBufferOffsetAlignment;
+	stride = (size + alignment - 1) / alignment * alignment;
+
+	buffer = CreateHostBuffer(renderer, stride * renderer.GetFrameCount(), storage ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 	CreatePool();
-	CreateSet();
+	CreateSets();
 }
 
 UniformBuffer::~UniformBuffer() {
@@ -17,53 +22,58 @@ UniformBuffer::~UniformBuffer() {
 
 char* UniformBuffer::GetData() {
 	char* base = static_cast<char*>(renderer.memory->GetMapping(buffer.alloc.memory));
-	return base + buffer.alloc.offset;
+	return base + buffer.alloc.offset + stride * renderer.GetFrameIndex();
 }
 
 void UniformBuffer::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstSet) {
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, firstSet, 1, &set, 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, firstSet, 1, &sets[renderer.GetFrameIndex()], 0, nullptr);
 }
 
 void UniformBuffer::CreatePool() {
 	VkDescriptorPoolSize size = {};
-	size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	size.descriptorCount = 1;
+	size.type = type;
+	size.descriptorCount = renderer.GetFrameCount();
 
 	VkDescriptorPoolCreateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	info.poolSizeCount = 1;
 	info.pPoolSizes = &size;
-	info.maxSets = 1;
+	info.maxSets = renderer.GetFrameCount();
 
 	if (vkCreateDescriptorPool(renderer.device, &info, nullptr, &pool) != VK_SUCCESS) {
 		throw std::runtime_error("Could not create descriptor pool");
 	}
 }
 
-void UniformBuffer::CreateSet() {
+void UniformBuffer::CreateSets() {
+	sets.resize(renderer.GetFrameCount());
+	std::vector<VkDescriptorSetLayout> layouts(sets.size(), layout);
+
 	VkDescriptorSetAllocateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	info.descriptorPool = pool;
-	info.descriptorSetCount = 1;
-	info.pSetLayouts = &layout;
+	info.descriptorSetCount = static_cast<uint32_t>(sets.size());
+	info.pSetLayouts = layouts.data();
 
-	if (vkAllocateDescriptorSets(renderer.device, &info, &set) != VK_SUCCESS) {
+	if (vkAllocateDescriptorSets(renderer.device, &info, sets.data()) != VK_SUCCESS) {
 		throw std::runtime_error("Could not allocate uniform set");
 	}
 
-	VkDescriptorBufferInfo bufferInfo = {};
-	bufferInfo.buffer = buffer.buffer;
-	bufferInfo.offset = 0;
-	bufferInfo.range = size;
+	for (size_t i = 0; i < sets.size(); i++) {
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = buffer.buffer;
+		bufferInfo.offset = stride * i;
+		bufferInfo.range = size;
 
-	VkWriteDescriptorSet write = {};
-	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write.dstSet = set;
-	write.dstBinding = 0;
-	write.dstArrayElement = 0;
-	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	write.descriptorCount = 1;
-	write.pBufferInfo = &bufferInfo;
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = sets[i];
+		write.dstBinding = 0;
+		write.dstArrayElement = 0;
+		write.descriptorType = type;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &bufferInfo;
 
-	vkUpdateDescriptorSets(renderer.device, 1, &write, 0, nullptr);
+		vkUpdateDescriptorSets(renderer.device, 1, &write, 0, nullptr);
+	}
 }
\ No newline at end of file
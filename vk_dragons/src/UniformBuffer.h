@@ -3,24 +3,28 @@
 #include "Renderer.h"
 #include "ProgramUtilities.h"
 
-//manages one descriptor pool and descriptor set for one uniform buffer
+//manages one descriptor pool and one uniform buffer, split in a slice and a descriptor set per frame in flight
+//so a frame can be written while the previous ones are still read by the GPU. Arrays larger than uniform buffers allow use a storage buffer
 class UniformBuffer {
 public:
-	UniformBuffer(Renderer& renderer, size_t size, VkDescriptorSetLayout layout);
+	UniformBuffer(Renderer& renderer, size_t size, VkDescriptorSetLayout layout, VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 	~UniformBuffer();
 
+	//slice of the current frame
 	char* GetData();
 	void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstSet);
 
 private:
 	Renderer& renderer;
 	size_t size;
+	VkDeviceSize stride;	//size rounded up to the offset alignment of the descriptor type
 	VkDescriptorSetLayout layout;
+	VkDescriptorType type;
 
 	VkDescriptorPool pool;
-	VkDescriptorSet set;
+	std::vector<VkDescriptorSet> sets;
 	Buffer buffer;
 
 	void CreatePool();
-	void CreateSet();
+	void CreateSets();
 };
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "Uploader.h"
+#include "StagingRing.h"
+#include <stdexcept>
+#include <limits>
+
+Uploader::Uploader(Renderer& renderer) : renderer(renderer) {
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = renderer.transferFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	if (vkCreateCommandPool(renderer.device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create upload command pool");
+	}
+}
+
+Uploader::~Uploader() {
+	for (auto& upload : pending) {
+		vkWaitForFences(renderer.device, 1, &upload.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		renderer.staging->CompleteUpload(upload.stagingId);
+		vkDestroyFence(renderer.device, upload.fence, nullptr);
+	}
+	vkDestroyCommandPool(renderer.device, commandPool, nullptr);
+}
+
+UploadBatch Uploader::Begin() {
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	UploadBatch batch = {};
+	if (vkAllocateCommandBuffers(renderer.device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Could not allocate upload command buffer");
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+	return batch;
+}
+
+void Uploader::Submit(UploadBatch& batch, std::function<void(VkCommandBuffer)> onComplete) {
+	renderer.staging->Flush(batch.commandBuffer);
+	RecordOwnership(batch.commandBuffer, batch, true);
+	vkEndCommandBuffer(batch.commandBuffer);
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	if (vkCreateFence(renderer.device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create upload fence");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+	if (vkQueueSubmit(renderer.transferQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+		throw std::runtime_error("Could not submit upload command buffer");
+	}
+
+	pending.push_back({ batch, fence, renderer.staging->EndUpload(), onComplete });
+}
+
+void Uploader::Update(VkCommandBuffer commandBuffer) {
+	//callbacks may submit new uploads, so the finished ones are taken out first
+	std::vector<Pending> finished;
+	for (size_t i = 0; i < pending.size();) {
+		if (vkGetFenceStatus(renderer.device, pending[i].fence) == VK_SUCCESS) {
+			finished.push_back(pending[i]);
+			pending.erase(pending.begin() + i);
+		} else {
+			i++;
+		}
+	}
+
+	for (auto& upload : finished) {
+		RecordOwnership(commandBuffer, upload.batch, false);
+		renderer.staging->CompleteUpload(upload.stagingId);
+		vkDestroyFence(renderer.device, upload.fence, nullptr);
+		vkFreeCommandBuffers(renderer.device, commandPool, 1, &upload.batch.commandBuffer);
+	}
+
+	for (auto& upload : finished) {
+		if (upload.onComplete) upload.onComplete(commandBuffer);
+	}
+}
+
+size_t Uploader::GetPendingCount() {
+	return pending.size();
+}
+
+//release is recorded on the transfer queue and acquire on the graphics queue, with matching family indices
+//when both are the same family, only the graphics side makes the transfer writes visible
+void Uploader::RecordOwnership(VkCommandBuffer commandBuffer, const UploadBatch& batch, bool release) {
+	bool sameFamily = renderer.transferFamily == renderer.graphicsFamily;
+	if (release && sameFamily) return;
+
+	uint32_t srcFamily = sameFamily ? VK_QUEUE_FAMILY_IGNORED : renderer.transferFamily;
+	uint32_t dstFamily = sameFamily ? VK_QUEUE_FAMILY_IGNORED : renderer.graphicsFamily;
+
+	VkAccessFlags srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+	VkAccessFlags dstAccess = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (release) {
+		dstAccess = 0;
+		dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	} else if (!sameFamily) {
+		srcAccess = 0;	//made available by the release
+	}
+
+	std::vector<VkBufferMemoryBarrier> bufferBarriers(batch.buffers.size());
+	for (size_t i = 0; i < batch.buffers.size(); i++) {
+		VkBufferMemoryBarrier& barrier = bufferBarriers[i];
+		barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.buffer = batch.buffers[i];
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers(batch.images.size());
+	for (size_t i = 0; i < batch.images.size(); i++) {
+		VkImageMemoryBarrier& barrier = imageBarriers[i];
+		barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = batch.images[i].layout;
+		barrier.newLayout = batch.images[i].layout;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.image = batch.images[i].image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = batch.images[i].mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = batch.images[i].arrayLayers;
+	}
+
+	if (bufferBarriers.empty() && imageBarriers.empty()) return;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		srcStage, dstStage,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data()
+	);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include "Renderer.h"
+
+//image written by an upload, left in layout for the graphics queue
+struct UploadImage {
+	VkImage image;
+	VkImageLayout layout;
+	uint32_t mipLevels;
+	uint32_t arrayLayers;
+};
+
+//commands and destinations of one upload
+struct UploadBatch {
+	VkCommandBuffer commandBuffer;	//runs on the transfer queue, so copies and barriers only
+	std::vector<VkBuffer> buffers;
+	std::vector<UploadImage> images;
+};
+
+//submits uploads to the transfer queue without waiting for them, the frames keep rendering in the meantime
+//when the transfer family differs from the graphics family, the destinations are released at the end of the upload
+//and acquired in the first frame command buffer recorded after its fence is signaled. Otherwise that frame only gets a barrier
+class Uploader {
+public:
+	Uploader(Renderer& renderer);
+	~Uploader();
+
+	//one batch at a time, the staging ring copies queued until Submit belong to it
+	UploadBatch Begin();
+	//onComplete runs on the main thread, during Update, with the frame command buffer once the destinations can be used there
+	void Submit(UploadBatch& batch, std::function<void(VkCommandBuffer)> onComplete);
+	//record outside of a render pass, before any use of uploaded resources
+	void Update(VkCommandBuffer commandBuffer);
+	size_t GetPendingCount();
+
+private:
+	struct Pending {
+		UploadBatch batch;
+		VkFence fence;
+		uint32_t stagingId;
+		std::function<void(VkCommandBuffer)> onComplete;
+	};
+
+	Renderer& renderer;
+	VkCommandPool commandPool;
+	std::vector<Pending> pending;
+
+	Uploader(const Uploader& other) = delete;
+	Uploader& operator = (const Uploader& other) = delete;
+
+	void RecordOwnership(VkCommandBuffer commandBuffer, const UploadBatch& batch, bool release);
+};
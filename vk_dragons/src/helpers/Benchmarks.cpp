@@ -0,0 +1,403 @@
+#include "Benchmarks.h"
+#include "MeshUtilities.h"
+#include "FileUtilities.h"
+#include "PngDecoder.h"
+#include "ParallelUtilities.h"
+#include "lodepng/lodepng.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+
+//the implementations the benchmarks measure against, as they were before being replaced
+namespace baseline {
+
+	//getline, a stringstream and a vector of strings per line, stof for the numbers, and a std::map of the face strings when indexing
+	void loadObj(const std::string & filename, mesh_t & mesh, LoadMode mode) {
+		std::ifstream in(filename.c_str());
+		if (!in) return;
+
+		mesh.indices.clear();
+		mesh.positions.clear();
+		mesh.normals.clear();
+		mesh.texcoords.clear();
+		std::vector<glm::vec3> positions_temp;
+		std::vector<glm::vec3> normals_temp;
+		std::vector<glm::vec2> texcoords_temp;
+		std::vector<std::string> faces_temp;
+
+		std::string res;
+		while (!in.eof()) {
+			getline(in, res);
+			if (res.empty() || res[0] == '#' || res.size() < 2) continue;
+
+			std::stringstream ss(res);
+			std::vector<std::string> tokens;
+			std::string token;
+			while (ss >> token) tokens.push_back(token);
+			if (tokens.size() < 1) continue;
+
+			if (tokens[0] == "v") {
+				if (tokens.size() < 4) continue;
+				positions_temp.push_back(glm::vec3(stof(tokens[1], NULL), stof(tokens[2], NULL), stof(tokens[3], NULL)));
+			} else if (tokens[0] == "vn") {
+				if (tokens.size() < 4) continue;
+				normals_temp.push_back(glm::vec3(stof(tokens[1], NULL), stof(tokens[2], NULL), stof(tokens[3], NULL)));
+			} else if (tokens[0] == "vt") {
+				if (tokens.size() < 3) continue;
+				texcoords_temp.push_back(glm::vec2(stof(tokens[1], NULL), stof(tokens[2], NULL)));
+			} else if (tokens[0] == "f") {
+				if (tokens.size() < 4) continue;
+				faces_temp.push_back(tokens[1]);
+				faces_temp.push_back(tokens[2]);
+				faces_temp.push_back(tokens[3]);
+			}
+		}
+
+		if (positions_temp.size() == 0) return;
+		bool hasUV = texcoords_temp.size() > 0;
+		bool hasNormals = normals_temp.size() > 0;
+
+		//pushes the attributes of a face corner
+		auto addCorner = [&](const std::string& str) {
+			size_t foundF = str.find_first_of("/");
+			size_t foundL = str.find_last_of("/");
+			mesh.positions.push_back(positions_temp[stol(str.substr(0, foundF)) - 1]);
+			if (hasUV) mesh.texcoords.push_back(texcoords_temp[stol(str.substr(foundF + 1, foundL)) - 1]);
+			if (hasNormals) mesh.normals.push_back(normals_temp[stol(str.substr(foundL + 1)) - 1]);
+		};
+
+		if (mode == Points) {
+			mesh.positions = positions_temp;
+			if (hasNormals) mesh.normals = normals_temp;
+			if (hasUV) mesh.texcoords = texcoords_temp;
+		} else if (mode == Expanded) {
+			for (size_t i = 0; i < faces_temp.size(); i++) {
+				addCorner(faces_temp[i]);
+				mesh.indices.push_back(static_cast<uint32_t>(i));
+			}
+		} else if (mode == Indexed) {
+			std::map<std::string, long> indices_used;
+			long maxInd = 0;
+			for (size_t i = 0; i < faces_temp.size(); i++) {
+				const std::string& str = faces_temp[i];
+				if (indices_used.count(str) > 0) {
+					mesh.indices.push_back(indices_used[str]);
+					continue;
+				}
+				addCorner(str);
+				mesh.indices.push_back(maxInd);
+				indices_used[str] = maxInd;
+				maxInd++;
+			}
+		}
+	}
+
+	//one pass for the centroid, one to translate and find the extent, one to scale
+	void centerAndUnitMesh(mesh_t & mesh) {
+		glm::vec3 centroid = glm::vec3(0.0);
+		float maxi = mesh.positions[0].x;
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			centroid += mesh.positions[i];
+		}
+		centroid /= mesh.positions.size();
+
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			mesh.positions[i] -= centroid;
+			maxi = std::abs(mesh.positions[i].x) > maxi ? std::abs(mesh.positions[i].x) : maxi;
+			maxi = std::abs(mesh.positions[i].y) > maxi ? std::abs(mesh.positions[i].y) : maxi;
+			maxi = std::abs(mesh.positions[i].z) > maxi ? std::abs(mesh.positions[i].z) : maxi;
+		}
+		maxi = maxi == 0.0f ? 1.0f : maxi;
+
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			mesh.positions[i] /= maxi;
+		}
+	}
+
+	//the tangents and binormals are appended, so they have to be empty before
+	void computeTangentsAndBinormals(mesh_t & mesh) {
+		if (mesh.indices.size() * mesh.positions.size() * mesh.texcoords.size() == 0) return;
+
+		for (size_t pid = 0; pid < mesh.positions.size(); ++pid) {
+			mesh.tangents.push_back(glm::vec3(0.0f));
+			mesh.binormals.push_back(glm::vec3(0.0f));
+		}
+		for (size_t fid = 0; fid < mesh.indices.size(); fid += 3) {
+			glm::vec3 & v0 = mesh.positions[mesh.indices[fid]];
+			glm::vec3 & v1 = mesh.positions[mesh.indices[fid + 1]];
+			glm::vec3 & v2 = mesh.positions[mesh.indices[fid + 2]];
+			glm::vec2 & uv0 = mesh.texcoords[mesh.indices[fid]];
+			glm::vec2 & uv1 = mesh.texcoords[mesh.indices[fid + 1]];
+			glm::vec2 & uv2 = mesh.texcoords[mesh.indices[fid + 2]];
+
+			glm::vec3 deltaPosition1 = v1 - v0;
+			glm::vec3 deltaPosition2 = v2 - v0;
+			glm::vec2 deltaUv1 = uv1 - uv0;
+			glm::vec2 deltaUv2 = uv2 - uv0;
+
+			float det = 1.0f / (deltaUv1.x * deltaUv2.y - deltaUv1.y * deltaUv2.x);
+			glm::vec3 tangent = det * (deltaPosition1 * deltaUv2.y - deltaPosition2 * deltaUv1.y);
+			glm::vec3 binormal = det * (deltaPosition2 * deltaUv1.x - deltaPosition1 * deltaUv2.x);
+
+			mesh.tangents[mesh.indices[fid]] += tangent;
+			mesh.tangents[mesh.indices[fid + 1]] += tangent;
+			mesh.tangents[mesh.indices[fid + 2]] += tangent;
+
+			mesh.binormals[mesh.indices[fid]] += binormal;
+			mesh.binormals[mesh.indices[fid + 1]] += binormal;
+			mesh.binormals[mesh.indices[fid + 2]] += binormal;
+		}
+		for (size_t tid = 0; tid < mesh.tangents.size(); ++tid) {
+			mesh.tangents[tid] = glm::normalize(mesh.tangents[tid] - mesh.normals[tid] * glm::dot(mesh.normals[tid], mesh.tangents[tid]));
+			if (glm::dot(glm::cross(mesh.normals[tid], mesh.tangents[tid]), mesh.binormals[tid]) < 0.0f) {
+				mesh.tangents[tid] *= -1.0f;
+			}
+		}
+	}
+
+}
+
+namespace {
+	//the other runs are slowed down by the rest of the system, so only the fastest one is kept
+	const int benchmarkRuns = 10;
+	//whole textures take tens of milliseconds each
+	const int pngBenchmarkRuns = 3;
+
+	//fastest time of function over several runs, in milliseconds
+	template<typename Function>
+	double fastestRun(Function function, int runs = benchmarkRuns) {
+		double best = 0.0;
+		for (int run = 0; run < runs; run++) {
+			auto start = std::chrono::steady_clock::now();
+			function();
+			double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = run == 0 ? time : std::min(best, time);
+		}
+		return best;
+	}
+
+	//the loaders log every file they read, which would drown the results
+	class QuietOutput {
+	public:
+		QuietOutput() : previous(std::cout.rdbuf(nullptr)) {}
+		~QuietOutput() { std::cout.rdbuf(previous); }
+
+	private:
+		std::streambuf* previous;
+	};
+
+	//the throughput is only printed when the amount of data is given, the speedup when the time of the baseline is
+	void printTime(const std::string& name, double milliseconds, size_t bytes = 0, double baseline = 0.0) {
+		std::cout << "  " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(9) << milliseconds << " ms";
+		if (bytes > 0) std::cout << std::setprecision(1) << std::setw(9) << bytes / (milliseconds * 1000.0) << " MB/s";
+		if (baseline > 0.0) std::cout << std::setprecision(1) << std::setw(7) << baseline / milliseconds << "x";
+		std::cout << std::endl;
+	}
+
+	template<typename T>
+	bool sameStream(const std::vector<T>& a, const std::vector<T>& b) {
+		return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	bool sameMesh(const mesh_t& a, const mesh_t& b) {
+		return a.indices == b.indices && sameStream(a.positions, b.positions) && sameStream(a.normals, b.normals) && sameStream(a.texcoords, b.texcoords);
+	}
+
+	//copies side by side, so that small meshes get above the thresholds of the parallel paths
+	mesh_t tileMesh(const mesh_t& mesh, size_t copies) {
+		mesh_t tiled;
+		for (size_t copy = 0; copy < copies; copy++) {
+			uint32_t offset = static_cast<uint32_t>(tiled.positions.size());
+			glm::vec3 shift(3.0f * copy, 0.0f, 0.0f);
+			for (const glm::vec3& position : mesh.positions) tiled.positions.push_back(position + shift);
+			tiled.normals.insert(tiled.normals.end(), mesh.normals.begin(), mesh.normals.end());
+			tiled.texcoords.insert(tiled.texcoords.end(), mesh.texcoords.begin(), mesh.texcoords.end());
+			for (uint32_t index : mesh.indices) tiled.indices.push_back(index + offset);
+		}
+		return tiled;
+	}
+
+	bool loadQuietly(const std::string& path, mesh_t& mesh, MappedFile& file) {
+		if (file.Open(path)) {
+			QuietOutput quiet;
+			loadObj(path, mesh, Indexed);
+		}
+		if (mesh.positions.empty()) {
+			std::cerr << "Unable to load " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+int benchmarkObjLoading(const std::vector<std::string> & paths) {
+	int failures = 0;
+
+	for (const std::string& path : paths) {
+		MappedFile file;
+		mesh_t mesh;
+		if (!loadQuietly(path, mesh, file)) {
+			failures++;
+			continue;
+		}
+
+		std::cout << path << ": " << file.GetSize() << " bytes, " << mesh.positions.size() << " vertices, " << mesh.indices.size() / 3 << " triangles" << std::endl;
+		const struct {
+			const char* name;
+			LoadMode mode;
+		} modes[] = {
+			{ "Points", Points },
+			{ "Expanded", Expanded },
+			{ "Indexed", Indexed }
+		};
+		//the speedups are relative to the baseline loader, on one thread
+		for (auto& mode : modes) {
+			mesh_t reference, loaded;
+			double baselineTime, time, threadedTime;
+			{
+				QuietOutput quiet;
+				baselineTime = fastestRun([&]() {
+					baseline::loadObj(path, reference, mode.mode);
+				});
+				time = fastestRun([&]() {
+					loadObj(path, loaded, mode.mode, 1);
+				});
+				threadedTime = fastestRun([&]() {
+					loadObj(path, loaded, mode.mode, 0);
+				});
+			}
+			printTime(std::string(mode.name) + ", baseline", baselineTime, file.GetSize());
+			printTime(mode.name, time, file.GetSize(), baselineTime);
+			printTime(std::string(mode.name) + ", all threads", threadedTime, file.GetSize(), baselineTime);
+			if (!sameMesh(reference, loaded)) {
+				std::cerr << "The mesh differs from the baseline in " << mode.name << " mode for " << path << std::endl;
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+int benchmarkMeshProcessing(const std::vector<std::string> & paths) {
+	int failures = 0;
+
+	for (const std::string& path : paths) {
+		MappedFile file;
+		mesh_t mesh;
+		if (!loadQuietly(path, mesh, file)) {
+			failures++;
+			continue;
+		}
+
+		//all functions can run again on their own output, with the same amount of work
+		//the speedups are relative to the baseline functions
+		mesh_t meshes[] = { mesh, tileMesh(mesh, 16) };
+		const char* names[] = { "", ", 16 copies" };
+		for (size_t i = 0; i < 2; i++) {
+			mesh_t& processed = meshes[i];
+			const size_t bytes = processed.positions.size() * sizeof(glm::vec3);
+			std::cout << path << names[i] << ": " << processed.positions.size() << " vertices, " << processed.indices.size() / 3 << " triangles" << std::endl;
+
+			const double baselineCentering = fastestRun([&]() {
+				baseline::centerAndUnitMesh(processed);
+			});
+			printTime("Centering, baseline", baselineCentering, bytes);
+			printTime("Centering", fastestRun([&]() {
+				centerAndUnitMesh(processed);
+			}), bytes, baselineCentering);
+
+			const double baselineTangents = fastestRun([&]() {
+				processed.tangents.clear();
+				processed.binormals.clear();
+				baseline::computeTangentsAndBinormals(processed);
+			});
+			printTime("Tangents, baseline", baselineTangents);
+			printTime("Tangents", fastestRun([&]() {
+				computeTangentsAndBinormals(processed, 1);
+			}), 0, baselineTangents);
+			printTime("Tangents, all threads", fastestRun([&]() {
+				computeTangentsAndBinormals(processed, 0);
+			}), 0, baselineTangents);
+		}
+	}
+
+	return failures;
+}
+
+int benchmarkPngDecoding(const std::vector<std::string> & directories) {
+	int failures = 0;
+
+	for (const std::string& directory : directories) {
+		std::vector<std::unique_ptr<PngImage>> images;
+		std::vector<std::vector<unsigned char>> decoded;
+		double lodepngTotal = 0.0;
+		double decoderTotal = 0.0;
+		size_t bytesTotal = 0;
+
+		for (const std::string& path : listFiles(directory, ".png")) {
+			std::unique_ptr<PngImage> image(new PngImage());
+			MappedFile file;
+			if (!image->Open(path) || !file.Open(path)) {
+				std::cerr << "Unable to open " << path << std::endl;
+				failures++;
+				continue;
+			}
+			const unsigned char* data = reinterpret_cast<const unsigned char*>(file.GetData());
+			size_t size = image->GetDecodedSize();
+			std::cout << path << ": " << image->GetWidth() << "x" << image->GetHeight() << std::endl;
+
+			//textures are uploaded bottom row first, which lodepng needs an extra copy for
+			std::vector<unsigned char> reference(size);
+			bool lodepngValid = true;
+			double lodepngTime = fastestRun([&]() {
+				std::vector<unsigned char> rows;
+				unsigned width, height;
+				lodepngValid = lodepng::decode(rows, width, height, data, file.GetSize()) == 0 && rows.size() == size;
+				if (!lodepngValid) return;
+				size_t rowSize = size_t(width) * 4;
+				for (unsigned y = 0; y < height; y++) {
+					memcpy(&reference[(height - 1 - y) * rowSize], &rows[y * rowSize], rowSize);
+				}
+			}, pngBenchmarkRuns);
+
+			std::vector<unsigned char> dest(size);
+			bool decoderValid = true;
+			double decoderTime = fastestRun([&]() {
+				decoderValid = image->Decode(dest.data());
+			}, pngBenchmarkRuns);
+
+			printTime("lodepng + flip", lodepngTime, size);
+			printTime("PngImage", decoderTime, size);
+			if (!lodepngValid || !decoderValid || dest != reference) {
+				std::cerr << "Decoded images differ for " << path << std::endl;
+				failures++;
+			}
+
+			lodepngTotal += lodepngTime;
+			decoderTotal += decoderTime;
+			bytesTotal += size;
+			images.push_back(std::move(image));
+			decoded.push_back(std::move(dest));
+		}
+		if (images.empty()) continue;
+
+		std::cout << directory << ": " << images.size() << " files" << std::endl;
+		printTime("lodepng + flip", lodepngTotal, bytesTotal);
+		printTime("PngImage", decoderTotal, bytesTotal);
+		printTime("PngImage, all threads", fastestRun([&]() {
+			parallelFor(images.size(), parallelThreadCount(images.size(), 1), [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) images[i]->Decode(decoded[i].data());
+			});
+		}, pngBenchmarkRuns), bytesTotal);
+	}
+
+	return failures;
+}
@@ -0,0 +1,21 @@
+#ifndef Benchmarks_h
+#define Benchmarks_h
+
+#include <string>
+#include <vector>
+
+/// Time loadObj on each file in the three load modes, on one thread and with the default thread count, against the getline and stringstream
+/// loader it replaced. Every measure is the fastest of several runs. Returns the number of files that could not be loaded or that don't give
+/// the same mesh with both loaders.
+int benchmarkObjLoading(const std::vector<std::string> & paths);
+
+/// Time centerAndUnitMesh and computeTangentsAndBinormals alone on each file, and on 16 copies of it merged in one mesh,
+/// with one thread and with all hardware threads, against the versions they replaced. Returns the number of files that could not be loaded.
+int benchmarkMeshProcessing(const std::vector<std::string> & paths);
+
+/// Time the decoding of every .png file of each directory with PngImage and with lodepng followed by the flip it needs,
+/// then PngImage on all the files of a directory at once, one per thread. Returns the number of files that could not be decoded
+/// or that don't give the same image with both decoders.
+int benchmarkPngDecoding(const std::vector<std::string> & directories);
+
+#endif
@@ -0,0 +1,371 @@
+#include "BlockCompression.h"
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+	// Principal axis of the first N channels of a block, by power iteration on their covariance.
+	// The axis is zero when every pixel is the same.
+	template<int N>
+	void principalAxis(const float colors[16][4], float mean[4], float axis[4]) {
+		for (int c = 0; c < 4; c++) {
+			mean[c] = 0.0f;
+			axis[c] = 0.0f;
+		}
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < N; c++) mean[c] += colors[i][c] / 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++) {
+			for (int a = 0; a < N; a++) {
+				for (int b = 0; b < N; b++) {
+					covariance[a][b] += (colors[i][a] - mean[a]) * (colors[i][b] - mean[b]);
+				}
+			}
+		}
+
+		// Start from the row of the channel that varies the most, it can't be orthogonal to the axis.
+		int largest = 0;
+		for (int c = 1; c < N; c++) {
+			if (covariance[c][c] > covariance[largest][largest]) largest = c;
+		}
+		if (covariance[largest][largest] <= 0.0f) return;
+		for (int c = 0; c < N; c++) axis[c] = covariance[largest][c];
+
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[4] = {};
+			float scale = 0.0f;
+			for (int a = 0; a < N; a++) {
+				for (int b = 0; b < N; b++) next[a] += covariance[a][b] * axis[b];
+				scale = std::max(scale, std::abs(next[a]));
+			}
+			if (scale == 0.0f) return;
+			for (int c = 0; c < N; c++) axis[c] = next[c] / scale;
+		}
+
+		float length = 0.0f;
+		for (int c = 0; c < N; c++) length += axis[c] * axis[c];
+		length = std::sqrt(length);
+		for (int c = 0; c < N; c++) axis[c] /= length;
+	}
+
+	// Endpoints at the extremes of the projection of the colors on their principal axis.
+	template<int N>
+	void axisEndpoints(const float colors[16][4], float start[4], float end[4]) {
+		float mean[4];
+		float axis[4];
+		principalAxis<N>(colors, mean, axis);
+
+		float low = 0.0f;
+		float high = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			float t = 0.0f;
+			for (int c = 0; c < N; c++) t += (colors[i][c] - mean[c]) * axis[c];
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+		for (int c = 0; c < 4; c++) {
+			start[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * high));
+			end[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * low));
+		}
+	}
+
+	// Least squares endpoints for fixed indices, where weights[i] is how much of the second endpoint pixel i gets.
+	// Returns false if every pixel uses the same weight.
+	template<int N>
+	bool fitEndpoints(const float colors[16][4], const float weights[16], float start[4], float end[4]) {
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int i = 0; i < 16; i++) {
+			float b = weights[i];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < N; c++) {
+				ax[c] += a * colors[i][c];
+				bx[c] += b * colors[i][c];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f) return false;
+		for (int c = 0; c < N; c++) {
+			start[c] = std::min(255.0f, std::max(0.0f, (bb * ax[c] - ab * bx[c]) / determinant));
+			end[c] = std::min(255.0f, std::max(0.0f, (aa * bx[c] - ab * ax[c]) / determinant));
+		}
+		return true;
+	}
+
+	// BC1: two RGB565 endpoints and 2 bits per pixel. The first endpoint is the larger, which selects the four colors mode.
+
+	uint16_t packRgb565(const float color[4]) {
+		unsigned r = static_cast<unsigned>(color[0] * 31.0f / 255.0f + 0.5f);
+		unsigned g = static_cast<unsigned>(color[1] * 63.0f / 255.0f + 0.5f);
+		unsigned b = static_cast<unsigned>(color[2] * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void unpackRgb565(uint16_t packed, int color[3]) {
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Orders the endpoints and picks the closest palette entry for each pixel. Returns the squared error.
+	float encodeBC1Indices(const float colors[16][4], uint16_t & color0, uint16_t & color1, uint32_t & indices) {
+		if (color0 < color1) std::swap(color0, color1);
+
+		int palette[4][3];
+		unpackRgb565(color0, palette[0]);
+		unpackRgb565(color1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		// Equal endpoints select the three colors mode, where only the first entry is still the same.
+		int entries = color0 == color1 ? 1 : 4;
+
+		float total = 0.0f;
+		indices = 0;
+		for (int i = 0; i < 16; i++) {
+			float best = 1e30f;
+			uint32_t bestIndex = 0;
+			for (int e = 0; e < entries; e++) {
+				float error = 0.0f;
+				for (int c = 0; c < 3; c++) {
+					float d = colors[i][c] - palette[e][c];
+					error += d * d;
+				}
+				if (error < best) {
+					best = error;
+					bestIndex = static_cast<uint32_t>(e);
+				}
+			}
+			indices |= bestIndex << (2 * i);
+			total += best;
+		}
+		return total;
+	}
+
+	void compressBC1Block(const float colors[16][4], unsigned char * out) {
+		float start[4];
+		float end[4];
+		axisEndpoints<3>(colors, start, end);
+
+		// Pull the endpoints in a bit, the extremes are rarely the best fit once quantized.
+		for (int c = 0; c < 3; c++) {
+			float inset = (start[c] - end[c]) / 16.0f;
+			start[c] -= inset;
+			end[c] += inset;
+		}
+
+		uint16_t color0 = packRgb565(start);
+		uint16_t color1 = packRgb565(end);
+		uint32_t indices;
+		float error = encodeBC1Indices(colors, color0, color1, indices);
+
+		// One refinement pass, with the endpoints fitted to the chosen indices.
+		const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float pixelWeights[16];
+		for (int i = 0; i < 16; i++) pixelWeights[i] = weights[(indices >> (2 * i)) & 3];
+		if (fitEndpoints<3>(colors, pixelWeights, start, end)) {
+			uint16_t refined0 = packRgb565(start);
+			uint16_t refined1 = packRgb565(end);
+			uint32_t refinedIndices;
+			if (encodeBC1Indices(colors, refined0, refined1, refinedIndices) < error) {
+				color0 = refined0;
+				color1 = refined1;
+				indices = refinedIndices;
+			}
+		}
+
+		out[0] = static_cast<unsigned char>(color0 & 255);
+		out[1] = static_cast<unsigned char>(color0 >> 8);
+		out[2] = static_cast<unsigned char>(color1 & 255);
+		out[3] = static_cast<unsigned char>(color1 >> 8);
+		for (int i = 0; i < 4; i++) out[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+	}
+
+	// BC4: one channel, two 8 bits endpoints and 3 bits per pixel, in the eight values mode.
+	void compressBC4Block(const float colors[16][4], int channel, unsigned char * out) {
+		int high = 0;
+		int low = 255;
+		for (int i = 0; i < 16; i++) {
+			int value = static_cast<int>(colors[i][channel]);
+			high = std::max(high, value);
+			low = std::min(low, value);
+		}
+
+		int palette[8] = { high, low };
+		for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * high + (i - 1) * low) / 7;
+
+		uint64_t bits = uint64_t(high) | (uint64_t(low) << 8);
+		if (high != low) {
+			for (int i = 0; i < 16; i++) {
+				int value = static_cast<int>(colors[i][channel]);
+				int bestIndex = 0;
+				for (int e = 1; e < 8; e++) {
+					if (std::abs(palette[e] - value) < std::abs(palette[bestIndex] - value)) bestIndex = e;
+				}
+				bits |= uint64_t(bestIndex) << (16 + 3 * i);
+			}
+		}
+		for (int i = 0; i < 8; i++) out[i] = static_cast<unsigned char>(bits >> (8 * i));
+	}
+
+	// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a low bit shared by the channels of each endpoint, 4 bits per pixel.
+
+	const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct BC7Endpoints {
+		int values[2][4];	// 7 bits
+		int pbits[2];
+	};
+
+	// Keeps the low bit that gives the smallest error over the four channels.
+	void quantizeBC7Endpoint(const float color[4], int values[4], int & pbit) {
+		float best = 1e30f;
+		for (int p = 0; p < 2; p++) {
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++) {
+				candidate[c] = std::min(127, std::max(0, static_cast<int>((color[c] - p) / 2.0f + 0.5f)));
+				float d = color[c] - ((candidate[c] << 1) | p);
+				error += d * d;
+			}
+			if (error < best) {
+				best = error;
+				pbit = p;
+				memcpy(values, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	float encodeBC7Indices(const float colors[16][4], const BC7Endpoints & endpoints, int indices[16]) {
+		int palette[16][4];
+		for (int c = 0; c < 4; c++) {
+			int e0 = (endpoints.values[0][c] << 1) | endpoints.pbits[0];
+			int e1 = (endpoints.values[1][c] << 1) | endpoints.pbits[1];
+			for (int w = 0; w < 16; w++) palette[w][c] = ((64 - bc7Weights[w]) * e0 + bc7Weights[w] * e1 + 32) >> 6;
+		}
+
+		float total = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			float best = 1e30f;
+			for (int w = 0; w < 16; w++) {
+				float error = 0.0f;
+				for (int c = 0; c < 4; c++) {
+					float d = colors[i][c] - palette[w][c];
+					error += d * d;
+				}
+				if (error < best) {
+					best = error;
+					indices[i] = w;
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	void writeBits(uint64_t bits[2], unsigned & position, uint64_t value, unsigned count) {
+		bits[position / 64] |= value << (position % 64);
+		if (position % 64 + count > 64) bits[position / 64 + 1] |= value >> (64 - position % 64);
+		position += count;
+	}
+
+	void compressBC7Block(const float colors[16][4], unsigned char * out) {
+		float start[4];
+		float end[4];
+		axisEndpoints<4>(colors, start, end);
+
+		BC7Endpoints endpoints;
+		quantizeBC7Endpoint(start, endpoints.values[0], endpoints.pbits[0]);
+		quantizeBC7Endpoint(end, endpoints.values[1], endpoints.pbits[1]);
+		int indices[16];
+		float error = encodeBC7Indices(colors, endpoints, indices);
+
+		float pixelWeights[16];
+		for (int i = 0; i < 16; i++) pixelWeights[i] = bc7Weights[indices[i]] / 64.0f;
+		if (fitEndpoints<4>(colors, pixelWeights, start, end)) {
+			BC7Endpoints refined;
+			quantizeBC7Endpoint(start, refined.values[0], refined.pbits[0]);
+			quantizeBC7Endpoint(end, refined.values[1], refined.pbits[1]);
+			int refinedIndices[16];
+			if (encodeBC7Indices(colors, refined, refinedIndices) < error) {
+				endpoints = refined;
+				memcpy(indices, refinedIndices, sizeof(indices));
+			}
+		}
+
+		// The most significant bit of the first index is implicitly 0, the endpoints are swapped to make it so.
+		if (indices[0] >= 8) {
+			std::swap(endpoints.values[0], endpoints.values[1]);
+			std::swap(endpoints.pbits[0], endpoints.pbits[1]);
+			for (int i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+		}
+
+		uint64_t bits[2] = {};
+		unsigned position = 0;
+		writeBits(bits, position, 1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			writeBits(bits, position, endpoints.values[0][c], 7);
+			writeBits(bits, position, endpoints.values[1][c], 7);
+		}
+		writeBits(bits, position, endpoints.pbits[0], 1);
+		writeBits(bits, position, endpoints.pbits[1], 1);
+		writeBits(bits, position, indices[0], 3);
+		for (int i = 1; i < 16; i++) writeBits(bits, position, indices[i], 4);
+
+		for (int i = 0; i < 16; i++) out[i] = static_cast<unsigned char>(bits[i / 8] >> (8 * (i % 8)));
+	}
+}
+
+size_t blockSize(BlockFormat format) {
+	return format == BC1 ? 8 : 16;
+}
+
+size_t compressedImageSize(BlockFormat format, unsigned width, unsigned height) {
+	return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+void compressImage(BlockFormat format, const unsigned char * rgba, unsigned width, unsigned height, unsigned char * out) {
+	unsigned blocksX = (width + 3) / 4;
+	unsigned blocksY = (height + 3) / 4;
+
+	for (unsigned by = 0; by < blocksY; by++) {
+		for (unsigned bx = 0; bx < blocksX; bx++) {
+			float colors[16][4];
+			for (unsigned j = 0; j < 4; j++) {
+				for (unsigned i = 0; i < 4; i++) {
+					unsigned x = std::min(bx * 4 + i, width - 1);
+					unsigned y = std::min(by * 4 + j, height - 1);
+					const unsigned char * pixel = rgba + (size_t(y) * width + x) * 4;
+					for (int c = 0; c < 4; c++) colors[j * 4 + i][c] = pixel[c];
+				}
+			}
+
+			unsigned char * block = out + (size_t(by) * blocksX + bx) * blockSize(format);
+			switch (format) {
+			case BC1:
+				compressBC1Block(colors, block);
+				break;
+			case BC5:
+				compressBC4Block(colors, 0, block);
+				compressBC4Block(colors, 1, block + 8);
+				break;
+			case BC7:
+				compressBC7Block(colors, block);
+				break;
+			}
+		}
+	}
+}
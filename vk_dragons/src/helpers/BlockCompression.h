@@ -0,0 +1,22 @@
+#ifndef BlockCompression_h
+#define BlockCompression_h
+
+#include <cstddef>
+
+/// Block compressed formats, 4x4 pixels per block.
+enum BlockFormat {
+	BC1, BC5, BC7
+};
+
+/// Bytes per 4x4 block: 8 for BC1, 16 for BC5 and BC7.
+size_t blockSize(BlockFormat format);
+
+/// Bytes of an image of the given size once compressed. Partial blocks on the edges count as whole ones.
+size_t compressedImageSize(BlockFormat format, unsigned width, unsigned height);
+
+/// Compress an 8 bits RGBA image, rows stored one after the other, into out.
+/// BC1 keeps the RGB channels, BC5 the red and green ones as two independent channels, BC7 all four (mode 6 only).
+/// Partial blocks on the edges repeat the last column and row of the image.
+void compressImage(BlockFormat format, const unsigned char * rgba, unsigned width, unsigned height, unsigned char * out);
+
+#endif
@@ -0,0 +1,166 @@
+#include "FileUtilities.h"
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+	data = nullptr;
+	size = 0;
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string & filename) {
+	Close();
+
+	file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		Close();
+		return false;
+	}
+
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		Close();
+		return false;
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const std::string & filename) {
+	Close();
+
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0) return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		close(file);
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	//the mapping stays valid after the descriptor is closed
+	close(file);
+	if (mapped == MAP_FAILED) return false;
+
+	data = static_cast<const char*>(mapped);
+	size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data != nullptr) munmap(const_cast<char*>(data), size);
+	data = nullptr;
+	size = 0;
+}
+
+#endif
+
+const char * MappedFile::GetData() const {
+	return data;
+}
+
+size_t MappedFile::GetSize() const {
+	return size;
+}
+
+bool getFileInfo(const std::string & filename, file_info_t & info) {
+	struct stat status;
+	if (stat(filename.c_str(), &status) != 0) return false;
+
+	info.size = static_cast<uint64_t>(status.st_size);
+	info.time = static_cast<int64_t>(status.st_mtime);
+	return true;
+}
+
+std::vector<std::string> listFiles(const std::string & directory, const std::string & extension) {
+	std::vector<std::string> names;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA((directory + "/*" + extension).c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE) return names;
+	do {
+		if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+			names.push_back(directory + "/" + entry.cFileName);
+		}
+	} while (FindNextFileA(find, &entry));
+	FindClose(find);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr) return names;
+	while (dirent* entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0) {
+			names.push_back(directory + "/" + name);
+		}
+	}
+	closedir(dir);
+#endif
+
+	return names;
+}
+
+uint64_t hashBuffer(const char * data, size_t size) {
+	//not FNV-1a, which mixes one byte per multiply: this processes 8 bytes at a time, with a multiply-xorshift mix per word
+	//only the seed comes from FNV, the multiplier is the 64 bits golden ratio. The size is mixed in so that trailing zeros count
+	const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+	uint64_t hash = 0xCBF29CE484222325ull ^ (size * multiplier);
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * multiplier;
+		hash ^= hash >> 29;
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, data + i, size - i);
+	hash = (hash ^ tail) * multiplier;
+	hash ^= hash >> 32;
+	return hash;
+}
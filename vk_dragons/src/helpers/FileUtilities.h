@@ -0,0 +1,49 @@
+#ifndef FileUtilities_h
+#define FileUtilities_h
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	/// Map the file. Returns false if it doesn't exist or is empty.
+	bool Open(const std::string & filename);
+	void Close();
+
+	const char * GetData() const;
+	size_t GetSize() const;
+
+private:
+	const char * data;
+	size_t size;
+#ifdef _WIN32
+	void * file;
+	void * mapping;
+#endif
+
+	MappedFile(const MappedFile & other) = delete;
+	MappedFile & operator = (const MappedFile & other) = delete;
+};
+
+/// Size and last modification time of a file on disk.
+typedef struct {
+	uint64_t size;
+	int64_t time;
+} file_info_t;
+
+/// Query the size and modification time of a file. Returns false if it doesn't exist.
+bool getFileInfo(const std::string & filename, file_info_t & info);
+
+/// List the files with the given extension (".obj") in a directory, without recursion.
+std::vector<std::string> listFiles(const std::string & directory, const std::string & extension);
+
+/// Fast non-cryptographic 64 bits hash of a buffer, used to detect content changes. Word at a time, it is not FNV-1a and gives other values.
+uint64_t hashBuffer(const char * data, size_t size);
+
+#endif
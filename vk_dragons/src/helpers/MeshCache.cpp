@@ -0,0 +1,196 @@
+#include "MeshCache.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+//bump when the layout or the processing of the cached mesh changes, to invalidate existing caches
+#define MESH_CACHE_VERSION 4
+#define MESH_CACHE_ALIGNMENT 16
+
+namespace {
+	const char meshCacheMagic[8] = { 'V', 'K', 'M', 'E', 'S', 'H', 0, 0 };
+
+	enum MeshStream {
+		Positions, Normals, Tangents, Binormals, Texcoords, Indices, Lods, StreamCount
+	};
+
+	struct MeshCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t streamCount;
+		//state of the source .obj when the cache was written
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t sourceHash;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t lodCount;
+		//byte offset from the start of the file and byte size of each stream, 0 if absent
+		uint64_t streamOffsets[StreamCount];
+		uint64_t streamSizes[StreamCount];
+	};
+
+	uint64_t alignOffset(uint64_t offset) {
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~uint64_t(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	bool hashFile(const std::string & filename, uint64_t & hash) {
+		MappedFile file;
+		if (!file.Open(filename)) return false;
+		hash = hashBuffer(file.GetData(), file.GetSize());
+		return true;
+	}
+
+	template<typename T>
+	const T* streamPointer(const MappedFile & file, const MeshCacheHeader & header, MeshStream stream) {
+		if (header.streamSizes[stream] == 0) return nullptr;
+		return reinterpret_cast<const T*>(file.GetData() + header.streamOffsets[stream]);
+	}
+}
+
+std::unique_ptr<MeshCache> MeshCache::Open(const std::string & cachePath, const std::string & sourcePath) {
+	std::unique_ptr<MeshCache> cache(new MeshCache());
+	if (!cache->file.Open(cachePath)) return nullptr;
+
+	const MappedFile & file = cache->file;
+	if (file.GetSize() < sizeof(MeshCacheHeader)) return nullptr;
+
+	MeshCacheHeader header;
+	memcpy(&header, file.GetData(), sizeof(MeshCacheHeader));
+	if (memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 || header.version != MESH_CACHE_VERSION || header.streamCount != StreamCount) {
+		return nullptr;
+	}
+
+	//check that every stream is inside the file, aligned, and has the expected size
+	const uint64_t elementSizes[StreamCount] = { sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec2), sizeof(uint32_t), sizeof(mesh_lod_t) };
+	for (uint32_t i = 0; i < StreamCount; i++) {
+		if (header.streamSizes[i] == 0) continue;
+		uint64_t count = i == Indices ? header.indexCount : i == Lods ? header.lodCount : header.vertexCount;
+		if (header.streamOffsets[i] % MESH_CACHE_ALIGNMENT != 0 ||
+			header.streamSizes[i] != count * elementSizes[i] ||
+			header.streamOffsets[i] + header.streamSizes[i] > file.GetSize()) {
+			return nullptr;
+		}
+	}
+
+	//invalidation: a source with the same size and time is trusted, otherwise its content is hashed
+	file_info_t info;
+	if (getFileInfo(sourcePath, info) && (info.size != header.sourceSize || info.time != header.sourceTime)) {
+		uint64_t hash;
+		if (!hashFile(sourcePath, hash) || hash != header.sourceHash) return nullptr;
+	}
+
+	mesh_view_t& view = cache->view;
+	view.positions = streamPointer<glm::vec3>(file, header, Positions);
+	view.normals = streamPointer<glm::vec3>(file, header, Normals);
+	view.tangents = streamPointer<glm::vec3>(file, header, Tangents);
+	view.binormals = streamPointer<glm::vec3>(file, header, Binormals);
+	view.texcoords = streamPointer<glm::vec2>(file, header, Texcoords);
+	view.indices = streamPointer<uint32_t>(file, header, Indices);
+	view.lods = streamPointer<mesh_lod_t>(file, header, Lods);
+	view.vertexCount = static_cast<size_t>(header.vertexCount);
+	view.indexCount = static_cast<size_t>(header.indexCount);
+	view.lodCount = static_cast<size_t>(header.lodCount);
+
+	//level ranges are used for drawing, so they have to stay inside the index buffer
+	for (size_t i = 0; i < view.lodCount; i++) {
+		if (uint64_t(view.lods[i].firstIndex) + view.lods[i].indexCount > header.indexCount) return nullptr;
+	}
+
+	return cache;
+}
+
+bool MeshCache::Write(const std::string & cachePath, const mesh_t & mesh, const std::string & sourcePath) {
+	MeshCacheHeader header = {};
+	memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+	header.version = MESH_CACHE_VERSION;
+	header.streamCount = StreamCount;
+
+	file_info_t info;
+	if (!getFileInfo(sourcePath, info) || !hashFile(sourcePath, header.sourceHash)) return false;
+	header.sourceSize = info.size;
+	header.sourceTime = info.time;
+
+	mesh_view_t view = makeMeshView(mesh);
+	header.vertexCount = view.vertexCount;
+	header.indexCount = view.indexCount;
+	header.lodCount = view.lodCount;
+
+	const void* streams[StreamCount] = { view.positions, view.normals, view.tangents, view.binormals, view.texcoords, view.indices, view.lods };
+	const uint64_t streamSizes[StreamCount] = {
+		mesh.positions.size() * sizeof(glm::vec3),
+		mesh.normals.size() * sizeof(glm::vec3),
+		mesh.tangents.size() * sizeof(glm::vec3),
+		mesh.binormals.size() * sizeof(glm::vec3),
+		mesh.texcoords.size() * sizeof(glm::vec2),
+		mesh.indices.size() * sizeof(uint32_t),
+		mesh.lods.size() * sizeof(mesh_lod_t)
+	};
+
+	uint64_t offset = alignOffset(sizeof(MeshCacheHeader));
+	for (uint32_t i = 0; i < StreamCount; i++) {
+		if (streamSizes[i] == 0) continue;
+		header.streamOffsets[i] = offset;
+		header.streamSizes[i] = streamSizes[i];
+		offset = alignOffset(offset + streamSizes[i]);
+	}
+
+	//write to a temporary file first, so that a failed write never leaves a truncated cache behind
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		const char padding[MESH_CACHE_ALIGNMENT] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+		uint64_t written = sizeof(MeshCacheHeader);
+		for (uint32_t i = 0; i < StreamCount; i++) {
+			if (streamSizes[i] == 0) continue;
+			out.write(padding, static_cast<std::streamsize>(header.streamOffsets[i] - written));
+			out.write(static_cast<const char*>(streams[i]), static_cast<std::streamsize>(streamSizes[i]));
+			written = header.streamOffsets[i] + streamSizes[i];
+		}
+
+		if (!out) {
+			out.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	std::remove(cachePath.c_str());
+	return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
+
+const mesh_view_t & MeshCache::GetView() const {
+	return view;
+}
+
+std::string meshCachePath(const std::string & objPath) {
+	size_t dot = objPath.find_last_of('.');
+	size_t slash = objPath.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return objPath + ".vkmesh";
+	}
+	return objPath.substr(0, dot) + ".vkmesh";
+}
+
+int bakeMeshCaches(const std::string & directory) {
+	int failures = 0;
+
+	for (const std::string& objPath : listFiles(directory, ".obj")) {
+		mesh_t mesh;
+		loadProcessedMesh(objPath, mesh, 0);
+
+		std::string cachePath = meshCachePath(objPath);
+		if (MeshCache::Write(cachePath, mesh, objPath)) {
+			std::cout << "Baked: " << cachePath << std::endl;
+		} else {
+			std::cerr << "Unable to write the mesh cache " << cachePath << std::endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
@@ -0,0 +1,33 @@
+#ifndef MeshCache_h
+#define MeshCache_h
+
+#include <string>
+#include <memory>
+#include "MeshUtilities.h"
+#include "FileUtilities.h"
+
+/// A processed mesh stored in a binary .vkmesh file, mapped in memory.
+/// The streams are 16 bytes aligned in the file and are used in place, without any copy.
+class MeshCache {
+public:
+	/// Map the cache if it exists and matches its source .obj file (same size and time, or same content hash).
+	/// If the source is missing, the cache is used as is. Returns nullptr when the cache can't be used.
+	static std::unique_ptr<MeshCache> Open(const std::string & cachePath, const std::string & sourcePath);
+
+	/// Write a processed mesh to a cache file, tagged with the current state of its source .obj file.
+	static bool Write(const std::string & cachePath, const mesh_t & mesh, const std::string & sourcePath);
+
+	const mesh_view_t & GetView() const;
+
+private:
+	MappedFile file;
+	mesh_view_t view;
+};
+
+/// Path of the cache associated with an .obj file ("dragon.obj" -> "dragon.vkmesh").
+std::string meshCachePath(const std::string & objPath);
+
+/// Process every .obj file of a directory and write their caches. Returns the number of failures.
+int bakeMeshCaches(const std::string & directory);
+
+#endif
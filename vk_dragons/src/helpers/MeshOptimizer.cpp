@@ -0,0 +1,573 @@
+#include "MeshOptimizer.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+	const uint32_t invalidIndex = 0xFFFFFFFF;
+
+	// Parameters of Forsyth's scoring: LRU cache size, score of the last triangle vertices,
+	// decay of the score with the position in the cache, and boost of the vertices with few triangles left.
+	const size_t maxCacheSize = 32;
+	const float lastTriangleScore = 0.75f;
+	const float cacheDecayPower = 1.5f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+	const uint32_t valenceTableSize = 64;
+
+	struct VertexScorer {
+		float cacheScores[maxCacheSize];
+		float valenceScores[valenceTableSize];
+
+		VertexScorer(){
+			for(size_t i = 0; i < maxCacheSize; ++i){
+				if(i < 3){
+					cacheScores[i] = lastTriangleScore;
+				} else {
+					float scaled = 1.0f - float(i - 3) / float(maxCacheSize - 3);
+					cacheScores[i] = pow(scaled, cacheDecayPower);
+				}
+			}
+			for(uint32_t i = 0; i < valenceTableSize; ++i){
+				valenceScores[i] = i == 0 ? 0.0f : valenceBoostScale * pow(float(i), -valenceBoostPower);
+			}
+		}
+
+		float score(int cachePosition, uint32_t remaining) const {
+			if(remaining == 0){
+				// No triangle left to emit with this vertex.
+				return -1.0f;
+			}
+			float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+			score += remaining < valenceTableSize ? valenceScores[remaining] : valenceBoostScale * pow(float(remaining), -valenceBoostPower);
+			return score;
+		}
+	};
+
+	// FIFO cache simulation, using timestamps: a vertex is in the cache if it was inserted less than cacheSize misses ago.
+	struct FifoCache {
+		vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t size;
+
+		FifoCache(size_t vertexCount, size_t cacheSize) : timestamps(vertexCount, 0), time(uint32_t(cacheSize) + 1), size(uint32_t(cacheSize)) {
+		}
+
+		void flush(){
+			time += size + 1;
+		}
+
+		// Returns the number of misses for a triangle.
+		unsigned int update(const uint32_t * triangle){
+			unsigned int misses = 0;
+			for(int k = 0; k < 3; ++k){
+				uint32_t vertex = triangle[k];
+				if(time - timestamps[vertex] > size){
+					timestamps[vertex] = time++;
+					++misses;
+				}
+			}
+			return misses;
+		}
+	};
+
+}
+
+vertex_cache_stats_t analyzeVertexCache(const std::vector<uint32_t> & indices, size_t vertexCount, size_t cacheSize){
+	vertex_cache_stats_t stats = { 0.0f, 0.0f };
+	if(indices.size() < 3){
+		return stats;
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	vector<char> referenced(vertexCount, 0);
+	size_t misses = 0;
+	size_t referencedCount = 0;
+	for(size_t i = 0; i + 2 < indices.size(); i += 3){
+		misses += cache.update(&indices[i]);
+		for(int k = 0; k < 3; ++k){
+			if(!referenced[indices[i + k]]){
+				referenced[indices[i + k]] = 1;
+				++referencedCount;
+			}
+		}
+	}
+
+	stats.acmr = float(misses) / float(indices.size() / 3);
+	stats.atvr = float(misses) / float(referencedCount);
+	return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> & indices, size_t vertexCount){
+	const size_t triangleCount = indices.size() / 3;
+	if(triangleCount == 0){
+		return;
+	}
+	const VertexScorer scorer;
+
+	// Triangles adjacent to each vertex, stored contiguously. The first remaining[v] entries of a vertex are the triangles not emitted yet.
+	vector<uint32_t> remaining(vertexCount, 0);
+	for(size_t i = 0; i < triangleCount * 3; ++i){
+		++remaining[indices[i]];
+	}
+	vector<uint32_t> offsets(vertexCount + 1, 0);
+	for(size_t vid = 0; vid < vertexCount; ++vid){
+		offsets[vid + 1] = offsets[vid] + remaining[vid];
+	}
+	vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for(size_t i = 0; i < triangleCount * 3; ++i){
+			adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+		}
+	}
+
+	// Initial scores, no vertex is in the cache.
+	vector<int> cachePositions(vertexCount, -1);
+	vector<float> vertexScores(vertexCount);
+	for(size_t vid = 0; vid < vertexCount; ++vid){
+		vertexScores[vid] = scorer.score(-1, remaining[vid]);
+	}
+	vector<float> triangleScores(triangleCount);
+	uint32_t best = 0;
+	for(size_t tid = 0; tid < triangleCount; ++tid){
+		const uint32_t * triangle = &indices[3 * tid];
+		triangleScores[tid] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+		if(triangleScores[tid] > triangleScores[best]){
+			best = uint32_t(tid);
+		}
+	}
+
+	vector<char> emitted(triangleCount, 0);
+	vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+
+	// The cache holds up to maxCacheSize vertices; the 3 extra slots receive the vertices evicted by the last triangle.
+	uint32_t cache[maxCacheSize + 3];
+	uint32_t newCache[maxCacheSize + 3];
+	size_t cacheCount = 0;
+	size_t cursor = 0;
+
+	while(best != invalidIndex){
+		const uint32_t * triangle = &indices[3 * best];
+		result.insert(result.end(), triangle, triangle + 3);
+		emitted[best] = 1;
+
+		// Move the triangle vertices to the front of the cache.
+		size_t newCount = 0;
+		for(int k = 0; k < 3; ++k){
+			if(find(newCache, newCache + newCount, triangle[k]) == newCache + newCount){
+				newCache[newCount++] = triangle[k];
+			}
+		}
+		for(size_t i = 0; i < cacheCount; ++i){
+			uint32_t vertex = cache[i];
+			if(vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]){
+				newCache[newCount++] = vertex;
+			}
+		}
+
+		// Remove the triangle from the adjacency of its vertices.
+		for(int k = 0; k < 3; ++k){
+			uint32_t * list = &adjacency[offsets[triangle[k]]];
+			uint32_t & count = remaining[triangle[k]];
+			uint32_t * position = find(list, list + count, best);
+			*position = list[count - 1];
+			--count;
+		}
+
+		// Update the scores of the vertices in the cache and of the ones that were just evicted, and propagate them to their triangles.
+		for(size_t i = 0; i < newCount; ++i){
+			uint32_t vertex = newCache[i];
+			cachePositions[vertex] = i < maxCacheSize ? int(i) : -1;
+			float score = scorer.score(cachePositions[vertex], remaining[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+			const uint32_t * list = &adjacency[offsets[vertex]];
+			for(uint32_t j = 0; j < remaining[vertex]; ++j){
+				triangleScores[list[j]] += delta;
+			}
+		}
+		cacheCount = min(newCount, maxCacheSize);
+		copy(newCache, newCache + cacheCount, cache);
+
+		// The next triangle is the best one using a cached vertex.
+		best = invalidIndex;
+		float bestScore = 0.0f;
+		for(size_t i = 0; i < cacheCount; ++i){
+			const uint32_t * list = &adjacency[offsets[cache[i]]];
+			for(uint32_t j = 0; j < remaining[cache[i]]; ++j){
+				uint32_t tid = list[j];
+				if(best == invalidIndex || triangleScores[tid] > bestScore){
+					best = tid;
+					bestScore = triangleScores[tid];
+				}
+			}
+		}
+
+		// Dead end: restart from the first triangle not emitted yet.
+		if(best == invalidIndex){
+			while(cursor < triangleCount && emitted[cursor]){
+				++cursor;
+			}
+			if(cursor < triangleCount){
+				best = uint32_t(cursor);
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t> & indices, const std::vector<glm::vec3> & positions, float threshold){
+	const size_t triangleCount = indices.size() / 3;
+	if(triangleCount == 0){
+		return;
+	}
+	const size_t cacheSize = 16;
+	FifoCache cache(positions.size(), cacheSize);
+
+	// Hard boundaries: the cache was entirely missed, the triangle order can change here without any cost.
+	vector<size_t> hardBoundaries;
+	for(size_t tid = 0; tid < triangleCount; ++tid){
+		if(cache.update(&indices[3 * tid]) == 3){
+			hardBoundaries.push_back(tid);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries: split each hard cluster as soon as the running miss ratio is close enough to the one of the whole cluster.
+	vector<size_t> clusters;
+	for(size_t cid = 0; cid + 1 < hardBoundaries.size(); ++cid){
+		size_t start = hardBoundaries[cid];
+		size_t end = hardBoundaries[cid + 1];
+
+		cache.flush();
+		size_t clusterMisses = 0;
+		for(size_t tid = start; tid < end; ++tid){
+			clusterMisses += cache.update(&indices[3 * tid]);
+		}
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		clusters.push_back(start);
+		cache.flush();
+		size_t runningMisses = 0;
+		size_t runningCount = 0;
+		for(size_t tid = start; tid < end; ++tid){
+			runningMisses += cache.update(&indices[3 * tid]);
+			++runningCount;
+			if(tid + 1 < end && float(runningMisses) / float(runningCount) <= clusterThreshold){
+				clusters.push_back(tid + 1);
+				cache.flush();
+				runningMisses = 0;
+				runningCount = 0;
+			}
+		}
+	}
+	const size_t clusterCount = clusters.size();
+	clusters.push_back(triangleCount);
+
+	// Mesh centroid, weighted by the number of references.
+	glm::vec3 meshCentroid(0.0f);
+	for(size_t i = 0; i < triangleCount * 3; ++i){
+		meshCentroid += positions[indices[i]];
+	}
+	meshCentroid /= float(triangleCount * 3);
+
+	// Clusters that face away from the center are more likely to occlude the others.
+	vector<float> sortKeys(clusterCount);
+	for(size_t cid = 0; cid < clusterCount; ++cid){
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for(size_t tid = clusters[cid]; tid < clusters[cid + 1]; ++tid){
+			const glm::vec3 & p0 = positions[indices[3 * tid]];
+			const glm::vec3 & p1 = positions[indices[3 * tid + 1]];
+			const glm::vec3 & p2 = positions[indices[3 * tid + 2]];
+			glm::vec3 faceNormal = cross(p1 - p0, p2 - p0);
+			float faceArea = length(faceNormal);
+			centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+			normal += faceNormal;
+			area += faceArea;
+		}
+		float normalLength = length(normal);
+		if(area > 0.0f && normalLength > 0.0f){
+			centroid /= area;
+			normal /= normalLength;
+			sortKeys[cid] = dot(centroid - meshCentroid, normal);
+		} else {
+			sortKeys[cid] = 0.0f;
+		}
+	}
+
+	vector<size_t> order(clusterCount);
+	for(size_t cid = 0; cid < clusterCount; ++cid){
+		order[cid] = cid;
+	}
+	// Stable, so that ties keep the cache-optimized order.
+	stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b){
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	vector<uint32_t> result;
+	result.reserve(indices.size());
+	for(size_t cid : order){
+		result.insert(result.end(), indices.begin() + 3 * clusters[cid], indices.begin() + 3 * clusters[cid + 1]);
+	}
+	indices.swap(result);
+}
+
+namespace {
+
+	template<typename T>
+	void remapStream(std::vector<T> & stream, const vector<uint32_t> & remap){
+		if(stream.size() != remap.size()){
+			return;
+		}
+		std::vector<T> result(stream.size());
+		for(size_t vid = 0; vid < stream.size(); ++vid){
+			result[remap[vid]] = stream[vid];
+		}
+		stream.swap(result);
+	}
+
+}
+
+void optimizeVertexFetch(mesh_t & mesh){
+	const size_t vertexCount = mesh.positions.size();
+	vector<uint32_t> remap(vertexCount, invalidIndex);
+	uint32_t next = 0;
+	for(uint32_t & index : mesh.indices){
+		if(remap[index] == invalidIndex){
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+	for(size_t vid = 0; vid < vertexCount; ++vid){
+		if(remap[vid] == invalidIndex){
+			remap[vid] = next++;
+		}
+	}
+
+	remapStream(mesh.positions, remap);
+	remapStream(mesh.normals, remap);
+	remapStream(mesh.tangents, remap);
+	remapStream(mesh.binormals, remap);
+	remapStream(mesh.texcoords, remap);
+}
+
+void optimizeMesh(mesh_t & mesh){
+	if(mesh.indices.size() < 3 || mesh.positions.empty()){
+		return;
+	}
+	optimizeVertexCache(mesh.indices, mesh.positions.size());
+	optimizeOverdraw(mesh.indices, mesh.positions);
+	optimizeVertexFetch(mesh);
+}
+
+namespace {
+
+	// The passes only move values around, so streams are compared bit for bit (degenerate uvs can give NaN tangents).
+	template<typename T>
+	bool sameStream(const std::vector<T> & a, const std::vector<T> & b){
+		return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	void appendBits(vector<uint32_t> & key, float value){
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(float));
+		key.push_back(bits);
+	}
+
+	// Bits of all the attributes of a vertex, so that triangles can be compared independently of the vertex numbering.
+	vector<uint32_t> vertexKey(const mesh_t & mesh, uint32_t vid){
+		vector<uint32_t> key;
+		const glm::vec3 * vectors[] = {
+			&mesh.positions[vid],
+			vid < mesh.normals.size() ? &mesh.normals[vid] : nullptr,
+			vid < mesh.tangents.size() ? &mesh.tangents[vid] : nullptr,
+			vid < mesh.binormals.size() ? &mesh.binormals[vid] : nullptr
+		};
+		for(const glm::vec3 * value : vectors){
+			if(value){
+				appendBits(key, value->x);
+				appendBits(key, value->y);
+				appendBits(key, value->z);
+			}
+		}
+		if(vid < mesh.texcoords.size()){
+			appendBits(key, mesh.texcoords[vid].x);
+			appendBits(key, mesh.texcoords[vid].y);
+		}
+		return key;
+	}
+
+	// Sorted list of the triangles, each one rotated to start with its smallest vertex so that the winding is kept.
+	vector<vector<vector<uint32_t>>> triangleSet(const mesh_t & mesh){
+		vector<vector<vector<uint32_t>>> triangles(mesh.indices.size() / 3);
+		for(size_t tid = 0; tid < triangles.size(); ++tid){
+			vector<vector<uint32_t>> & triangle = triangles[tid];
+			for(int k = 0; k < 3; ++k){
+				triangle.push_back(vertexKey(mesh, mesh.indices[3 * tid + k]));
+			}
+			rotate(triangle.begin(), min_element(triangle.begin(), triangle.end()), triangle.end());
+		}
+		sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	bool sameMesh(const mesh_t & a, const mesh_t & b){
+		return a.indices == b.indices && sameStream(a.positions, b.positions) && sameStream(a.normals, b.normals)
+			&& sameStream(a.tangents, b.tangents) && sameStream(a.binormals, b.binormals) && sameStream(a.texcoords, b.texcoords);
+	}
+
+	// Every index either reuses a vertex or introduces the next one, and all the vertices are kept.
+	bool firstUseOrder(const mesh_t & before, const mesh_t & after){
+		if(after.positions.size() != before.positions.size()){
+			return false;
+		}
+		uint32_t next = 0;
+		for(uint32_t index : after.indices){
+			if(index > next){
+				return false;
+			}
+			if(index == next){
+				++next;
+			}
+		}
+		return true;
+	}
+
+	int check(bool success, const string & name){
+		cout << (success ? "PASS: " : "FAIL: ") << name << endl;
+		return success ? 0 : 1;
+	}
+
+}
+
+int testMeshOptimizer(const std::vector<std::string> & paths){
+	int failures = 0;
+	for(const string & path : paths){
+		cout << path << endl;
+		mesh_t source;
+		try {
+			loadObj(path, source, Indexed, 1);
+		} catch(const exception & e){
+			failures += check(false, string("load (") + e.what() + ")");
+			continue;
+		}
+		if(source.indices.size() < 3){
+			failures += check(false, "load (no triangles)");
+			continue;
+		}
+		centerAndUnitMesh(source);
+		computeTangentsAndBinormals(source);
+
+		mesh_t first = source;
+		mesh_t second = source;
+		optimizeMesh(first);
+		optimizeMesh(second);
+
+		vertex_cache_stats_t before = analyzeVertexCache(source.indices, source.positions.size());
+		vertex_cache_stats_t after = analyzeVertexCache(first.indices, first.positions.size());
+		cout << "Vertex cache: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+
+		failures += check(sameMesh(first, second), "deterministic output");
+		failures += check(first.indices.size() == source.indices.size() && triangleSet(first) == triangleSet(source), "triangle set preserved");
+		failures += check(firstUseOrder(source, first), "vertices in first-use order");
+	}
+	cout << (failures == 0 ? "All mesh optimizer checks passed." : to_string(failures) + " mesh optimizer check(s) failed.") << endl;
+	return failures;
+}
+
+namespace {
+
+	void computeMeshletBounds(const mesh_view_t & mesh, meshlet_t & meshlet){
+		const uint32_t * indices = mesh.indices + meshlet.firstIndex;
+
+		// Sphere around the center of the bounding box.
+		glm::vec3 mini = mesh.positions[indices[0]];
+		glm::vec3 maxi = mini;
+		for(uint32_t i = 1; i < meshlet.indexCount; ++i){
+			mini = glm::min(mini, mesh.positions[indices[i]]);
+			maxi = glm::max(maxi, mesh.positions[indices[i]]);
+		}
+		glm::vec3 center = 0.5f * (mini + maxi);
+		float radius = 0.0f;
+		for(uint32_t i = 0; i < meshlet.indexCount; ++i){
+			radius = max(radius, length(mesh.positions[indices[i]] - center));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+		// Cone around the average direction of the faces.
+		vector<glm::vec3> normals;
+		normals.reserve(meshlet.indexCount / 3);
+		glm::vec3 axis(0.0f);
+		for(uint32_t i = 0; i + 2 < meshlet.indexCount; i += 3){
+			const glm::vec3 & p0 = mesh.positions[indices[i]];
+			glm::vec3 normal = cross(mesh.positions[indices[i + 1]] - p0, mesh.positions[indices[i + 2]] - p0);
+			float area = length(normal);
+			if(area > 0.0f){
+				normals.push_back(normal / area);
+				axis += normal / area;
+			}
+		}
+		float axisLength = length(axis);
+		if(normals.empty() || axisLength == 0.0f){
+			// Never back-facing.
+			meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			return;
+		}
+		axis /= axisLength;
+		float minDot = 1.0f;
+		for(const glm::vec3 & normal : normals){
+			minDot = min(minDot, dot(axis, normal));
+		}
+		// A cone of half-angle a can only be back-facing when the view direction is within 90 - a degrees of its axis.
+		if(minDot <= 0.0f){
+			meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		} else {
+			meshlet.cone = glm::vec4(axis, sqrt(1.0f - minDot * minDot));
+		}
+	}
+
+}
+
+void buildMeshlets(const mesh_view_t & mesh, std::vector<meshlet_t> & meshlets, size_t maxVertices, size_t maxTriangles){
+	meshlets.clear();
+	if(mesh.indexCount < 3 || mesh.positions == NULL){
+		return;
+	}
+
+	// Vertices used by the current meshlet are tagged with its number.
+	vector<uint32_t> tags(mesh.vertexCount, invalidIndex);
+	auto newVertexCount = [&mesh, &tags, &meshlets](size_t triangle){
+		const uint32_t * corners = mesh.indices + triangle;
+		uint32_t tag = uint32_t(meshlets.size());
+		uint32_t count = tags[corners[0]] != tag ? 1 : 0;
+		count += tags[corners[1]] != tag && corners[1] != corners[0] ? 1 : 0;
+		count += tags[corners[2]] != tag && corners[2] != corners[0] && corners[2] != corners[1] ? 1 : 0;
+		return count;
+	};
+
+	meshlet_t meshlet = {};
+	for(size_t i = 0; i + 2 < mesh.indexCount; i += 3){
+		if(meshlet.vertexCount + newVertexCount(i) > maxVertices || meshlet.indexCount / 3 + 1 > maxTriangles){
+			computeMeshletBounds(mesh, meshlet);
+			meshlets.push_back(meshlet);
+			meshlet = {};
+			meshlet.firstIndex = uint32_t(i);
+		}
+		meshlet.vertexCount += newVertexCount(i);
+		meshlet.indexCount += 3;
+		for(int k = 0; k < 3; ++k){
+			tags[mesh.indices[i + k]] = uint32_t(meshlets.size());
+		}
+	}
+	computeMeshletBounds(mesh, meshlet);
+	meshlets.push_back(meshlet);
+}
@@ -0,0 +1,47 @@
+#ifndef MeshOptimizer_h
+#define MeshOptimizer_h
+
+#include "MeshUtilities.h"
+
+// Post-transform vertex cache statistics of an index buffer, for a FIFO cache.
+typedef struct {
+	float acmr;	// Average cache miss ratio: vertex shader invocations per triangle (0.5 at best, 3 at worst).
+	float atvr;	// Average transformed vertex ratio: vertex shader invocations per referenced vertex (1 at best).
+} vertex_cache_stats_t;
+
+// A small cluster of consecutive triangles of the index buffer, with bounds for culling. The layout matches the std430 struct used by the culling shader.
+typedef struct {
+	glm::vec4 sphere;		// Bounding sphere: xyz center, w radius.
+	glm::vec4 cone;			// Normal cone: xyz axis, w cutoff. The cluster is back-facing from any viewpoint v with dot(center - v, axis) >= cutoff * length(center - v) + radius.
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexCount;	// Number of unique vertices referenced.
+	uint32_t padding;
+} meshlet_t;
+
+/// Simulate a FIFO post-transform cache of cacheSize entries over a triangle list.
+vertex_cache_stats_t analyzeVertexCache(const std::vector<uint32_t> & indices, size_t vertexCount, size_t cacheSize = 16);
+
+/// Reorder the triangles for post-transform vertex cache reuse (Forsyth's linear-speed algorithm).
+void optimizeVertexCache(std::vector<uint32_t> & indices, size_t vertexCount);
+
+/// Reorder clusters of triangles so that the ones facing outwards are drawn first, to reduce overdraw.
+/// Clusters are split where the cache efficiency of the given order allows it, so the vertex cache reuse is mostly kept.
+void optimizeOverdraw(std::vector<uint32_t> & indices, const std::vector<glm::vec3> & positions, float threshold = 1.05f);
+
+/// Renumber the vertices in order of first use by the indices and reorder all the vertex streams accordingly.
+/// Vertices that are never referenced are moved at the end.
+void optimizeVertexFetch(mesh_t & mesh);
+
+/// Run the vertex cache, overdraw and vertex fetch passes on an indexed mesh. The result only depends on the input mesh.
+void optimizeMesh(mesh_t & mesh);
+
+/// Load each obj file, optimize it twice and check that the result is deterministic, that the triangles are the same
+/// up to the vertex numbering and the triangle order, and that the vertices are in first-use order. Returns the number of failed checks.
+int testMeshOptimizer(const std::vector<std::string> & paths);
+
+/// Split the index buffer of a mesh in consecutive ranges of at most maxVertices unique vertices and maxTriangles triangles,
+/// and compute their bounding spheres and normal cones. The index buffer is left untouched, so it should already be ordered for locality.
+void buildMeshlets(const mesh_view_t & mesh, std::vector<meshlet_t> & meshlets, size_t maxVertices = 64, size_t maxTriangles = 124);
+
+#endif
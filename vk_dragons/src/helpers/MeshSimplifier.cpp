@@ -0,0 +1,423 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+	const uint32_t invalidIndex = 0xFFFFFFFF;
+
+	// Open edges get a plane quadric perpendicular to their triangle, weighted up so that borders and seams don't move.
+	const double edgeWeight = 10.0;
+
+	// Meshes below this size are not worth simplifying.
+	const size_t minLodTriangleCount = 256;
+
+	// Manifold vertices can collapse on any neighbour. Border and seam vertices can only slide along their own open edges.
+	// Locked vertices (complex topology, corners of several seams) never move.
+	enum VertexKind {
+		Manifold, Border, Seam, Locked
+	};
+
+	// Symmetric 4x4 matrix of the sum of squared distances to a set of weighted planes.
+	struct Quadric {
+		double a00, a11, a22, a01, a02, a12;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		void addPlane(const glm::dvec3 & n, double d, double w){
+			a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+			a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric & q){
+			a00 += q.a00; a11 += q.a11; a22 += q.a22;
+			a01 += q.a01; a02 += q.a02; a12 += q.a12;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		// Weighted mean of the squared distances from p to the planes.
+		double error(const glm::vec3 & p) const {
+			double x = p.x, y = p.y, z = p.z;
+			double r = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0.0 ? abs(r) / weight : 0.0;
+		}
+	};
+
+	struct HalfEdge {
+		uint32_t next;
+		uint32_t prev;
+	};
+
+	// For each vertex, the edges leaving it in the triangles that use it, with the third vertex of each triangle.
+	struct Adjacency {
+		vector<uint32_t> offsets;
+		vector<HalfEdge> edges;
+
+		void build(const vector<uint32_t> & indices, size_t vertexCount){
+			offsets.assign(vertexCount + 1, 0);
+			for(uint32_t index : indices){
+				++offsets[index + 1];
+			}
+			for(size_t i = 0; i < vertexCount; ++i){
+				offsets[i + 1] += offsets[i];
+			}
+			edges.resize(indices.size());
+			vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for(size_t i = 0; i + 2 < indices.size(); i += 3){
+				for(int k = 0; k < 3; ++k){
+					uint32_t a = indices[i + k];
+					HalfEdge edge = { indices[i + (k + 1) % 3], indices[i + (k + 2) % 3] };
+					edges[fill[a]++] = edge;
+				}
+			}
+		}
+
+		bool hasEdge(uint32_t a, uint32_t b) const {
+			for(uint32_t e = offsets[a]; e < offsets[a + 1]; ++e){
+				if(edges[e].next == b){
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double error;
+
+		bool operator<(const Collapse & other) const {
+			return error < other.error || (error == other.error && from < other.from);
+		}
+	};
+
+	// Group the vertices sharing the same position: remap points to the first one, wedge links them in a circular list.
+	void buildPositionRemap(const glm::vec3 * positions, size_t vertexCount, vector<uint32_t> & remap, vector<uint32_t> & wedge){
+		vector<uint32_t> order(vertexCount);
+		for(size_t i = 0; i < vertexCount; ++i){
+			order[i] = uint32_t(i);
+		}
+		auto lessPosition = [positions](uint32_t a, uint32_t b){
+			const glm::vec3 & pa = positions[a];
+			const glm::vec3 & pb = positions[b];
+			if(pa.x != pb.x) return pa.x < pb.x;
+			if(pa.y != pb.y) return pa.y < pb.y;
+			if(pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		};
+		sort(order.begin(), order.end(), lessPosition);
+
+		remap.resize(vertexCount);
+		wedge.resize(vertexCount);
+		size_t start = 0;
+		while(start < vertexCount){
+			size_t end = start + 1;
+			while(end < vertexCount && positions[order[end]] == positions[order[start]]){
+				++end;
+			}
+			for(size_t i = start; i < end; ++i){
+				remap[order[i]] = order[start];
+				wedge[order[i]] = order[i + 1 < end ? i + 1 : start];
+			}
+			start = end;
+		}
+	}
+
+	// Find the open edges, that have no opposite edge with the same vertices. For each vertex, openOut and openIn store the other end
+	// of its unique outgoing and incoming open edges, invalidIndex if there is none, and the vertex itself if there are several.
+	void findOpenEdges(const Adjacency & adjacency, size_t vertexCount, vector<uint32_t> & openOut, vector<uint32_t> & openIn){
+		openOut.assign(vertexCount, invalidIndex);
+		openIn.assign(vertexCount, invalidIndex);
+		for(uint32_t i = 0; i < uint32_t(vertexCount); ++i){
+			for(uint32_t e = adjacency.offsets[i]; e < adjacency.offsets[i + 1]; ++e){
+				uint32_t target = adjacency.edges[e].next;
+				if(!adjacency.hasEdge(target, i)){
+					openOut[i] = openOut[i] == invalidIndex ? target : i;
+					openIn[target] = openIn[target] == invalidIndex ? i : target;
+				}
+			}
+		}
+	}
+
+	void classifyVertices(const vector<uint32_t> & remap, const vector<uint32_t> & wedge, const vector<uint32_t> & openOut, const vector<uint32_t> & openIn, vector<VertexKind> & kinds){
+		const size_t vertexCount = remap.size();
+		kinds.assign(vertexCount, Locked);
+		for(uint32_t i = 0; i < uint32_t(vertexCount); ++i){
+			if(remap[i] != i){
+				continue;
+			}
+			VertexKind kind = Locked;
+			if(wedge[i] == i){
+				// Single vertex at this position: either inside the surface or on exactly one border loop.
+				if(openOut[i] == invalidIndex && openIn[i] == invalidIndex){
+					kind = Manifold;
+				} else if(openOut[i] != invalidIndex && openOut[i] != i && openIn[i] != invalidIndex && openIn[i] != i){
+					kind = Border;
+				}
+			} else if(wedge[wedge[i]] == i){
+				// Two vertices at this position: a seam if both sides follow the same edges in opposite directions.
+				uint32_t w = wedge[i];
+				bool open = openOut[i] != invalidIndex && openOut[i] != i && openIn[i] != invalidIndex && openIn[i] != i &&
+							openOut[w] != invalidIndex && openOut[w] != w && openIn[w] != invalidIndex && openIn[w] != w;
+				if(open && remap[openOut[i]] == remap[openIn[w]] && remap[openIn[i]] == remap[openOut[w]] && remap[openOut[i]] != remap[openIn[i]]){
+					kind = Seam;
+				}
+			}
+			uint32_t v = i;
+			do {
+				kinds[v] = kind;
+				v = wedge[v];
+			} while(v != i);
+		}
+	}
+
+	bool canCollapse(VertexKind from, VertexKind to){
+		return from == Manifold || (from != Locked && from == to);
+	}
+
+	bool hasOpenEdge(const vector<uint32_t> & openOut, const vector<uint32_t> & openIn, uint32_t a, uint32_t b){
+		return openOut[a] == b || openIn[a] == b;
+	}
+
+	// Check that moving the vertex from onto the position of to doesn't flip any of the triangles that are kept.
+	bool flipsTriangles(const Adjacency & adjacency, const glm::vec3 * positions, const vector<uint32_t> & remap, const vector<uint32_t> & wedge, uint32_t from, uint32_t to){
+		const glm::vec3 & target = positions[to];
+		uint32_t v = from;
+		do {
+			const glm::vec3 & source = positions[v];
+			for(uint32_t e = adjacency.offsets[v]; e < adjacency.offsets[v + 1]; ++e){
+				const HalfEdge & edge = adjacency.edges[e];
+				if(remap[edge.next] == remap[to] || remap[edge.prev] == remap[to]){
+					// This triangle disappears.
+					continue;
+				}
+				const glm::vec3 & p1 = positions[edge.next];
+				const glm::vec3 & p2 = positions[edge.prev];
+				glm::vec3 before = cross(p1 - source, p2 - source);
+				glm::vec3 after = cross(p1 - target, p2 - target);
+				if(dot(before, after) <= 0.0f){
+					return true;
+				}
+			}
+			v = wedge[v];
+		} while(v != from);
+		return false;
+	}
+
+}
+
+float simplifyMesh(std::vector<uint32_t> & destination, const std::vector<uint32_t> & indices, const glm::vec3 * positions, size_t vertexCount, size_t targetIndexCount, float maxError){
+	destination = indices;
+	if(indices.size() < 3 || positions == NULL){
+		return 0.0f;
+	}
+
+	vector<uint32_t> remap;
+	vector<uint32_t> wedge;
+	buildPositionRemap(positions, vertexCount, remap, wedge);
+
+	Adjacency adjacency;
+	adjacency.build(destination, vertexCount);
+	vector<uint32_t> openOut;
+	vector<uint32_t> openIn;
+	findOpenEdges(adjacency, vertexCount, openOut, openIn);
+	vector<VertexKind> kinds;
+	classifyVertices(remap, wedge, openOut, openIn, kinds);
+
+	// Quadrics are shared by all the vertices at the same position.
+	vector<Quadric> quadrics(vertexCount, Quadric());
+	for(size_t i = 0; i + 2 < destination.size(); i += 3){
+		const uint32_t * tri = &destination[i];
+		glm::dvec3 p0(positions[tri[0]]);
+		glm::dvec3 p1(positions[tri[1]]);
+		glm::dvec3 p2(positions[tri[2]]);
+		glm::dvec3 normal = cross(p1 - p0, p2 - p0);
+		double area = length(normal);
+		if(area == 0.0){
+			continue;
+		}
+		normal /= area;
+		for(int k = 0; k < 3; ++k){
+			quadrics[remap[tri[k]]].addPlane(normal, -dot(normal, p0), area);
+		}
+		for(int k = 0; k < 3; ++k){
+			uint32_t a = tri[k];
+			uint32_t b = tri[(k + 1) % 3];
+			if(adjacency.hasEdge(b, a)){
+				continue;
+			}
+			glm::dvec3 pa(positions[a]);
+			glm::dvec3 edge = glm::dvec3(positions[b]) - pa;
+			double edgeLength = length(edge);
+			if(edgeLength == 0.0){
+				continue;
+			}
+			glm::dvec3 edgeNormal = normalize(cross(edge, normal));
+			double w = edgeWeight * edgeLength * edgeLength;
+			quadrics[remap[a]].addPlane(edgeNormal, -dot(edgeNormal, pa), w);
+			quadrics[remap[b]].addPlane(edgeNormal, -dot(edgeNormal, pa), w);
+		}
+	}
+
+	const double maxSquaredError = double(maxError) * double(maxError);
+	double resultError = 0.0;
+	vector<Collapse> collapses;
+	vector<uint32_t> collapseRemap(vertexCount);
+	vector<char> collapseLocked(vertexCount);
+
+	while(destination.size() > targetIndexCount){
+		adjacency.build(destination, vertexCount);
+		findOpenEdges(adjacency, vertexCount, openOut, openIn);
+
+		// Cheapest direction of every edge that can collapse.
+		collapses.clear();
+		for(size_t i = 0; i + 2 < destination.size(); i += 3){
+			for(int k = 0; k < 3; ++k){
+				uint32_t a = destination[i + k];
+				uint32_t b = destination[i + (k + 1) % 3];
+				// Inner edges are seen from both of their triangles, only keep one.
+				if(remap[a] > remap[b] && adjacency.hasEdge(b, a)){
+					continue;
+				}
+				Quadric q = quadrics[remap[a]];
+				q.add(quadrics[remap[b]]);
+				Collapse best = { invalidIndex, invalidIndex, 0.0 };
+				uint32_t ends[2] = { a, b };
+				for(int d = 0; d < 2; ++d){
+					uint32_t from = ends[d];
+					uint32_t to = ends[1 - d];
+					if(!canCollapse(kinds[from], kinds[to])){
+						continue;
+					}
+					// Border and seam vertices only slide along their own loop.
+					if(kinds[from] != Manifold && !hasOpenEdge(openOut, openIn, from, to)){
+						continue;
+					}
+					double error = q.error(positions[to]);
+					if(best.from == invalidIndex || error < best.error){
+						best.from = from;
+						best.to = to;
+						best.error = error;
+					}
+				}
+				if(best.from != invalidIndex && best.error <= maxSquaredError){
+					collapses.push_back(best);
+				}
+			}
+		}
+		if(collapses.empty()){
+			break;
+		}
+		sort(collapses.begin(), collapses.end());
+
+		// Each collapse removes about two triangles. Many of them will be blocked by their neighbours in this pass,
+		// so the error limit is a bit above the error of the last collapse that would be needed.
+		size_t collapseGoal = (destination.size() - targetIndexCount) / 6 + 1;
+		double passError = min(maxSquaredError, 1.5 * collapses[min(collapseGoal, collapses.size()) - 1].error);
+
+		for(size_t i = 0; i < vertexCount; ++i){
+			collapseRemap[i] = uint32_t(i);
+		}
+		fill(collapseLocked.begin(), collapseLocked.end(), 0);
+
+		size_t collapseCount = 0;
+		for(const Collapse & collapse : collapses){
+			if(collapse.error > passError || collapseCount >= collapseGoal){
+				break;
+			}
+			uint32_t from = collapse.from;
+			uint32_t to = collapse.to;
+			if(collapseLocked[remap[from]] || collapseLocked[remap[to]]){
+				continue;
+			}
+			if(kinds[from] == Seam){
+				// The other side of the seam has to slide along with it.
+				uint32_t sibling = wedge[from];
+				uint32_t siblingTarget = wedge[to];
+				if(!hasOpenEdge(openOut, openIn, sibling, siblingTarget)){
+					continue;
+				}
+				if(flipsTriangles(adjacency, positions, remap, wedge, from, to)){
+					continue;
+				}
+				collapseRemap[sibling] = siblingTarget;
+			} else if(flipsTriangles(adjacency, positions, remap, wedge, from, to)){
+				continue;
+			}
+			collapseRemap[from] = to;
+			quadrics[remap[to]].add(quadrics[remap[from]]);
+			collapseLocked[remap[from]] = 1;
+			collapseLocked[remap[to]] = 1;
+			resultError = max(resultError, collapse.error);
+			++collapseCount;
+		}
+		if(collapseCount == 0){
+			break;
+		}
+
+		// Remap the indices and drop the triangles that became degenerate.
+		size_t writeIndex = 0;
+		for(size_t i = 0; i + 2 < destination.size(); i += 3){
+			uint32_t a = collapseRemap[destination[i]];
+			uint32_t b = collapseRemap[destination[i + 1]];
+			uint32_t c = collapseRemap[destination[i + 2]];
+			if(a != b && b != c && c != a){
+				destination[writeIndex++] = a;
+				destination[writeIndex++] = b;
+				destination[writeIndex++] = c;
+			}
+		}
+		destination.resize(writeIndex);
+	}
+
+	return float(sqrt(resultError));
+}
+
+void buildMeshLods(mesh_t & mesh, size_t maxLodCount){
+	mesh.lods.clear();
+	const uint32_t fullCount = uint32_t(mesh.indices.size());
+	mesh_lod_t full = { 0, fullCount, 0.0f };
+	mesh.lods.push_back(full);
+	if(fullCount / 3 < minLodTriangleCount || mesh.positions.empty()){
+		return;
+	}
+
+	// The mesh is in the [-1,1] box, errors beyond a tenth of it are not acceptable even far away.
+	const float maxError = 0.1f;
+
+	vector<uint32_t> previous(mesh.indices.begin(), mesh.indices.end());
+	vector<uint32_t> lod;
+	float previousError = 0.0f;
+	for(size_t i = 0; i < maxLodCount; ++i){
+		// Each level is simplified from the previous one, so errors accumulate.
+		float error = previousError + simplifyMesh(lod, previous, mesh.positions.data(), mesh.positions.size(), previous.size() / 2, maxError - previousError);
+		// Stop once the simplification is stuck on seams and borders, or out of error budget.
+		if(lod.size() > previous.size() * 3 / 4 || lod.size() / 3 < minLodTriangleCount / 4){
+			break;
+		}
+		optimizeVertexCache(lod, mesh.positions.size());
+
+		mesh_lod_t level = { uint32_t(mesh.indices.size()), uint32_t(lod.size()), error };
+		mesh.lods.push_back(level);
+		mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+		previous.swap(lod);
+		previousError = error;
+	}
+
+	cout << "LODs:";
+	for(const mesh_lod_t & level : mesh.lods){
+		cout << " " << level.indexCount / 3;
+	}
+	cout << " triangles" << endl;
+}
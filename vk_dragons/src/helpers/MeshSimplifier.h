@@ -0,0 +1,15 @@
+#ifndef MeshSimplifier_h
+#define MeshSimplifier_h
+
+#include "MeshUtilities.h"
+
+/// Simplify a triangle list by collapsing edges in order of their quadric error, until it has at most targetIndexCount indices
+/// or no collapse below maxError remains. Vertices are only merged into existing ones, so the result indexes the same vertex buffer.
+/// Attribute seams and open borders are preserved. Returns the geometric error of the result, in the units of the positions.
+float simplifyMesh(std::vector<uint32_t> & destination, const std::vector<uint32_t> & indices, const glm::vec3 * positions, size_t vertexCount, size_t targetIndexCount, float maxError);
+
+/// Append up to maxLodCount coarser levels of detail to the indices of a mesh, each with about half the triangles of the previous one,
+/// and fill mesh.lods with the index range of every level, including the full mesh. Small meshes are kept as they are.
+void buildMeshLods(mesh_t & mesh, size_t maxLodCount = 5);
+
+#endif
@@ -1,17 +1,405 @@
 #include "MeshUtilities.h"
+#include <glm/gtc/packing.hpp>
+#include "FileUtilities.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ParallelUtilities.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <cstddef>
-#include <map>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_UTILITIES_SSE
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
-void loadObj(const std::string & filename, mesh_t & mesh, LoadMode mode){
-	// Open the file.
-	ifstream in;
-	in.open(filename.c_str());
-	if (!in) {
+namespace {
+
+	// Attribute indices of one face corner ("p/t/n"), 1-based and absolute. 0 means the attribute is absent.
+	struct ObjCorner {
+		uint32_t p;
+		uint32_t t;
+		uint32_t n;
+	};
+
+	inline bool operator==(const ObjCorner & a, const ObjCorner & b){
+		return a.p == b.p && a.t == b.t && a.n == b.n;
+	}
+
+	// Access the position (0), uv (1) or normal (2) index of a corner.
+	inline uint32_t & cornerComponent(ObjCorner & corner, size_t component){
+		return component == 0 ? corner.p : (component == 1 ? corner.t : corner.n);
+	}
+
+	// Raw content of an .obj file (or of a range of lines of it), before any connectivity is applied.
+	struct ObjData {
+		vector<glm::vec3> positions;
+		vector<glm::vec3> normals;
+		vector<glm::vec2> texcoords;
+		vector<ObjCorner> corners;
+		// Corner components that were given as negative indices (corner * 3 + component).
+		// They are resolved relatively to the start of the parsed range, and must be offset when ranges are merged.
+		vector<size_t> relative;
+	};
+
+	// Files smaller than this are never split between threads.
+	const size_t minChunkSize = 256 * 1024;
+	// Threads used to parse when the caller leaves the choice: the merge is sequential and the parsing bound by memory, so more barely help.
+	const unsigned int maxDefaultParseThreads = 8;
+
+	// Exact powers of ten representable as doubles.
+	const double powersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isBlank(char c){
+		return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+	}
+
+	inline bool isDigit(char c){
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char * skipBlanks(const char * p, const char * end){
+		while(p < end && isBlank(*p)){
+			++p;
+		}
+		return p;
+	}
+
+	inline const char * skipToken(const char * p, const char * end){
+		while(p < end && !isBlank(*p) && *p != '\n'){
+			++p;
+		}
+		return p;
+	}
+
+	// Return the position right after the end of the current line.
+	inline const char * nextLine(const char * p, const char * end){
+		const char * eol = static_cast<const char *>(memchr(p, '\n', end - p));
+		return eol ? eol + 1 : end;
+	}
+
+	// Parse a decimal float. Up to 19 significant digits and small exponents are handled
+	// directly with an exact double operation, anything else falls back to strtof.
+	// Returns the position after the number, or p if no number was found.
+	const char * parseFloat(const char * p, const char * end, float & value){
+		const char * start = p;
+		bool negative = false;
+		if(p < end && (*p == '-' || *p == '+')){
+			negative = *p == '-';
+			++p;
+		}
+		uint64_t mantissa = 0;
+		int significant = 0;
+		int exponent = 0;
+		bool hasDigits = false;
+		bool exact = true;
+		// Integer part.
+		for(; p < end && isDigit(*p); ++p){
+			hasDigits = true;
+			if(significant < 19){
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += mantissa > 0 ? 1 : 0;
+			} else {
+				exact = exact && *p == '0';
+				++exponent;
+			}
+		}
+		// Fractional part.
+		if(p < end && *p == '.'){
+			++p;
+			for(; p < end && isDigit(*p); ++p){
+				hasDigits = true;
+				if(significant < 19){
+					mantissa = mantissa * 10 + (*p - '0');
+					significant += mantissa > 0 ? 1 : 0;
+					--exponent;
+				} else {
+					exact = exact && *p == '0';
+				}
+			}
+		}
+		if(!hasDigits){
+			return start;
+		}
+		// Exponent.
+		if(p < end && (*p == 'e' || *p == 'E')){
+			const char * q = p + 1;
+			bool negativeExponent = false;
+			if(q < end && (*q == '-' || *q == '+')){
+				negativeExponent = *q == '-';
+				++q;
+			}
+			if(q < end && isDigit(*q)){
+				int e = 0;
+				for(; q < end && isDigit(*q); ++q){
+					e = e < 10000 ? e * 10 + (*q - '0') : e;
+				}
+				exponent += negativeExponent ? -e : e;
+				p = q;
+			}
+		}
+
+		if(exact && mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22){
+			double result = static_cast<double>(mantissa);
+			result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+			value = static_cast<float>(negative ? -result : result);
+			return p;
+		}
+
+		// Slow path: copy the token on the stack so that strtof can work on a null-terminated string.
+		char buffer[128];
+		size_t length = min(static_cast<size_t>(p - start), sizeof(buffer) - 1);
+		memcpy(buffer, start, length);
+		buffer[length] = '\0';
+		value = strtof(buffer, NULL);
+		return p;
+	}
+
+	// Parse a (possibly negative) integer. Returns the position after it, or p if there is none.
+	inline const char * parseInt(const char * p, const char * end, long & value){
+		const char * start = p;
+		bool negative = false;
+		if(p < end && (*p == '-' || *p == '+')){
+			negative = *p == '-';
+			++p;
+		}
+		if(p == end || !isDigit(*p)){
+			return start;
+		}
+		long result = 0;
+		for(; p < end && isDigit(*p); ++p){
+			result = result * 10 + (*p - '0');
+		}
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// Parse a face corner such as "7", "7/2", "7//3", "7/2/3" or "-1/-1/-1".
+	// "7//3" and "7/0/3" both give a corner without UV (index 0).
+	const char * parseCorner(const char * p, const char * end, long indices[3]){
+		indices[0] = indices[1] = indices[2] = 0;
+		p = parseInt(p, end, indices[0]);
+		if(p < end && *p == '/'){
+			p = parseInt(p + 1, end, indices[1]);
+			if(p < end && *p == '/'){
+				p = parseInt(p + 1, end, indices[2]);
+			}
+		}
+		return skipToken(p, end);
+	}
+
+	const uint32_t emptyCornerSlot = 0xFFFFFFFF;
+
+	// Open-addressing hash table (linear probing) associating each distinct corner to a vertex index.
+	// The capacity is fixed at construction, from the maximal number of distinct corners.
+	class CornerTable {
+	public:
+		explicit CornerTable(size_t maxCount){
+			size_t capacity = 16;
+			while(capacity < maxCount * 2){
+				capacity <<= 1;
+			}
+			mask = capacity - 1;
+			keys.resize(capacity);
+			values.assign(capacity, emptyCornerSlot);
+		}
+
+		// Return the vertex index of the corner. If the corner is new, it gets the index candidate and inserted is set.
+		uint32_t findOrInsert(const ObjCorner & corner, uint32_t candidate, bool & inserted){
+			size_t slot = hash(corner) & mask;
+			while(values[slot] != emptyCornerSlot){
+				if(keys[slot] == corner){
+					inserted = false;
+					return values[slot];
+				}
+				slot = (slot + 1) & mask;
+			}
+			keys[slot] = corner;
+			values[slot] = candidate;
+			inserted = true;
+			return candidate;
+		}
+
+	private:
+		size_t mask;
+		vector<ObjCorner> keys;
+		vector<uint32_t> values;
+
+		static size_t hash(const ObjCorner & corner){
+			uint64_t h = corner.p * 0x9E3779B97F4A7C15ull;
+			h ^= corner.t * 0xC2B2AE3D27D4EB4Full;
+			h ^= corner.n * 0x165667B19E3779F9ull;
+			h ^= h >> 32;
+			h *= 0xD6E8FEB86659FD93ull;
+			h ^= h >> 32;
+			return static_cast<size_t>(h);
+		}
+	};
+
+	// Parse up to count floats on the current line. Returns the number of values read.
+	inline int parseFloats(const char * & p, const char * end, float * values, int count){
+		int i = 0;
+		for(; i < count; ++i){
+			p = skipBlanks(p, end);
+			const char * q = parseFloat(p, end, values[i]);
+			if(q == p){
+				break;
+			}
+			p = skipToken(q, end);
+		}
+		return i;
+	}
+
+	// Parse all the v/vt/vn/f records in [begin, end[. begin has to be at the start of a line.
+	void parseObjRange(const char * begin, const char * end, ObjData & data){
+		float values[3];
+		for(const char * line = begin; line < end; line = nextLine(line, end)){
+			const char * p = skipBlanks(line, end);
+			// Ignore empty lines and comments.
+			if(p == end || *p == '\n' || *p == '#'){
+				continue;
+			}
+			// Check what kind of element the line represent.
+			const char * keyword = p;
+			p = skipToken(p, end);
+			size_t keywordLength = p - keyword;
+
+			if(keywordLength == 1 && keyword[0] == 'v'){ // Vertex position
+				// We need 3 coordinates.
+				if(parseFloats(p, end, values, 3) == 3){
+					data.positions.push_back(glm::vec3(values[0], values[1], values[2]));
+				}
+
+			} else if(keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 'n'){ // Vertex normal
+				// We need 3 coordinates.
+				if(parseFloats(p, end, values, 3) == 3){
+					data.normals.push_back(glm::vec3(values[0], values[1], values[2]));
+				}
+
+			} else if(keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 't'){ // Vertex UV
+				// We need 2 coordinates.
+				if(parseFloats(p, end, values, 2) == 2){
+					data.texcoords.push_back(glm::vec2(values[0], values[1]));
+				}
+
+			} else if(keywordLength == 1 && keyword[0] == 'f'){ // Face indices.
+				// We need 3 elements, each containing at most three indices.
+				long indices[3][3];
+				int count = 0;
+				for(; count < 3; ++count){
+					p = skipBlanks(p, end);
+					if(p == end || *p == '\n'){
+						break;
+					}
+					p = parseCorner(p, end, indices[count]);
+				}
+				if(count < 3){
+					continue;
+				}
+				// Negative indices are relative to the elements read so far (-1 is the last one).
+				// Wrapping is fine: the final value is only known once the range is offset, and is validated then.
+				const size_t counts[3] = { data.positions.size(), data.texcoords.size(), data.normals.size() };
+				for(int c = 0; c < 3; ++c){
+					ObjCorner corner;
+					for(int k = 0; k < 3; ++k){
+						long index = indices[c][k];
+						if(index < 0){
+							data.relative.push_back(data.corners.size() * 3 + k);
+							index += static_cast<long>(counts[k]) + 1;
+						}
+						cornerComponent(corner, k) = static_cast<uint32_t>(index);
+					}
+					data.corners.push_back(corner);
+				}
+			}
+			// Ignore s, l, g, matl or others
+		}
+	}
+
+	// Parse [begin, end[ in chunkCount chunks on as many threads, splitting it at line boundaries.
+	// The chunks are concatenated in order, so the result is identical to parsing the whole range at once.
+	void parseObjParallel(const char * begin, const char * end, size_t chunkCount, ObjData & data){
+		// Chunk boundaries, moved forward to the start of the next line.
+		vector<const char *> bounds(chunkCount + 1);
+		bounds[0] = begin;
+		bounds[chunkCount] = end;
+		size_t size = end - begin;
+		for(size_t i = 1; i < chunkCount; ++i){
+			const char * split = max(bounds[i-1], begin + size * i / chunkCount);
+			bounds[i] = split == begin ? begin : nextLine(split - 1, end);
+		}
+
+		vector<ObjData> chunks(chunkCount);
+		parallelFor(chunkCount, chunkCount, [&bounds, &chunks](size_t first, size_t last){
+			for(size_t i = first; i < last; ++i){
+				parseObjRange(bounds[i], bounds[i+1], chunks[i]);
+			}
+		});
+
+		// Merge. The offset of each chunk is the prefix sum of the element counts of the previous ones.
+		size_t counts[4] = { 0, 0, 0, 0 };
+		for(const ObjData & chunk : chunks){
+			counts[0] += chunk.positions.size();
+			counts[1] += chunk.texcoords.size();
+			counts[2] += chunk.normals.size();
+			counts[3] += chunk.corners.size();
+		}
+		data.positions.reserve(counts[0]);
+		data.texcoords.reserve(counts[1]);
+		data.normals.reserve(counts[2]);
+		data.corners.reserve(counts[3]);
+
+		for(ObjData & chunk : chunks){
+			const uint32_t offsets[3] = {
+				static_cast<uint32_t>(data.positions.size()),
+				static_cast<uint32_t>(data.texcoords.size()),
+				static_cast<uint32_t>(data.normals.size())
+			};
+			const size_t firstCorner = data.corners.size();
+			data.positions.insert(data.positions.end(), chunk.positions.begin(), chunk.positions.end());
+			data.texcoords.insert(data.texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+			data.normals.insert(data.normals.end(), chunk.normals.begin(), chunk.normals.end());
+			data.corners.insert(data.corners.end(), chunk.corners.begin(), chunk.corners.end());
+			for(size_t component : chunk.relative){
+				cornerComponent(data.corners[firstCorner + component / 3], component % 3) += offsets[component % 3];
+			}
+			chunk = ObjData();
+		}
+	}
+
+	// Drop the faces referencing positions that don't exist, and clear the out of range uv and normal indices.
+	void validateFaces(ObjData & data){
+		size_t kept = 0;
+		for(size_t i = 0; i + 2 < data.corners.size(); i += 3){
+			bool valid = true;
+			for(size_t c = i; c < i + 3; ++c){
+				ObjCorner & corner = data.corners[c];
+				valid = valid && corner.p > 0 && corner.p <= data.positions.size();
+				corner.t = corner.t <= data.texcoords.size() ? corner.t : 0;
+				corner.n = corner.n <= data.normals.size() ? corner.n : 0;
+			}
+			if(valid){
+				copy(data.corners.begin() + i, data.corners.begin() + i + 3, data.corners.begin() + kept);
+				kept += 3;
+			}
+		}
+		data.corners.resize(kept);
+	}
+}
+
+void loadObj(const std::string & filename, mesh_t & mesh, LoadMode mode, unsigned int threadCount){
+	// Map the whole file.
+	MappedFile buffer;
+	if(!buffer.Open(filename)){
 		cerr << filename + " is not a valid file." << endl;
 		return;
 	}
@@ -23,118 +411,71 @@ void loadObj(const std::string & filename, mesh_t & mesh, LoadMode mode){
 	mesh.positions.clear();
 	mesh.normals.clear();
 	mesh.texcoords.clear();
-	// Init temporary vectors.
-	vector<glm::vec3> positions_temp;
-	vector<glm::vec3> normals_temp;
-	vector<glm::vec2> texcoords_temp;
-	vector<string> faces_temp;
-
-	string res;
-
-	// Iterate over the lines of the file.
-	while(!in.eof()){
-		getline(in,res);
-
-		// Ignore the line if it is too short or a comment.
-		if(res.empty() || res[0] == '#' || res.size()<2){
-			continue;
-		}
-		//We want to split the content of the line at spaces, use a stringstream directly
-		stringstream ss(res);
-		vector<string> tokens;
-		string token;
-		while(ss >> token){
-			tokens.push_back(token);
-		}
-		if(tokens.size() < 1){
-			continue;
-		}
-		// Check what kind of element the line represent.
-		if (tokens[0] == "v") { // Vertex position
-			// We need 3 coordinates.
-			if(tokens.size() < 4){
-				continue;
-			}
-			glm::vec3 pos = glm::vec3(stof(tokens[1],NULL),stof(tokens[2],NULL),stof(tokens[3],NULL));
-			positions_temp.push_back(pos);
-			
-		} else if (tokens[0] == "vn"){ // Vertex normal
-			// We need 3 coordinates.
-			if(tokens.size() < 4){
-				continue;
-			}
-			glm::vec3 nor = glm::vec3(stof(tokens[1],NULL),stof(tokens[2],NULL),stof(tokens[3],NULL));
-			normals_temp.push_back(nor);
-			
-		} else if (tokens[0] == "vt") { // Vertex UV
-			// We need 2 coordinates.
-			if(tokens.size() < 3){
-				continue;
-			}
-			glm::vec2 uv = glm::vec2(stof(tokens[1],NULL),stof(tokens[2],NULL));
-			texcoords_temp.push_back(uv);
-			
-		} else if (tokens[0] == "f") { // Face indices.
-			// We need 3 elements, each containing at most three indices.
-			if(tokens.size() < 4){
-				continue;
-			}
-			faces_temp.push_back(tokens[1]);
-			faces_temp.push_back(tokens[2]);
-			faces_temp.push_back(tokens[3]);
 
-		} else { // Ignore s, l, g, matl or others
-			continue;
-		}
+	// Parse the file content directly from the buffer, in parallel for large files.
+	if(threadCount == 0){
+		threadCount = min(maxDefaultParseThreads, max(1u, thread::hardware_concurrency()));
+	}
+	size_t chunkCount = parallelThreadCount(buffer.GetSize(), minChunkSize, threadCount);
+	ObjData data;
+	const char * begin = buffer.GetData();
+	if(chunkCount > 1){
+		parseObjParallel(begin, begin + buffer.GetSize(), chunkCount, data);
+	} else {
+		parseObjRange(begin, begin + buffer.GetSize(), data);
 	}
-	in.close();
+	validateFaces(data);
 
 	// If no vertices, end.
-	if(positions_temp.size() == 0){
+	if(data.positions.size() == 0){
 			return;
 	}
 
 	// Does the mesh have UV or normal coordinates ?
-	bool hasUV = texcoords_temp.size()>0;
-	bool hasNormals = normals_temp.size()>0;
+	bool hasUV = data.texcoords.size()>0;
+	bool hasNormals = data.normals.size()>0;
 
 	// Depending on the chosen extraction mode, we fill the mesh arrays accordingly.
 	if (mode == Points){
 		// Mode: Points
 		// In this mode, we don't care about faces. We simply associate each vertex/normal/uv in the same order.
 		
-		mesh.positions = positions_temp;
+		mesh.positions = data.positions;
 		if(hasNormals){
-			mesh.normals = normals_temp;
+			mesh.normals = data.normals;
 		}
 		if(hasUV){
-			mesh.texcoords = texcoords_temp;
+			mesh.texcoords = data.texcoords;
 		}
 
 	} else if(mode == Expanded){
 		// Mode: Expanded
 		// In this mode, vertices are all duplicated. Each face has its set of 3 vertices, not shared with any other face.
-		
+		size_t count = data.corners.size();
+		mesh.positions.reserve(count);
+		mesh.indices.reserve(count);
+		if(hasUV){
+			mesh.texcoords.reserve(count);
+		}
+		if(hasNormals){
+			mesh.normals.reserve(count);
+		}
+
 		// For each face, query the needed positions, normals and uvs, and add them to the mesh structure.
-		for(size_t i = 0; i < faces_temp.size(); i++){
-			string str = faces_temp[i];
-			size_t foundF = str.find_first_of("/");
-			size_t foundL = str.find_last_of("/");
+		for(size_t i = 0; i < count; i++){
+			const ObjCorner & corner = data.corners[i];
 			
 			// Positions (we are sure they exist).
-			long ind1 = stol(str.substr(0,foundF))-1;
-			mesh.positions.push_back(positions_temp[ind1]);
+			mesh.positions.push_back(data.positions[corner.p-1]);
 
 			// UVs (second index).
 			if(hasUV){
-				long ind2 = stol(str.substr(foundF+1,foundL))-1;
-				mesh.texcoords.push_back(texcoords_temp[ind2]);
+				mesh.texcoords.push_back(corner.t > 0 ? data.texcoords[corner.t-1] : glm::vec2(0.0f));
 			}
 
 			// Normals (third index, in all cases).
 			if(hasNormals){
-				long ind3 = stol(str.substr(foundL+1))-1;
-				mesh.normals.push_back(normals_temp[ind3]);
+				mesh.normals.push_back(corner.n > 0 ? data.normals[corner.n-1] : glm::vec3(0.0f));
 			}
 			
 			//Indices (simply a vector of increasing integers).
@@ -145,102 +486,157 @@ void loadObj(const std::string & filename, mesh_t & mesh, LoadMode mode){
 		// Mode: Indexed
 		// In this mode, vertices are only duplicated if they were already used in a previous face with a different set of uv/normal coordinates.
 		
-		// Keep track of previously encountered (position,uv,normal).
-		map<string,long> indices_used;
+		// Keep track of previously encountered (position,uv,normal), in a table sized from the number of face corners.
+		size_t count = data.corners.size();
+		CornerTable indices_used(count);
+		mesh.indices.reserve(count);
+		mesh.positions.reserve(data.positions.size());
+		if(hasUV){
+			mesh.texcoords.reserve(data.positions.size());
+		}
+		if(hasNormals){
+			mesh.normals.reserve(data.positions.size());
+		}
 
-		//Positions
-		long maxInd = 0;
-		for(size_t i = 0; i < faces_temp.size(); i++){
+		uint32_t maxInd = 0;
+		for(size_t i = 0; i < count; i++){
 			
-			string str = faces_temp[i];
+			const ObjCorner & corner = data.corners[i];
 
 			//Does the association of attributs already exists ?
-			if(indices_used.count(str)>0){
-				// Just store the index in the indices vector.
-				mesh.indices.push_back(indices_used[str]);
+			bool inserted;
+			uint32_t index = indices_used.findOrInsert(corner, maxInd, inserted);
+			// In all cases, store the index in the indices vector.
+			mesh.indices.push_back(index);
+			if(!inserted){
 				// Go to next face.
 				continue;
 			}
 
-			// else, query the associated position/uv/normal, store it, update the indices vector and the list of used elements.
-			size_t foundF = str.find_first_of("/");
-			size_t foundL = str.find_last_of("/");
-			
+			// else, query the associated position/uv/normal and store it.
+
 			//Positions (we are sure they exist)
-			long ind1 = stol(str.substr(0,foundF))-1;
-			mesh.positions.push_back(positions_temp[ind1]);
+			mesh.positions.push_back(data.positions[corner.p-1]);
 
 			//UVs (second index)
 			if(hasUV){
-				long ind2 = stol(str.substr(foundF+1,foundL))-1;
-				mesh.texcoords.push_back(texcoords_temp[ind2]);
+				mesh.texcoords.push_back(corner.t > 0 ? data.texcoords[corner.t-1] : glm::vec2(0.0f));
 			}
 			//Normals (third index, in all cases)
 			if(hasNormals){
-				long ind3 = stol(str.substr(foundL+1))-1;
-				mesh.normals.push_back(normals_temp[ind3]);
+				mesh.normals.push_back(corner.n > 0 ? data.normals[corner.n-1] : glm::vec3(0.0f));
 			}
 
-			mesh.indices.push_back(maxInd);
-			indices_used[str] = maxInd;
 			maxInd++;
 		}
-		indices_used.clear();
 	}
 
-	positions_temp.clear();
-	normals_temp.clear();
-	texcoords_temp.clear();
-	faces_temp.clear();
 	return;
 }
 
-void centerAndUnitMesh(mesh_t & mesh){
-	// Compute the centroid.
-	glm::vec3 centroid = glm::vec3(0.0);
-	float maxi = mesh.positions[0].x;
-	for(size_t i = 0; i < mesh.positions.size(); i++){
-		centroid += mesh.positions[i];
+namespace {
+
+	// Smallest amount of work given to a thread.
+	const size_t minFacesPerThread = 16 * 1024;
+	const size_t minVerticesPerThread = 16 * 1024;
+
+	// Sum, minimum and maximum of the positions, per component.
+	void positionBounds(const glm::vec3 * positions, size_t count, glm::vec3 & sum, glm::vec3 & mini, glm::vec3 & maxi){
+		sum = glm::vec3(0.0f);
+		mini = positions[0];
+		maxi = positions[0];
+		size_t i = 0;
+#ifdef MESH_UTILITIES_SSE
+		// 4 vertices are 3 registers: (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3).
+		const float * data = &positions[0].x;
+		__m128 sumA = _mm_setzero_ps(), sumB = _mm_setzero_ps(), sumC = _mm_setzero_ps();
+		__m128 minA = _mm_set_ps(mini.x, mini.z, mini.y, mini.x), minB = _mm_set_ps(mini.y, mini.x, mini.z, mini.y), minC = _mm_set_ps(mini.z, mini.y, mini.x, mini.z);
+		__m128 maxA = minA, maxB = minB, maxC = minC;
+		for(; i + 4 <= count; i += 4){
+			__m128 a = _mm_loadu_ps(data + 3 * i);
+			__m128 b = _mm_loadu_ps(data + 3 * i + 4);
+			__m128 c = _mm_loadu_ps(data + 3 * i + 8);
+			sumA = _mm_add_ps(sumA, a); sumB = _mm_add_ps(sumB, b); sumC = _mm_add_ps(sumC, c);
+			minA = _mm_min_ps(minA, a); minB = _mm_min_ps(minB, b); minC = _mm_min_ps(minC, c);
+			maxA = _mm_max_ps(maxA, a); maxB = _mm_max_ps(maxB, b); maxC = _mm_max_ps(maxC, c);
+		}
+		// Fold the lanes back to the x, y and z components.
+		float s[12], lo[12], hi[12];
+		_mm_storeu_ps(s, sumA); _mm_storeu_ps(s + 4, sumB); _mm_storeu_ps(s + 8, sumC);
+		_mm_storeu_ps(lo, minA); _mm_storeu_ps(lo + 4, minB); _mm_storeu_ps(lo + 8, minC);
+		_mm_storeu_ps(hi, maxA); _mm_storeu_ps(hi + 4, maxB); _mm_storeu_ps(hi + 8, maxC);
+		for(int k = 0; k < 12; ++k){
+			sum[k % 3] += s[k];
+			mini[k % 3] = min(mini[k % 3], lo[k]);
+			maxi[k % 3] = max(maxi[k % 3], hi[k]);
+		}
+#endif
+		for(; i < count; ++i){
+			sum += positions[i];
+			mini = glm::min(mini, positions[i]);
+			maxi = glm::max(maxi, positions[i]);
+		}
 	}
-	centroid /= mesh.positions.size();
-
-	for(size_t i = 0; i < mesh.positions.size(); i++){
-		// Translate  the vertex.
-		mesh.positions[i] -= centroid;
-		// Find the maximal distance from a vertex to the center.
-		maxi = abs(mesh.positions[i].x) > maxi ? abs(mesh.positions[i].x) : maxi;
-		maxi = abs(mesh.positions[i].y) > maxi ? abs(mesh.positions[i].y) : maxi;
-		maxi = abs(mesh.positions[i].z) > maxi ? abs(mesh.positions[i].z) : maxi;
+
+	// positions = (positions - offset) / scale.
+	void translateAndScale(glm::vec3 * positions, size_t count, const glm::vec3 & offset, float scale){
+		size_t i = 0;
+#ifdef MESH_UTILITIES_SSE
+		float * data = &positions[0].x;
+		const __m128 offsetA = _mm_set_ps(offset.x, offset.z, offset.y, offset.x);
+		const __m128 offsetB = _mm_set_ps(offset.y, offset.x, offset.z, offset.y);
+		const __m128 offsetC = _mm_set_ps(offset.z, offset.y, offset.x, offset.z);
+		const __m128 scales = _mm_set1_ps(scale);
+		for(; i + 4 <= count; i += 4){
+			_mm_storeu_ps(data + 3 * i, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(data + 3 * i), offsetA), scales));
+			_mm_storeu_ps(data + 3 * i + 4, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(data + 3 * i + 4), offsetB), scales));
+			_mm_storeu_ps(data + 3 * i + 8, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(data + 3 * i + 8), offsetC), scales));
+		}
+#endif
+		for(; i < count; ++i){
+			positions[i] = (positions[i] - offset) / scale;
+		}
 	}
-	maxi = maxi == 0.0f ? 1.0f : maxi;
-	
-	// Scale the mesh.
-	for(int i = 0; i < mesh.positions.size(); i++){
-		mesh.positions[i] /= maxi;
+
+}
+
+void centerAndUnitMesh(mesh_t & mesh){
+	if(mesh.positions.empty()){
+		return;
 	}
+	// Compute the centroid and the bounding box in a single pass.
+	glm::vec3 sum, mini, maxi;
+	positionBounds(mesh.positions.data(), mesh.positions.size(), sum, mini, maxi);
+	glm::vec3 centroid = sum / float(mesh.positions.size());
+
+	// The maximal distance from a vertex to the center, along any axis, is reached on the bounding box.
+	glm::vec3 extent = glm::max(maxi - centroid, centroid - mini);
+	float scale = max(extent.x, max(extent.y, extent.z));
+	scale = scale == 0.0f ? 1.0f : scale;
+
+	// Translate and scale the mesh.
+	translateAndScale(mesh.positions.data(), mesh.positions.size(), centroid, scale);
 }
 
-void computeTangentsAndBinormals(mesh_t & mesh){
-	if(mesh.indices.size() * mesh.positions.size() * mesh.texcoords.size() == 0){
+void computeTangentsAndBinormals(mesh_t & mesh, unsigned int threadCount){
+	if(mesh.indices.size() * mesh.positions.size() * mesh.texcoords.size() * mesh.normals.size() == 0){
 		// Missing data, or not the right mode (Points).
 		return;
 	}
-	// Start by filling everything with 0 (as we want to accumulate tangents and binormals coming from different faces for each vertex).
-	for(size_t pid = 0; pid < mesh.positions.size(); ++pid){
-		mesh.tangents.push_back(glm::vec3(0.0f));
-		mesh.binormals.push_back(glm::vec3(0.0f));
-	}
-	// Then, compute both vectors for each face and accumulate them.
-	for(size_t fid = 0; fid < mesh.indices.size(); fid += 3){
+	const size_t vertexCount = mesh.positions.size();
+	const size_t faceCount = mesh.indices.size() / 3;
 
+	// Compute both vectors for a face.
+	auto faceFrame = [&mesh](size_t face, glm::vec3 & tangent, glm::vec3 & binormal){
+		const uint32_t * indices = &mesh.indices[3 * face];
 		// Get the vertices of the face.
-		glm::vec3 & v0 = mesh.positions[mesh.indices[fid]];
-		glm::vec3 & v1 = mesh.positions[mesh.indices[fid+1]];
-		glm::vec3 & v2 = mesh.positions[mesh.indices[fid+2]];
+		const glm::vec3 & v0 = mesh.positions[indices[0]];
+		const glm::vec3 & v1 = mesh.positions[indices[1]];
+		const glm::vec3 & v2 = mesh.positions[indices[2]];
 		// Get the uvs of the face.
-		glm::vec2 & uv0 = mesh.texcoords[mesh.indices[fid]];
-		glm::vec2 & uv1 = mesh.texcoords[mesh.indices[fid+1]];
-		glm::vec2 & uv2 = mesh.texcoords[mesh.indices[fid+2]];
+		const glm::vec2 & uv0 = mesh.texcoords[indices[0]];
+		const glm::vec2 & uv1 = mesh.texcoords[indices[1]];
+		const glm::vec2 & uv2 = mesh.texcoords[indices[2]];
 
 		// Delta positions and uvs.
 		glm::vec3 deltaPosition1 = v1 - v0;
@@ -248,25 +644,134 @@ void computeTangentsAndBinormals(mesh_t & mesh){
 		glm::vec2 deltaUv1 = uv1 - uv0;
 		glm::vec2 deltaUv2 = uv2 - uv0;
 
-		// Compute tangent and binormal for the face.
 		float det = 1.0f / (deltaUv1.x * deltaUv2.y - deltaUv1.y * deltaUv2.x);
-    	glm::vec3 tangent = det * (deltaPosition1 * deltaUv2.y   - deltaPosition2 * deltaUv1.y);
-    	glm::vec3 binormal = det * (deltaPosition2 * deltaUv1.x   - deltaPosition1 * deltaUv2.x);
+		tangent = det * (deltaPosition1 * deltaUv2.y - deltaPosition2 * deltaUv1.y);
+		binormal = det * (deltaPosition2 * deltaUv1.x - deltaPosition1 * deltaUv2.x);
+	};
 
-    	// Accumulate them. We don't normalize to get a free weighting based on the size of the face.
-    	mesh.tangents[mesh.indices[fid]] += tangent;
-    	mesh.tangents[mesh.indices[fid+1]] += tangent;
-    	mesh.tangents[mesh.indices[fid+2]] += tangent;
+	// Accumulate the vectors of the faces around each vertex. We don't normalize to get a free weighting based on the size of the face.
+	mesh.tangents.assign(vertexCount, glm::vec3(0.0f));
+	mesh.binormals.assign(vertexCount, glm::vec3(0.0f));
+	const size_t faceThreadCount = parallelThreadCount(faceCount, minFacesPerThread, threadCount);
+	if(faceThreadCount <= 1){
+		for(size_t face = 0; face < faceCount; ++face){
+			glm::vec3 tangent, binormal;
+			faceFrame(face, tangent, binormal);
+			for(int k = 0; k < 3; ++k){
+				mesh.tangents[mesh.indices[3 * face + k]] += tangent;
+				mesh.binormals[mesh.indices[3 * face + k]] += binormal;
+			}
+		}
+	} else {
+		// Faces are processed in parallel, every face writing its own slot.
+		vector<glm::vec3> faceTangents(faceCount);
+		vector<glm::vec3> faceBinormals(faceCount);
+		parallelFor(faceCount, faceThreadCount, [&faceFrame, &faceTangents, &faceBinormals](size_t begin, size_t end){
+			for(size_t face = begin; face < end; ++face){
+				faceFrame(face, faceTangents[face], faceBinormals[face]);
+			}
+		});
+
+		// Faces around each vertex, in increasing order, so that the gather sums in the same order as the sequential scatter.
+		vector<uint32_t> offsets(vertexCount + 1, 0);
+		for(size_t i = 0; i < faceCount * 3; ++i){
+			++offsets[mesh.indices[i] + 1];
+		}
+		for(size_t vid = 0; vid < vertexCount; ++vid){
+			offsets[vid + 1] += offsets[vid];
+		}
+		vector<uint32_t> vertexFaces(faceCount * 3);
+		{
+			vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for(size_t i = 0; i < faceCount * 3; ++i){
+				vertexFaces[fill[mesh.indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
 
-    	mesh.binormals[mesh.indices[fid]] += binormal;
-    	mesh.binormals[mesh.indices[fid+1]] += binormal;
-    	mesh.binormals[mesh.indices[fid+2]] += binormal;
+		// Every vertex gathers from its faces, there are no concurrent writes.
+		parallelFor(vertexCount, faceThreadCount, [&mesh, &faceTangents, &faceBinormals, &offsets, &vertexFaces](size_t begin, size_t end){
+			for(size_t vid = begin; vid < end; ++vid){
+				for(uint32_t i = offsets[vid]; i < offsets[vid + 1]; ++i){
+					mesh.tangents[vid] += faceTangents[vertexFaces[i]];
+					mesh.binormals[vid] += faceBinormals[vertexFaces[i]];
+				}
+			}
+		});
 	}
+
 	// Finally, enforce orthogonality and good orientation of the basis.
-	for(size_t tid = 0; tid < mesh.tangents.size(); ++tid){
-		mesh.tangents[tid] = normalize(mesh.tangents[tid] - mesh.normals[tid] * dot(mesh.normals[tid], mesh.tangents[tid]));
-		if(dot(cross(mesh.normals[tid], mesh.tangents[tid]), mesh.binormals[tid]) < 0.0f){
-			mesh.tangents[tid] *= -1.0f;
- 		}
+	parallelFor(vertexCount, parallelThreadCount(vertexCount, minVerticesPerThread, threadCount), [&mesh](size_t begin, size_t end){
+		for(size_t vid = begin; vid < end; ++vid){
+			const glm::vec3 & normal = mesh.normals[vid];
+			glm::vec3 & tangent = mesh.tangents[vid];
+			tangent = normalize(tangent - normal * dot(normal, tangent));
+			if(dot(cross(normal, tangent), mesh.binormals[vid]) < 0.0f){
+				tangent *= -1.0f;
+			}
+		}
+	});
+}
+
+void loadProcessedMesh(const std::string & filename, mesh_t & mesh, unsigned int threadCount){
+	loadObj(filename, mesh, Indexed, threadCount);
+	centerAndUnitMesh(mesh);
+	computeTangentsAndBinormals(mesh, threadCount);
+	optimizeMesh(mesh);
+	buildMeshLods(mesh);
+}
+
+mesh_view_t makeMeshView(const mesh_t & mesh){
+	mesh_view_t view;
+	view.positions = mesh.positions.empty() ? NULL : mesh.positions.data();
+	view.normals = mesh.normals.empty() ? NULL : mesh.normals.data();
+	view.tangents = mesh.tangents.empty() ? NULL : mesh.tangents.data();
+	view.binormals = mesh.binormals.empty() ? NULL : mesh.binormals.data();
+	view.texcoords = mesh.texcoords.empty() ? NULL : mesh.texcoords.data();
+	view.indices = mesh.indices.empty() ? NULL : mesh.indices.data();
+	view.lods = mesh.lods.empty() ? NULL : mesh.lods.data();
+	view.vertexCount = mesh.positions.size();
+	view.indexCount = mesh.indices.size();
+	view.lodCount = mesh.lods.size();
+	return view;
+}
+
+namespace {
+
+	// Project a unit vector on the octahedron, then unfold the lower half over the corners.
+	glm::vec2 encodeOctahedral(const glm::vec3 & n){
+		float norm = abs(n.x) + abs(n.y) + abs(n.z);
+		if(norm == 0.0f){
+			return glm::vec2(0.0f);
+		}
+		glm::vec2 e = glm::vec2(n.x, n.y) / norm;
+		if(n.z < 0.0f){
+			glm::vec2 signs(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+			e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * signs;
+		}
+		return e;
+	}
+
+}
+
+void packVertices(const mesh_view_t & mesh, std::vector<packed_vertex_t> & vertices){
+	vertices.resize(mesh.vertexCount);
+	for(size_t vid = 0; vid < mesh.vertexCount; ++vid){
+		packed_vertex_t & vertex = vertices[vid];
+		const glm::vec3 & normal = mesh.normals[vid];
+
+		glm::vec2 octahedral = encodeOctahedral(normal);
+		vertex.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.x));
+		vertex.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.y));
+
+		glm::vec3 tangent = mesh.tangents ? mesh.tangents[vid] : glm::vec3(1.0f, 0.0f, 0.0f);
+		float handedness = 1.0f;
+		if(mesh.tangents && mesh.binormals && dot(cross(normal, tangent), mesh.binormals[vid]) < 0.0f){
+			handedness = 0.0f;
+		}
+		vertex.tangent = glm::packUnorm3x10_1x2(glm::vec4(0.5f * tangent + 0.5f, handedness));
+
+		glm::vec2 uv = mesh.texcoords ? mesh.texcoords[vid] : glm::vec2(0.0f);
+		vertex.texcoord[0] = glm::packHalf1x16(uv.x);
+		vertex.texcoord[1] = glm::packHalf1x16(uv.y);
 	}
 }
@@ -5,6 +5,13 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+// A level of detail of a mesh: a range of its index buffer, and the geometric error of the simplification, in the units of the positions.
+typedef struct {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+} mesh_lod_t;
+
 // A mesh will be represented by a struct. For now, material information and elements/groups are not retrieved from the .obj.
 typedef struct {
 	std::vector<glm::vec3> positions;
@@ -13,8 +20,31 @@ typedef struct {
 	std::vector<glm::vec3> binormals;
 	std::vector<glm::vec2> texcoords;
 	std::vector<uint32_t> indices;
+	std::vector<mesh_lod_t> lods;	// Index ranges of the levels of detail, from the finest. Empty if indices only holds the full mesh.
 } mesh_t;
 
+// Read-only view over the streams of a processed mesh, pointing either in a mesh_t or in a mapped mesh cache.
+// Absent streams are null. Every present vertex stream has vertexCount elements.
+typedef struct {
+	const glm::vec3 * positions;
+	const glm::vec3 * normals;
+	const glm::vec3 * tangents;
+	const glm::vec3 * binormals;
+	const glm::vec2 * texcoords;
+	const uint32_t * indices;
+	const mesh_lod_t * lods;
+	size_t vertexCount;
+	size_t indexCount;
+	size_t lodCount;
+} mesh_view_t;
+
+// Quantized normal, tangent and uv of a vertex, interleaved in 12 bytes. Positions stay in their own float stream.
+typedef struct {
+	int16_t normal[2];		// Octahedral encoding, snorm16.
+	uint32_t tangent;		// xyz remapped to [0,1] as 10:10:10 unorm, binormal handedness in the 2 bits of w.
+	uint16_t texcoord[2];	// Half floats.
+} packed_vertex_t;
+
 // Three load modes: load the vertices without any connectivity (Points), 
 // 					 load them with all vertices duplicated for each face (Expanded),
 //					 load them after duplicating only the ones that are shared between faces with multiple attributes (Indexed).
@@ -23,12 +53,25 @@ enum LoadMode {
 };
 
 /// Load an obj file from disk into the mesh structure.
-void loadObj(const std::string & filename, mesh_t & mesh, LoadMode mode);
+/// Large files are parsed on up to threadCount threads (0 uses the hardware threads, at most 8); the result does not depend on it.
+void loadObj(const std::string & filename, mesh_t & mesh, LoadMode mode, unsigned int threadCount = 1);
 
 /// Center the mesh and scale it to fit in the [-1,1] box.
 void centerAndUnitMesh(mesh_t & mesh);
 
 /// Compute the tangents and binormal vectors for each vertex.
-void computeTangentsAndBinormals(mesh_t & mesh);
+/// Large meshes are processed on up to threadCount threads (0 uses all hardware threads); the result does not depend on it.
+void computeTangentsAndBinormals(mesh_t & mesh, unsigned int threadCount = 1);
+
+/// Load an obj file and apply all the processing done before rendering (indexing, centering, tangent frame, vertex cache optimization, levels of detail).
+/// Parsing and tangent computation use up to threadCount threads (0 uses the hardware threads), pass 1 when already running on a worker thread.
+void loadProcessedMesh(const std::string & filename, mesh_t & mesh, unsigned int threadCount = 1);
+
+/// Build a view over the streams of a mesh. The mesh must outlive the view.
+mesh_view_t makeMeshView(const mesh_t & mesh);
+
+/// Quantize the normals, tangents and uvs of a mesh. The binormal is only kept as its sign relative to cross(normal, tangent).
+/// Missing tangents or uvs are replaced by default values. The mesh must have normals.
+void packVertices(const mesh_view_t & mesh, std::vector<packed_vertex_t> & vertices);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "MipGenerator.h"
+#include "ParallelUtilities.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	// Kaiser window over a sinc, radius in destination pixels. Wider than a box, so it doesn't alias, and windowed, so it barely rings.
+	const float filterRadius = 2.0f;
+	const float kaiserAlpha = 4.0f;
+
+	// Smallest number of destination rows given to a thread.
+	const size_t minRowsPerThread = 32;
+
+	float besselI0(float x) {
+		float sum = 1.0f;
+		float term = 1.0f;
+		float y = x * x / 4.0f;
+		for (int k = 1; k < 20; k++) {
+			term *= y / float(k * k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float kaiser(float distance) {
+		if (std::abs(distance) >= filterRadius) return 0.0f;
+		float sinc = 1.0f;
+		if (std::abs(distance) > 1e-6f) {
+			float x = 3.14159265f * distance;
+			sinc = std::sin(x) / x;
+		}
+		float t = distance / filterRadius;
+		return sinc * besselI0(kaiserAlpha * std::sqrt(1.0f - t * t)) / besselI0(kaiserAlpha);
+	}
+
+	// Taps of every destination pixel along one axis, with the source indices clamped to the edges.
+	struct AxisFilter {
+		size_t taps;
+		std::vector<unsigned> indices;
+		std::vector<float> weights;
+	};
+
+	AxisFilter buildAxisFilter(unsigned source, unsigned dest) {
+		float scale = float(source) / float(dest);
+		float support = filterRadius * scale;
+
+		AxisFilter filter;
+		filter.taps = static_cast<size_t>(std::ceil(2.0f * support)) + 1;
+		filter.indices.resize(dest * filter.taps);
+		filter.weights.resize(dest * filter.taps);
+
+		for (unsigned d = 0; d < dest; d++) {
+			float center = (d + 0.5f) * scale;
+			int first = static_cast<int>(std::floor(center - support + 0.5f));
+			float sum = 0.0f;
+			for (size_t t = 0; t < filter.taps; t++) {
+				int i = first + static_cast<int>(t);
+				float weight = kaiser((i + 0.5f - center) / scale);
+				filter.indices[d * filter.taps + t] = static_cast<unsigned>(std::min(std::max(i, 0), int(source) - 1));
+				filter.weights[d * filter.taps + t] = weight;
+				sum += weight;
+			}
+			for (size_t t = 0; t < filter.taps; t++) {
+				filter.weights[d * filter.taps + t] /= sum;
+			}
+		}
+		return filter;
+	}
+
+	float srgbToLinear(float value) {
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	// Conversions between 8 bits values and the floats that are filtered, per channel.
+	struct Codec {
+		MipContent content;
+		float decode[256];	// color channels
+		float thresholds[255];	// linear values halfway between two sRGB codes, for rounding
+
+		Codec(MipContent content) : content(content) {
+			for (int i = 0; i < 256; i++) {
+				if (content == MipColor) decode[i] = srgbToLinear(i / 255.0f);
+				else if (content == MipNormal) decode[i] = i / 255.0f * 2.0f - 1.0f;
+				else decode[i] = i / 255.0f;
+			}
+			for (int i = 0; i < 255; i++) {
+				thresholds[i] = srgbToLinear((i + 0.5f) / 255.0f);
+			}
+		}
+
+		void Decode(const unsigned char * in, float * out) const {
+			out[0] = decode[in[0]];
+			out[1] = decode[in[1]];
+			out[2] = decode[in[2]];
+			out[3] = in[3] / 255.0f;
+		}
+
+		// Also clamps the filtered values, and renormalizes normals, which the next level is filtered from.
+		void Encode(float * value, unsigned char * out) const {
+			if (content == MipNormal) {
+				for (int c = 0; c < 3; c++) value[c] = std::min(1.0f, std::max(-1.0f, value[c]));
+				float length = std::sqrt(value[0] * value[0] + value[1] * value[1] + value[2] * value[2]);
+				if (length > 1e-6f) {
+					for (int c = 0; c < 3; c++) value[c] /= length;
+				} else {
+					value[0] = value[1] = 0.0f;
+					value[2] = 1.0f;
+				}
+			} else {
+				for (int c = 0; c < 3; c++) value[c] = std::min(1.0f, std::max(0.0f, value[c]));
+			}
+			value[3] = std::min(1.0f, std::max(0.0f, value[3]));
+
+			for (int c = 0; c < 3; c++) {
+				if (content == MipColor) {
+					out[c] = static_cast<unsigned char>(std::upper_bound(thresholds, thresholds + 255, value[c]) - thresholds);
+				} else if (content == MipNormal) {
+					out[c] = static_cast<unsigned char>((value[c] * 0.5f + 0.5f) * 255.0f + 0.5f);
+				} else {
+					out[c] = static_cast<unsigned char>(value[c] * 255.0f + 0.5f);
+				}
+			}
+			out[3] = static_cast<unsigned char>(value[3] * 255.0f + 0.5f);
+		}
+	};
+
+	// Sum of the taps of one destination pixel, pixels are 4 floats.
+	inline void filterPixel(const float * source, const unsigned * indices, const float * weights, size_t taps, float * out) {
+#ifdef MIP_GENERATOR_SSE
+		__m128 sum = _mm_setzero_ps();
+		for (size_t t = 0; t < taps; t++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + size_t(indices[t]) * 4), _mm_set1_ps(weights[t])));
+		}
+		_mm_storeu_ps(out, sum);
+#else
+		float sum[4] = {};
+		for (size_t t = 0; t < taps; t++) {
+			const float * pixel = source + size_t(indices[t]) * 4;
+			for (int c = 0; c < 4; c++) sum[c] += pixel[c] * weights[t];
+		}
+		for (int c = 0; c < 4; c++) out[c] = sum[c];
+#endif
+	}
+
+	// out += row * weight, for count floats.
+	inline void accumulateRow(const float * row, float weight, size_t count, float * out) {
+		size_t i = 0;
+#ifdef MIP_GENERATOR_SSE
+		__m128 w = _mm_set1_ps(weight);
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(row + i), w)));
+		}
+#endif
+		for (; i < count; i++) {
+			out[i] += row[i] * weight;
+		}
+	}
+}
+
+unsigned mipLevelCount(unsigned width, unsigned height) {
+	unsigned count = 1;
+	while (width > 1 || height > 1) {
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+		count++;
+	}
+	return count;
+}
+
+void mipLevelSize(unsigned width, unsigned height, unsigned level, unsigned & levelWidth, unsigned & levelHeight) {
+	levelWidth = std::max(1u, width >> std::min(level, 31u));
+	levelHeight = std::max(1u, height >> std::min(level, 31u));
+}
+
+void generateMipChain(const unsigned char * rgba, unsigned width, unsigned height, MipContent content, std::vector<std::vector<unsigned char>> & levels, unsigned threadCount) {
+	const Codec codec(content);
+	unsigned count = mipLevelCount(width, height);
+	levels.resize(count - 1);
+
+	//the base is decoded a row at a time while filtering it, the following levels are kept in floats
+	std::vector<float> source;
+	std::vector<float> horizontal;
+	std::vector<float> dest;
+	for (unsigned level = 1; level < count; level++) {
+		unsigned w, h;
+		mipLevelSize(width, height, 1, w, h);
+
+		//rows first, then columns of the filtered rows
+		AxisFilter rows = buildAxisFilter(width, w);
+		AxisFilter columns = buildAxisFilter(height, h);
+
+		horizontal.resize(size_t(w) * height * 4);
+		parallelFor(height, parallelThreadCount(height, minRowsPerThread, threadCount), [&](size_t begin, size_t end) {
+			std::vector<float> decoded(level == 1 ? size_t(width) * 4 : 0);
+			for (size_t y = begin; y < end; y++) {
+				const float * row;
+				if (level == 1) {
+					for (size_t x = 0; x < width; x++) {
+						codec.Decode(rgba + (y * width + x) * 4, &decoded[x * 4]);
+					}
+					row = decoded.data();
+				} else {
+					row = &source[y * width * 4];
+				}
+				for (size_t x = 0; x < w; x++) {
+					filterPixel(row, &rows.indices[x * rows.taps], &rows.weights[x * rows.taps], rows.taps, &horizontal[(y * w + x) * 4]);
+				}
+			}
+		});
+
+		dest.assign(size_t(w) * h * 4, 0.0f);	//accumulated
+		std::vector<unsigned char> & out = levels[level - 1];
+		out.resize(size_t(w) * h * 4);
+		parallelFor(h, parallelThreadCount(h, minRowsPerThread, threadCount), [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; y++) {
+				float * row = &dest[y * w * 4];
+				for (size_t t = 0; t < columns.taps; t++) {
+					accumulateRow(&horizontal[size_t(columns.indices[y * columns.taps + t]) * w * 4], columns.weights[y * columns.taps + t], size_t(w) * 4, row);
+				}
+				for (size_t x = 0; x < w; x++) {
+					codec.Encode(row + x * 4, &out[(y * w + x) * 4]);
+				}
+			}
+		});
+
+		source.swap(dest);
+		width = w;
+		height = h;
+	}
+}
@@ -0,0 +1,25 @@
+#ifndef MipGenerator_h
+#define MipGenerator_h
+
+#include <vector>
+
+/// What the channels of an image hold, which decides how they are filtered. Alpha is always linear.
+enum MipContent {
+	MipColor,	// sRGB color, filtered in linear space.
+	MipNormal,	// Normal encoded in rgb, renormalized after filtering.
+	MipData	// Independent linear channels.
+};
+
+/// Number of levels of a full mip chain, down to 1x1.
+unsigned mipLevelCount(unsigned width, unsigned height);
+
+/// Size of a level of a mip chain: each dimension is halved and rounded down, and never goes below 1.
+void mipLevelSize(unsigned width, unsigned height, unsigned level, unsigned & levelWidth, unsigned & levelHeight);
+
+/// Build the levels after the base of an 8 bits RGBA image, down to 1x1. levels[i] receives level i + 1.
+/// Each level is filtered from the previous one, kept in floating point, with a separable Kaiser windowed sinc.
+/// Every destination pixel is centered on its exact footprint, so odd and non-square sizes are filtered correctly.
+/// Rows are split on up to threadCount threads (0 uses all hardware threads).
+void generateMipChain(const unsigned char * rgba, unsigned width, unsigned height, MipContent content, std::vector<std::vector<unsigned char>> & levels, unsigned threadCount = 1);
+
+#endif
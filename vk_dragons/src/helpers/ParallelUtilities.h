@@ -0,0 +1,34 @@
+#ifndef ParallelUtilities_h
+#define ParallelUtilities_h
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// Number of threads worth using for count items, given the smallest amount of work per thread, and at most maxThreads (0 uses all hardware threads).
+inline size_t parallelThreadCount(size_t count, size_t minPerThread, unsigned maxThreads = 0){
+	if(maxThreads == 0){
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	return std::max(size_t(1), std::min(static_cast<size_t>(maxThreads), count / minPerThread));
+}
+
+/// Split [0, count) in contiguous ranges processed by function(begin, end) on threadCount threads, the calling one included.
+template<typename Function>
+void parallelFor(size_t count, size_t threadCount, Function function){
+	if(threadCount <= 1){
+		function(size_t(0), count);
+		return;
+	}
+	std::vector<std::thread> threads;
+	for(size_t tid = 0; tid + 1 < threadCount; ++tid){
+		threads.emplace_back(function, count * tid / threadCount, count * (tid + 1) / threadCount);
+	}
+	function(count * (threadCount - 1) / threadCount, count);
+	for(std::thread & worker : threads){
+		worker.join();
+	}
+}
+
+#endif
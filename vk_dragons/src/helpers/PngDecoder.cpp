@@ -0,0 +1,550 @@
+#include "PngDecoder.h"
+#include "lodepng/lodepng.h"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_DECODER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	const unsigned char pngSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	uint32_t readBigEndian(const unsigned char * p) {
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	// Inflate.
+
+	const unsigned lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const unsigned lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const unsigned distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const unsigned distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const unsigned codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// Codes up to this length are decoded with a single table lookup, longer ones are rare.
+	const unsigned fastBits = 10;
+
+	unsigned reverseBits(unsigned code, unsigned length) {
+		unsigned reversed = 0;
+		for (unsigned i = 0; i < length; i++) {
+			reversed = (reversed << 1) | (code & 1);
+			code >>= 1;
+		}
+		return reversed;
+	}
+
+	// Canonical Huffman code. Deflate stores codes starting from their most significant bit, so the table is indexed by reversed bits.
+	struct Huffman {
+		uint16_t fast[1 << fastBits];	// length << 9 | symbol, 0 when the code is longer than fastBits
+		uint32_t maxCode[17];	// first code of each length that is too large, left aligned on 16 bits
+		uint16_t firstCode[16];
+		uint16_t firstSymbol[16];
+		uint16_t symbols[288];	// sorted by code
+
+		bool Build(const unsigned char * lengths, unsigned count) {
+			unsigned lengthCounts[16] = {};
+			for (unsigned i = 0; i < count; i++) lengthCounts[lengths[i]]++;
+			lengthCounts[0] = 0;
+
+			unsigned nextCode[16];
+			unsigned code = 0;
+			unsigned symbol = 0;
+			for (unsigned length = 1; length < 16; length++) {
+				nextCode[length] = code;
+				firstCode[length] = static_cast<uint16_t>(code);
+				firstSymbol[length] = static_cast<uint16_t>(symbol);
+				code += lengthCounts[length];
+				if (lengthCounts[length] > 0 && code - 1 >= (1u << length)) return false;	// oversubscribed
+				maxCode[length] = code << (16 - length);
+				code <<= 1;
+				symbol += lengthCounts[length];
+			}
+			maxCode[16] = 0x10000;
+
+			memset(fast, 0, sizeof(fast));
+			for (unsigned i = 0; i < count; i++) {
+				unsigned length = lengths[i];
+				if (length == 0) continue;
+				unsigned index = nextCode[length] - firstCode[length] + firstSymbol[length];
+				symbols[index] = static_cast<uint16_t>(i);
+				if (length <= fastBits) {
+					for (unsigned j = reverseBits(nextCode[length], length); j < (1u << fastBits); j += 1u << length) {
+						fast[j] = static_cast<uint16_t>((length << 9) | i);
+					}
+				}
+				nextCode[length]++;
+			}
+			return true;
+		}
+	};
+
+	// Little endian bit reader. Bits past the end of the input read as 0, using them is an error.
+	struct BitReader {
+		const unsigned char * p;
+		const unsigned char * end;
+		uint64_t bits;
+		unsigned count;
+		bool overrun;
+
+		void Refill() {
+			while (count <= 56 && p < end) {
+				bits |= uint64_t(*p++) << count;
+				count += 8;
+			}
+		}
+
+		void Consume(unsigned n) {
+			if (n > count) {
+				overrun = true;
+				n = count;
+			}
+			bits >>= n;
+			count -= n;
+		}
+
+		unsigned Read(unsigned n) {
+			if (count < n) Refill();
+			unsigned value = static_cast<unsigned>(bits & ((uint64_t(1) << n) - 1));
+			Consume(n);
+			return value;
+		}
+
+		// Returns a symbol above 287 on invalid codes.
+		unsigned Decode(const Huffman & huffman) {
+			if (count < 16) Refill();
+			unsigned entry = huffman.fast[bits & ((1u << fastBits) - 1)];
+			if (entry != 0) {
+				Consume(entry >> 9);
+				return entry & 511;
+			}
+
+			unsigned code = reverseBits(static_cast<unsigned>(bits & 0xffff), 16);
+			unsigned length = fastBits + 1;
+			while (code >= huffman.maxCode[length]) length++;
+			if (length >= 16) return 0xffff;
+			unsigned index = (code >> (16 - length)) - huffman.firstCode[length] + huffman.firstSymbol[length];
+			if (index >= 288) return 0xffff;
+			Consume(length);
+			return huffman.symbols[index];
+		}
+	};
+
+	void buildFixedCodes(Huffman & literals, Huffman & distances) {
+		unsigned char lengths[288];
+		for (unsigned i = 0; i < 144; i++) lengths[i] = 8;
+		for (unsigned i = 144; i < 256; i++) lengths[i] = 9;
+		for (unsigned i = 256; i < 280; i++) lengths[i] = 7;
+		for (unsigned i = 280; i < 288; i++) lengths[i] = 8;
+		literals.Build(lengths, 288);
+		for (unsigned i = 0; i < 30; i++) lengths[i] = 5;
+		distances.Build(lengths, 30);
+	}
+
+	bool readDynamicCodes(BitReader & reader, Huffman & literals, Huffman & distances) {
+		unsigned literalCount = reader.Read(5) + 257;
+		unsigned distanceCount = reader.Read(5) + 1;
+		unsigned codeLengthCount = reader.Read(4) + 4;
+		if (literalCount > 286 || distanceCount > 30) return false;
+
+		unsigned char codeLengthLengths[19] = {};
+		for (unsigned i = 0; i < codeLengthCount; i++) {
+			codeLengthLengths[codeLengthOrder[i]] = static_cast<unsigned char>(reader.Read(3));
+		}
+		Huffman codeLengths;
+		if (!codeLengths.Build(codeLengthLengths, 19)) return false;
+
+		unsigned char lengths[286 + 30];
+		unsigned total = literalCount + distanceCount;
+		unsigned i = 0;
+		while (i < total) {
+			unsigned symbol = reader.Decode(codeLengths);
+			unsigned repeat = 0;
+			unsigned char value = 0;
+			if (symbol < 16) {
+				lengths[i++] = static_cast<unsigned char>(symbol);
+				continue;
+			} else if (symbol == 16) {
+				if (i == 0) return false;
+				value = lengths[i - 1];
+				repeat = 3 + reader.Read(2);
+			} else if (symbol == 17) {
+				repeat = 3 + reader.Read(3);
+			} else if (symbol == 18) {
+				repeat = 11 + reader.Read(7);
+			} else {
+				return false;
+			}
+			if (i + repeat > total) return false;
+			memset(lengths + i, value, repeat);
+			i += repeat;
+		}
+		if (lengths[256] == 0 || reader.overrun) return false;
+
+		return literals.Build(lengths, literalCount) && distances.Build(lengths + literalCount, distanceCount);
+	}
+
+	uint32_t adler32(const unsigned char * data, size_t size) {
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while (size > 0) {
+			// Largest block whose sums can't overflow before the modulo.
+			size_t block = std::min<size_t>(size, 5552);
+			size -= block;
+			for (size_t i = 0; i < block; i++) {
+				a += data[i];
+				b += a;
+			}
+			data += block;
+			a %= 65521;
+			b %= 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	// Unfilter. Each row starts with a filter type, and bytes are predicted from the pixel on the left (a), above (b) and above left (c).
+
+	unsigned char paeth(int a, int b, int c) {
+		int pa = std::abs(b - c);
+		int pb = std::abs(a - c);
+		int pc = std::abs(a + b - 2 * c);
+		if (pa <= pb && pa <= pc) return static_cast<unsigned char>(a);
+		if (pb <= pc) return static_cast<unsigned char>(b);
+		return static_cast<unsigned char>(c);
+	}
+
+	// Any pixel size, one byte at a time. out can be the same as in.
+	void unfilterRowScalar(unsigned char * out, const unsigned char * in, const unsigned char * prev, size_t size, unsigned bpp, unsigned char type) {
+		switch (type) {
+		case 0:
+			if (out != in) memcpy(out, in, size);
+			break;
+		case 1:
+			for (size_t i = 0; i < bpp; i++) out[i] = in[i];
+			for (size_t i = bpp; i < size; i++) out[i] = static_cast<unsigned char>(in[i] + out[i - bpp]);
+			break;
+		case 2:
+			for (size_t i = 0; i < size; i++) out[i] = static_cast<unsigned char>(in[i] + prev[i]);
+			break;
+		case 3:
+			for (size_t i = 0; i < bpp; i++) out[i] = static_cast<unsigned char>(in[i] + (prev[i] >> 1));
+			for (size_t i = bpp; i < size; i++) out[i] = static_cast<unsigned char>(in[i] + ((out[i - bpp] + prev[i]) >> 1));
+			break;
+		case 4:
+			for (size_t i = 0; i < bpp; i++) out[i] = static_cast<unsigned char>(in[i] + prev[i]);
+			for (size_t i = bpp; i < size; i++) out[i] = static_cast<unsigned char>(in[i] + paeth(out[i - bpp], prev[i], prev[i - bpp]));
+			break;
+		}
+	}
+
+#ifdef PNG_DECODER_SSE
+	// One pixel of 3 or 4 bytes in the low lanes. Only BPP bytes are touched, so rows can be unfiltered in place.
+	template<unsigned BPP>
+	inline __m128i loadPixel(const unsigned char * p) {
+		int value = 0;
+		memcpy(&value, p, BPP);
+		return _mm_cvtsi32_si128(value);
+	}
+
+	template<unsigned BPP>
+	inline void storePixel(unsigned char * p, __m128i pixel) {
+		int value = _mm_cvtsi128_si32(pixel);
+		memcpy(p, &value, BPP);
+	}
+
+	// The serial dependency on the left pixel remains, but all the bytes of a pixel are done at once.
+	template<unsigned BPP>
+	void unfilterRowSse(unsigned char * out, const unsigned char * in, const unsigned char * prev, size_t size, unsigned char type) {
+		const __m128i zero = _mm_setzero_si128();
+		switch (type) {
+		case 1: {
+			__m128i a = zero;
+			for (size_t i = 0; i < size; i += BPP) {
+				a = _mm_add_epi8(loadPixel<BPP>(in + i), a);
+				storePixel<BPP>(out + i, a);
+			}
+			break;
+		}
+		case 2: {
+			size_t i = 0;
+			for (; i + 16 <= size; i += 16) {
+				__m128i x = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), x);
+			}
+			for (; i < size; i++) out[i] = static_cast<unsigned char>(in[i] + prev[i]);
+			break;
+		}
+		case 3: {
+			// _mm_avg_epu8 rounds up, the filter rounds down.
+			const __m128i one = _mm_set1_epi8(1);
+			__m128i a = zero;
+			for (size_t i = 0; i < size; i += BPP) {
+				__m128i b = loadPixel<BPP>(prev + i);
+				__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+				a = _mm_add_epi8(loadPixel<BPP>(in + i), average);
+				storePixel<BPP>(out + i, a);
+			}
+			break;
+		}
+		case 4: {
+			// In 16 bits lanes, so that the distances don't overflow.
+			__m128i a = zero;
+			__m128i c = zero;
+			for (size_t i = 0; i < size; i += BPP) {
+				__m128i b = _mm_unpacklo_epi8(loadPixel<BPP>(prev + i), zero);
+				__m128i bc = _mm_sub_epi16(b, c);
+				__m128i ac = _mm_sub_epi16(a, c);
+				__m128i abc = _mm_add_epi16(ac, bc);
+				__m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+				__m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+				__m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+
+				__m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+				__m128i useC = _mm_and_si128(notA, _mm_cmpgt_epi16(pb, pc));
+				__m128i useB = _mm_andnot_si128(useC, notA);
+				__m128i predictor = _mm_or_si128(_mm_andnot_si128(notA, a), _mm_or_si128(_mm_and_si128(useB, b), _mm_and_si128(useC, c)));
+
+				__m128i x = _mm_add_epi8(loadPixel<BPP>(in + i), _mm_packus_epi16(predictor, zero));
+				storePixel<BPP>(out + i, x);
+				a = _mm_unpacklo_epi8(x, zero);
+				c = b;
+			}
+			break;
+		}
+		default:
+			unfilterRowScalar(out, in, prev, size, BPP, type);
+			break;
+		}
+	}
+#endif
+
+	void unfilterRow(unsigned char * out, const unsigned char * in, const unsigned char * prev, size_t size, unsigned bpp, unsigned char type) {
+#ifdef PNG_DECODER_SSE
+		if (bpp == 4) return unfilterRowSse<4>(out, in, prev, size, type);
+		if (bpp == 3) return unfilterRowSse<3>(out, in, prev, size, type);
+#endif
+		unfilterRowScalar(out, in, prev, size, bpp, type);
+	}
+
+	// Expand an unfiltered row of gray, gray alpha or RGB pixels to RGBA.
+	void expandRow(unsigned char * out, const unsigned char * in, unsigned width, unsigned channels) {
+		for (unsigned x = 0; x < width; x++, out += 4, in += channels) {
+			switch (channels) {
+			case 1:
+				out[0] = out[1] = out[2] = in[0];
+				out[3] = 255;
+				break;
+			case 2:
+				out[0] = out[1] = out[2] = in[0];
+				out[3] = in[1];
+				break;
+			case 3:
+				out[0] = in[0];
+				out[1] = in[1];
+				out[2] = in[2];
+				out[3] = 255;
+				break;
+			}
+		}
+	}
+}
+
+bool zlibDecompress(const unsigned char * in, size_t inSize, unsigned char * out, size_t outSize) {
+	if (inSize < 6) return false;
+	unsigned method = in[0] & 15;
+	if (method != 8 || ((in[0] << 8) | in[1]) % 31 != 0 || (in[1] & 32) != 0) return false;	// deflate, no preset dictionary
+
+	BitReader reader = { in + 2, in + inSize - 4, 0, 0, false };
+	size_t position = 0;
+	Huffman literals;
+	Huffman distances;
+
+	bool last = false;
+	while (!last) {
+		last = reader.Read(1) == 1;
+		unsigned type = reader.Read(2);
+
+		if (type == 0) {
+			// Stored, starts on the next byte. Whole bytes still in the reader are given back.
+			reader.Consume(reader.count & 7);
+			reader.p -= reader.count / 8;
+			reader.bits = 0;
+			reader.count = 0;
+			if (reader.end - reader.p < 4) return false;
+			unsigned length = reader.p[0] | (reader.p[1] << 8);
+			unsigned check = reader.p[2] | (reader.p[3] << 8);
+			reader.p += 4;
+			if ((length ^ 0xffff) != check || size_t(reader.end - reader.p) < length || outSize - position < length) return false;
+			memcpy(out + position, reader.p, length);
+			reader.p += length;
+			position += length;
+			continue;
+		}
+
+		if (type == 1) {
+			buildFixedCodes(literals, distances);
+		} else if (type == 2) {
+			if (!readDynamicCodes(reader, literals, distances)) return false;
+		} else {
+			return false;
+		}
+
+		while (true) {
+			unsigned symbol = reader.Decode(literals);
+			if (symbol < 256) {
+				if (position >= outSize) return false;
+				out[position++] = static_cast<unsigned char>(symbol);
+				continue;
+			}
+			if (symbol == 256) break;
+			symbol -= 257;
+			if (symbol >= 29) return false;
+			size_t length = lengthBase[symbol] + reader.Read(lengthExtra[symbol]);
+
+			unsigned distanceSymbol = reader.Decode(distances);
+			if (distanceSymbol >= 30) return false;
+			size_t distance = distanceBase[distanceSymbol] + reader.Read(distanceExtra[distanceSymbol]);
+			if (distance > position || outSize - position < length) return false;
+
+			// Copies 8 bytes at a time when they don't overlap the bytes being written, which can write up to 7 bytes of slack.
+			unsigned char * dst = out + position;
+			const unsigned char * src = dst - distance;
+			if (distance >= 8) {
+				for (size_t i = 0; i < length; i += 8) {
+					memcpy(dst + i, src + i, 8);
+				}
+			} else {
+				for (size_t i = 0; i < length; i++) {
+					dst[i] = src[i];
+				}
+			}
+			position += length;
+		}
+
+		if (reader.overrun) return false;
+	}
+
+	if (position != outSize) return false;
+	return adler32(out, outSize) == readBigEndian(in + inSize - 4);
+}
+
+PngImage::PngImage() {
+	width = 0;
+	height = 0;
+	bitDepth = 0;
+	colorType = 0;
+	interlace = 0;
+	compressed = nullptr;
+	compressedSize = 0;
+}
+
+bool PngImage::Open(const std::string & filename) {
+	if (!file.Open(filename)) return false;
+
+	const unsigned char * data = reinterpret_cast<const unsigned char*>(file.GetData());
+	size_t size = file.GetSize();
+	if (size < 33 || memcmp(data, pngSignature, 8) != 0) return false;
+
+	//chunks are a length, a type, the data and a crc. The crc isn't checked, the zlib stream has its own checksum
+	std::vector<std::pair<const unsigned char *, size_t>> idat;
+	size_t offset = 8;
+	bool header = false;
+	while (offset + 12 <= size) {
+		size_t length = readBigEndian(data + offset);
+		const unsigned char * type = data + offset + 4;
+		const unsigned char * chunk = data + offset + 8;
+		if (length > size - offset - 12) return false;
+
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+			width = readBigEndian(chunk);
+			height = readBigEndian(chunk + 4);
+			bitDepth = chunk[8];
+			colorType = chunk[9];
+			interlace = chunk[12];
+			header = true;
+		} else if (memcmp(type, "IDAT", 4) == 0) {
+			idat.push_back({ chunk, length });
+		} else if (memcmp(type, "IEND", 4) == 0) {
+			break;
+		}
+		offset += length + 12;
+	}
+	if (!header || idat.empty() || width == 0 || height == 0) return false;
+
+	if (idat.size() == 1) {
+		compressed = idat[0].first;
+		compressedSize = idat[0].second;
+	} else {
+		for (auto & chunk : idat) {
+			joined.insert(joined.end(), chunk.first, chunk.first + chunk.second);
+		}
+		compressed = joined.data();
+		compressedSize = joined.size();
+	}
+	return true;
+}
+
+unsigned PngImage::GetWidth() const {
+	return width;
+}
+
+unsigned PngImage::GetHeight() const {
+	return height;
+}
+
+size_t PngImage::GetDecodedSize() const {
+	return size_t(width) * height * 4;
+}
+
+bool PngImage::Decode(unsigned char * dest) const {
+	bool fast = bitDepth == 8 && interlace == 0 && (colorType == 0 || colorType == 2 || colorType == 4 || colorType == 6);
+	return fast ? DecodeFast(dest) : DecodeLodepng(dest);
+}
+
+bool PngImage::DecodeFast(unsigned char * dest) const {
+	const unsigned channelCounts[7] = { 1, 0, 3, 0, 2, 0, 4 };
+	unsigned channels = channelCounts[colorType];
+	size_t rowSize = size_t(width) * channels;
+	size_t destRowSize = size_t(width) * 4;
+
+	std::vector<unsigned char> filtered(height * (rowSize + 1) + 8);
+	if (!zlibDecompress(compressed, compressedSize, filtered.data(), height * (rowSize + 1))) return false;
+
+	//the first row is predicted from a row of zeros
+	std::vector<unsigned char> zeros(rowSize, 0);
+	const unsigned char * prev = zeros.data();
+
+	for (unsigned y = 0; y < height; y++) {
+		unsigned char * row = filtered.data() + y * (rowSize + 1);
+		unsigned char type = row[0];
+		if (type > 4) return false;
+		unsigned char * destRow = dest + (height - 1 - y) * destRowSize;
+
+		//RGBA rows are unfiltered straight into their place, the others in place, then expanded
+		if (channels == 4) {
+			unfilterRow(destRow, row + 1, prev, rowSize, channels, type);
+			prev = destRow;
+		} else {
+			unfilterRow(row + 1, row + 1, prev, rowSize, channels, type);
+			expandRow(destRow, row + 1, width, channels);
+			prev = row + 1;
+		}
+	}
+	return true;
+}
+
+bool PngImage::DecodeLodepng(unsigned char * dest) const {
+	std::vector<unsigned char> image;
+	unsigned w, h;
+	const unsigned char * data = reinterpret_cast<const unsigned char*>(file.GetData());
+	if (lodepng::decode(image, w, h, data, file.GetSize()) != 0 || w != width || h != height) return false;
+
+	size_t rowSize = size_t(width) * 4;
+	for (unsigned y = 0; y < height; y++) {
+		memcpy(dest + (height - 1 - y) * rowSize, image.data() + y * rowSize, rowSize);
+	}
+	return true;
+}
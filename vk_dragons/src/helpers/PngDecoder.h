@@ -0,0 +1,50 @@
+#ifndef PngDecoder_h
+#define PngDecoder_h
+
+#include <string>
+#include <vector>
+#include "FileUtilities.h"
+
+/// A PNG file mapped in memory, with its header parsed.
+/// Decodes to 8 bits RGBA, bottom row first, which is the order the textures are uploaded in.
+/// 8 bits gray, gray alpha, RGB and RGBA images without interlacing take the fast path: table driven inflate,
+/// SSE2 unfiltering straight into the destination. Everything else is decoded by lodepng, then copied.
+class PngImage {
+public:
+	PngImage();
+
+	/// Map the file and read its header. Returns false if it can't be read or isn't a PNG.
+	bool Open(const std::string & filename);
+
+	unsigned GetWidth() const;
+	unsigned GetHeight() const;
+	/// Bytes written by Decode.
+	size_t GetDecodedSize() const;
+
+	/// Decode into dest, which holds GetDecodedSize() bytes. Can run on any thread. Returns false on corrupted data.
+	bool Decode(unsigned char * dest) const;
+
+private:
+	MappedFile file;
+	unsigned width;
+	unsigned height;
+	unsigned char bitDepth;
+	unsigned char colorType;
+	unsigned char interlace;
+	/// Compressed image data, pointing in the file when it is a single IDAT chunk.
+	const unsigned char * compressed;
+	size_t compressedSize;
+	std::vector<unsigned char> joined;
+
+	PngImage(const PngImage & other) = delete;
+	PngImage & operator = (const PngImage & other) = delete;
+
+	bool DecodeFast(unsigned char * dest) const;
+	bool DecodeLodepng(unsigned char * dest) const;
+};
+
+/// Inflate a zlib stream into out, which must hold exactly outSize bytes once decompressed, plus 8 bytes of slack.
+/// Returns false if the stream is corrupted or doesn't have that size.
+bool zlibDecompress(const unsigned char * in, size_t inSize, unsigned char * out, size_t outSize);
+
+#endif
@@ -4,8 +4,6 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
-#include <algorithm>
-#include <lodepng/lodepng.h>
 #include <map>
 
 std::string loadStringFromFile(const std::string & filename) {
@@ -25,19 +23,6 @@ std::string loadStringFromFile(const std::string & filename) {
 	return line;
 }
 
-void flipImage(std::vector<unsigned char> & image, const int width, const int height){
-	// Compute the number of components per pixel.
-	int components = static_cast<int>(image.size() / (width * height));
-	// The width in bytes.
-	int widthInBytes = width * components;
-	int halfHeight = height/2;
-
-	// For each line of the first half, we swap it with the mirroring line, starting from the end of the image.
-	for(int h=0; h < halfHeight; h++){
-		std::swap_ranges(image.begin() + h * widthInBytes, image.begin() + (h+1) * widthInBytes , image.begin() + (height - h - 1) * widthInBytes);
-	}
-}
-
 std::vector<char> loadFile(const std::string& filename) {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -68,10 +53,10 @@ Buffer CreateBuffer(Renderer& renderer, VkDeviceSize size, VkBufferUsageFlags us
 	}
 
 	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(renderer.device, buffer, &memRequirements);
+	bool dedicated = renderer.memory->GetBufferRequirements(buffer, memRequirements);
 
 	Allocator& allocator = renderer.memory->GetDeviceAllocator(memRequirements);
-	Allocation alloc = allocator.Alloc(memRequirements);
+	Allocation alloc = dedicated ? allocator.AllocDedicated(memRequirements, buffer, VK_NULL_HANDLE) : allocator.Alloc(memRequirements, buffer, VK_NULL_HANDLE);
 
 	vkBindBufferMemory(renderer.device, buffer, alloc.memory, alloc.offset);
 
@@ -92,10 +77,10 @@ Buffer CreateHostBuffer(Renderer& renderer, VkDeviceSize size, VkBufferUsageFlag
 	}
 
 	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(renderer.device, buffer, &memRequirements);
+	bool dedicated = renderer.memory->GetBufferRequirements(buffer, memRequirements);
 
 	Allocator& allocator = renderer.memory->GetHostAllocator();
-	Allocation alloc = allocator.Alloc(memRequirements);
+	Allocation alloc = dedicated ? allocator.AllocDedicated(memRequirements, buffer, VK_NULL_HANDLE) : allocator.Alloc(memRequirements, buffer, VK_NULL_HANDLE);
 
 	vkBindBufferMemory(renderer.device, buffer, alloc.memory, alloc.offset);
 
@@ -141,10 +126,10 @@ Image CreateImage(Renderer& renderer, VkFormat format, uint32_t width, uint32_t
 	}
 
 	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(renderer.device, image, &memRequirements);
+	bool dedicated = renderer.memory->GetImageRequirements(image, memRequirements);
 
 	Allocator& allocator = renderer.memory->GetDeviceAllocator(memRequirements);
-	Allocation alloc = allocator.Alloc(memRequirements);
+	Allocation alloc = dedicated ? allocator.AllocDedicated(memRequirements, VK_NULL_HANDLE, image) : allocator.Alloc(memRequirements, VK_NULL_HANDLE, image);
 
 	vkBindImageMemory(renderer.device, image, alloc.memory, alloc.offset);
 
@@ -0,0 +1,338 @@
+#include "TextureCache.h"
+#include "PngDecoder.h"
+#include "BlockCompression.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <cstdio>
+#include <cstring>
+
+//bump when the layout or the processing of the cached texture changes, to invalidate existing caches
+#define TEXTURE_CACHE_VERSION 2
+#define TEXTURE_CACHE_ALIGNMENT 16
+#define TEXTURE_CACHE_MAX_SOURCES 6
+#define TEXTURE_CACHE_MAX_LEVELS 16
+
+namespace {
+	const char textureCacheMagic[8] = { 'V', 'K', 'T', 'E', 'X', 0, 0, 0 };
+	const char* cubemapSuffixes[6] = { "_r", "_l", "_d", "_u", "_b", "_f" };
+
+	//state of a source .png when the cache was written
+	struct TextureCacheSource {
+		uint64_t size;
+		int64_t time;
+		uint64_t hash;
+	};
+
+	struct TextureCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layerCount;
+		uint32_t levelCount;
+		uint32_t sourceCount;
+		uint32_t padding;
+		TextureCacheSource sources[TEXTURE_CACHE_MAX_SOURCES];
+		//byte offset from the start of the file and byte size of each level, all layers included
+		uint64_t levelOffsets[TEXTURE_CACHE_MAX_LEVELS];
+		uint64_t levelSizes[TEXTURE_CACHE_MAX_LEVELS];
+	};
+
+	uint64_t alignOffset(uint64_t offset) {
+		return (offset + TEXTURE_CACHE_ALIGNMENT - 1) & ~uint64_t(TEXTURE_CACHE_ALIGNMENT - 1);
+	}
+
+	bool hashFile(const std::string & filename, uint64_t & hash) {
+		MappedFile file;
+		if (!file.Open(filename)) return false;
+		hash = hashBuffer(file.GetData(), file.GetSize());
+		return true;
+	}
+
+	//size of one layer of a level
+	uint64_t layerSize(TextureCacheFormat format, uint32_t width, uint32_t height) {
+		switch (format) {
+		case CacheBC1:
+			return compressedImageSize(BC1, width, height);
+		case CacheBC5:
+			return compressedImageSize(BC5, width, height);
+		case CacheBC7:
+			return compressedImageSize(BC7, width, height);
+		default:
+			return uint64_t(width) * height * 4;
+		}
+	}
+
+	bool endsWith(const std::string & text, const std::string & suffix) {
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+}
+
+TextureCacheFormat textureCacheFormat(TextureRole role) {
+	switch (role) {
+	case ColorTexture:
+		return CacheBC1;
+	case NormalTexture:
+		return CacheBC5;
+	default:
+		return CacheBC7;
+	}
+}
+
+MipContent textureMipContent(TextureRole role) {
+	switch (role) {
+	case ColorTexture:
+		return MipColor;
+	case NormalTexture:
+		return MipNormal;
+	default:
+		return MipData;
+	}
+}
+
+TextureRole textureRoleFromName(const std::string & path) {
+	size_t slash = path.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	if (name.find("normal") != std::string::npos) return NormalTexture;
+	if (name.find("color") != std::string::npos || name.find("cubemap") != std::string::npos) return ColorTexture;
+	return EffectsTexture;
+}
+
+std::unique_ptr<TextureCache> TextureCache::Open(const std::string & cachePath, const std::vector<std::string> & sourcePaths) {
+	std::unique_ptr<TextureCache> cache(new TextureCache());
+	if (!cache->file.Open(cachePath)) return nullptr;
+
+	const MappedFile & file = cache->file;
+	if (file.GetSize() < sizeof(TextureCacheHeader)) return nullptr;
+
+	TextureCacheHeader header;
+	memcpy(&header, file.GetData(), sizeof(TextureCacheHeader));
+	if (memcmp(header.magic, textureCacheMagic, sizeof(textureCacheMagic)) != 0 || header.version != TEXTURE_CACHE_VERSION ||
+		header.format > CacheBC7 || header.width == 0 || header.height == 0 || header.layerCount == 0 ||
+		header.levelCount == 0 || header.levelCount > TEXTURE_CACHE_MAX_LEVELS || header.sourceCount != sourcePaths.size()) {
+		return nullptr;
+	}
+
+	//check that every level is inside the file, aligned, contiguous with the previous one, and has the expected size
+	TextureCacheFormat format = static_cast<TextureCacheFormat>(header.format);
+	uint64_t dataOffset = header.levelOffsets[0];
+	uint64_t end = dataOffset;
+	uint32_t w = header.width;
+	uint32_t h = header.height;
+	for (uint32_t i = 0; i < header.levelCount; i++) {
+		if (header.levelOffsets[i] % TEXTURE_CACHE_ALIGNMENT != 0 ||
+			header.levelOffsets[i] != alignOffset(end) ||
+			header.levelSizes[i] != layerSize(format, w, h) * header.layerCount ||
+			header.levelOffsets[i] + header.levelSizes[i] > file.GetSize()) {
+			return nullptr;
+		}
+		cache->levels.push_back({ w, h, header.levelOffsets[i] - dataOffset, header.levelSizes[i] });
+		end = header.levelOffsets[i] + header.levelSizes[i];
+		w = std::max(1u, w / 2);
+		h = std::max(1u, h / 2);
+	}
+
+	//invalidation: a source with the same size and time is trusted, otherwise its content is hashed
+	for (uint32_t i = 0; i < header.sourceCount; i++) {
+		file_info_t info;
+		const TextureCacheSource & source = header.sources[i];
+		if (getFileInfo(sourcePaths[i], info) && (info.size != source.size || info.time != source.time)) {
+			uint64_t hash;
+			if (!hashFile(sourcePaths[i], hash) || hash != source.hash) return nullptr;
+		}
+	}
+
+	cache->format = format;
+	cache->width = header.width;
+	cache->height = header.height;
+	cache->layerCount = header.layerCount;
+	cache->data = reinterpret_cast<const unsigned char*>(file.GetData()) + dataOffset;
+	cache->dataSize = static_cast<size_t>(end - dataOffset);
+	return cache;
+}
+
+bool TextureCache::Write(const std::string & cachePath, TextureCacheFormat format, uint32_t width, uint32_t height, uint32_t layerCount,
+	const std::vector<std::vector<unsigned char>> & levels, const std::vector<std::string> & sourcePaths) {
+	if (levels.empty() || levels.size() > TEXTURE_CACHE_MAX_LEVELS || sourcePaths.size() > TEXTURE_CACHE_MAX_SOURCES) return false;
+
+	TextureCacheHeader header = {};
+	memcpy(header.magic, textureCacheMagic, sizeof(textureCacheMagic));
+	header.version = TEXTURE_CACHE_VERSION;
+	header.format = format;
+	header.width = width;
+	header.height = height;
+	header.layerCount = layerCount;
+	header.levelCount = static_cast<uint32_t>(levels.size());
+	header.sourceCount = static_cast<uint32_t>(sourcePaths.size());
+
+	for (size_t i = 0; i < sourcePaths.size(); i++) {
+		file_info_t info;
+		if (!getFileInfo(sourcePaths[i], info) || !hashFile(sourcePaths[i], header.sources[i].hash)) return false;
+		header.sources[i].size = info.size;
+		header.sources[i].time = info.time;
+	}
+
+	uint64_t offset = alignOffset(sizeof(TextureCacheHeader));
+	for (size_t i = 0; i < levels.size(); i++) {
+		header.levelOffsets[i] = offset;
+		header.levelSizes[i] = levels[i].size();
+		offset = alignOffset(offset + levels[i].size());
+	}
+
+	//write to a temporary file first, so that a failed write never leaves a truncated cache behind
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+
+		const char padding[TEXTURE_CACHE_ALIGNMENT] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(TextureCacheHeader));
+		uint64_t written = sizeof(TextureCacheHeader);
+		for (size_t i = 0; i < levels.size(); i++) {
+			out.write(padding, static_cast<std::streamsize>(header.levelOffsets[i] - written));
+			out.write(reinterpret_cast<const char*>(levels[i].data()), static_cast<std::streamsize>(levels[i].size()));
+			written = header.levelOffsets[i] + levels[i].size();
+		}
+
+		if (!out) {
+			out.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	std::remove(cachePath.c_str());
+	return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
+
+TextureCacheFormat TextureCache::GetFormat() const {
+	return format;
+}
+
+uint32_t TextureCache::GetWidth() const {
+	return width;
+}
+
+uint32_t TextureCache::GetHeight() const {
+	return height;
+}
+
+uint32_t TextureCache::GetLayerCount() const {
+	return layerCount;
+}
+
+const std::vector<texture_level_t> & TextureCache::GetLevels() const {
+	return levels;
+}
+
+const unsigned char * TextureCache::GetData() const {
+	return data;
+}
+
+size_t TextureCache::GetDataSize() const {
+	return dataSize;
+}
+
+std::string textureCachePath(const std::string & path) {
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return path + ".vktex";
+	}
+	return path.substr(0, dot) + ".vktex";
+}
+
+std::vector<std::string> cubemapFacePaths(const std::string & path) {
+	std::vector<std::string> faces;
+	for (const char* suffix : cubemapSuffixes) {
+		faces.push_back(path + suffix + ".png");
+	}
+	return faces;
+}
+
+bool bakeTextureCache(const std::string & cachePath, const std::vector<std::string> & sourcePaths, TextureRole role, bool compress) {
+	//base level of every layer
+	std::vector<std::vector<unsigned char>> layers(sourcePaths.size());
+	uint32_t width = 0;
+	uint32_t height = 0;
+	for (size_t i = 0; i < sourcePaths.size(); i++) {
+		PngImage image;
+		if (!image.Open(sourcePaths[i])) return false;
+		if (i > 0 && (image.GetWidth() != width || image.GetHeight() != height)) return false;
+		width = image.GetWidth();
+		height = image.GetHeight();
+
+		layers[i].resize(image.GetDecodedSize());
+		if (!image.Decode(layers[i].data())) return false;
+	}
+
+	TextureCacheFormat format = compress ? textureCacheFormat(role) : CacheRGBA8;
+	const BlockFormat blockFormats[] = { BC1, BC1, BC5, BC7 };
+
+	//every level of every layer, the base first
+	std::vector<std::vector<std::vector<unsigned char>>> chains(layers.size());
+	for (size_t i = 0; i < layers.size(); i++) {
+		generateMipChain(layers[i].data(), width, height, textureMipContent(role), chains[i], 0);
+		chains[i].insert(chains[i].begin(), std::move(layers[i]));
+	}
+
+	std::vector<std::vector<unsigned char>> levels(mipLevelCount(width, height));
+	for (uint32_t l = 0; l < levels.size(); l++) {
+		unsigned w, h;
+		mipLevelSize(width, height, l, w, h);
+		uint64_t size = layerSize(format, w, h);
+		levels[l].resize(size * chains.size());
+		for (size_t i = 0; i < chains.size(); i++) {
+			unsigned char* dest = levels[l].data() + i * size;
+			if (format == CacheRGBA8) {
+				memcpy(dest, chains[i][l].data(), size);
+			} else {
+				compressImage(blockFormats[format], chains[i][l].data(), w, h, dest);
+			}
+		}
+	}
+
+	return TextureCache::Write(cachePath, format, width, height, static_cast<uint32_t>(layers.size()), levels, sourcePaths);
+}
+
+int bakeTextureCaches(const std::string & directory, bool compress) {
+	int failures = 0;
+
+	std::vector<std::string> files = listFiles(directory, ".png");
+	std::sort(files.begin(), files.end());
+	std::set<std::string> remaining(files.begin(), files.end());
+
+	//cubemaps first, their faces are not baked on their own
+	for (const std::string& path : files) {
+		if (!endsWith(path, std::string(cubemapSuffixes[0]) + ".png")) continue;
+		std::string base = path.substr(0, path.size() - 6);
+		std::vector<std::string> faces = cubemapFacePaths(base);
+		if (!std::all_of(faces.begin(), faces.end(), [&remaining](const std::string& face) { return remaining.count(face) > 0; })) continue;
+
+		std::string cachePath = textureCachePath(base);
+		if (bakeTextureCache(cachePath, faces, ColorTexture, compress)) {
+			std::cout << "Baked: " << cachePath << std::endl;
+		} else {
+			std::cerr << "Unable to write the texture cache " << cachePath << std::endl;
+			failures++;
+		}
+		for (const std::string& face : faces) {
+			remaining.erase(face);
+		}
+	}
+
+	for (const std::string& path : remaining) {
+		std::string cachePath = textureCachePath(path);
+		if (bakeTextureCache(cachePath, { path }, textureRoleFromName(path), compress)) {
+			std::cout << "Baked: " << cachePath << std::endl;
+		} else {
+			std::cerr << "Unable to write the texture cache " << cachePath << std::endl;
+			failures++;
+		}
+	}
+
+	return failures;
+}
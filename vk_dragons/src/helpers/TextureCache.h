@@ -0,0 +1,89 @@
+#ifndef TextureCache_h
+#define TextureCache_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "FileUtilities.h"
+#include "MipGenerator.h"
+
+/// Format of the levels stored in a texture cache.
+enum TextureCacheFormat {
+	CacheRGBA8, CacheBC1, CacheBC5, CacheBC7
+};
+
+/// What a texture is sampled for, which decides its compressed format and color space.
+/// Color textures are sRGB and use BC1, normal maps only keep their x and y in BC5, the other data textures use BC7.
+enum TextureRole {
+	ColorTexture, NormalTexture, EffectsTexture
+};
+
+/// Compressed format used for a role.
+TextureCacheFormat textureCacheFormat(TextureRole role);
+
+/// How the mip levels of a role are filtered.
+MipContent textureMipContent(TextureRole role);
+
+/// Guess the role of a texture from its name: "normal" for normal maps, "color" and cubemaps for colors, effects otherwise.
+TextureRole textureRoleFromName(const std::string & path);
+
+/// One mip level, with every array layer stored one after the other.
+typedef struct {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;	// From the start of the data.
+	uint64_t size;
+} texture_level_t;
+
+/// A texture baked in a binary .vktex file, mapped in memory.
+/// Every mip level and array layer is stored in its final GPU format, from the largest level to the smallest,
+/// so the data is uploaded as is with one copy command and one region per level.
+/// Images are stored bottom row first, like the textures loaded from PNG files.
+class TextureCache {
+public:
+	/// Map the cache if it exists and matches its source PNG files (same size and time, or same content hash).
+	/// If the sources are missing, the cache is used as is. Returns nullptr when the cache can't be used.
+	static std::unique_ptr<TextureCache> Open(const std::string & cachePath, const std::vector<std::string> & sourcePaths);
+
+	/// Write the levels of a texture to a cache file, tagged with the current state of its sources.
+	/// levels[i] holds every layer of level i, one after the other, the first level being width x height.
+	static bool Write(const std::string & cachePath, TextureCacheFormat format, uint32_t width, uint32_t height, uint32_t layerCount,
+		const std::vector<std::vector<unsigned char>> & levels, const std::vector<std::string> & sourcePaths);
+
+	TextureCacheFormat GetFormat() const;
+	uint32_t GetWidth() const;
+	uint32_t GetHeight() const;
+	uint32_t GetLayerCount() const;
+	const std::vector<texture_level_t> & GetLevels() const;
+
+	/// Every level, 16 bytes aligned.
+	const unsigned char * GetData() const;
+	size_t GetDataSize() const;
+
+private:
+	MappedFile file;
+	TextureCacheFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t layerCount;
+	std::vector<texture_level_t> levels;
+	const unsigned char * data;
+	size_t dataSize;
+};
+
+/// Path of the cache associated with a PNG file or a cubemap ("plane_texture_color.png" -> "plane_texture_color.vktex", "cubemap" -> "cubemap.vktex").
+std::string textureCachePath(const std::string & path);
+
+/// Paths of the six faces of a cubemap, in layer order: +X, -X, +Y, -Y, +Z, -Z.
+std::vector<std::string> cubemapFacePaths(const std::string & path);
+
+/// Decode the sources of a texture, one per layer, build their mip chains on every hardware thread, and write them to a cache.
+/// The levels are compressed in the format of the role, or kept as RGBA8 when compress is false.
+bool bakeTextureCache(const std::string & cachePath, const std::vector<std::string> & sourcePaths, TextureRole role, bool compress);
+
+/// Bake every PNG file of a directory, without recursion. Six files ending in _r, _l, _u, _d, _f and _b are baked as one cubemap.
+/// Returns the number of failures.
+int bakeTextureCaches(const std::string & directory, bool compress);
+
+#endif
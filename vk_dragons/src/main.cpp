@@ -1,8 +1,17 @@
 #define GLFW_INCLUDE_VULKAN
 #include<GLFW/glfw3.h>
 #include "Scene.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Benchmarks.h"
+#include "TlsfBenchmark.h"
+#include "TextureCache.h"
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
 #include <cmath>
+#include <cstring>
 
 #define INITIAL_SIZE_WIDTH 800
 #define INITIAL_SIZE_HEIGHT 600
@@ -20,7 +29,68 @@ void OnFramebufferResized(GLFWwindow* window, int _width, int _height) {
 	height = static_cast<uint32_t>(_height);
 }
 
-int main() {
+int main(int argc, char** argv) {
+	//"--bake-meshes [directory]" writes the .vkmesh cache of every .obj file and exits without opening a window
+	if (argc > 1 && strcmp(argv[1], "--bake-meshes") == 0) {
+		std::string directory = argc > 2 ? argv[2] : "resources";
+		return bakeMeshCaches(directory) == 0 ? 0 : 1;
+	}
+	//"--test-mesh-optimizer [files...]" checks the vertex cache, overdraw and vertex fetch passes, by default on the dragon and suzanne
+	if (argc > 1 && strcmp(argv[1], "--test-mesh-optimizer") == 0) {
+		std::vector<std::string> paths(argv + 2, argv + argc);
+		if (paths.empty()) paths = { "resources/dragon.obj", "resources/suzanne.obj" };
+		return testMeshOptimizer(paths) == 0 ? 0 : 1;
+	}
+	//"--benchmark-obj [files...]" times the obj loader in every mode against the baseline loader, by default on the dragon and suzanne
+	if (argc > 1 && strcmp(argv[1], "--benchmark-obj") == 0) {
+		std::vector<std::string> paths(argv + 2, argv + argc);
+		if (paths.empty()) paths = { "resources/dragon.obj", "resources/suzanne.obj" };
+		return benchmarkObjLoading(paths) == 0 ? 0 : 1;
+	}
+	//"--benchmark-mesh-processing [files...]" times the centering and the tangent frame alone against the baseline versions, by default on the dragon and suzanne
+	if (argc > 1 && strcmp(argv[1], "--benchmark-mesh-processing") == 0) {
+		std::vector<std::string> paths(argv + 2, argv + argc);
+		if (paths.empty()) paths = { "resources/dragon.obj", "resources/suzanne.obj" };
+		return benchmarkMeshProcessing(paths) == 0 ? 0 : 1;
+	}
+	//"--benchmark-allocator" replays random alloc/free traces on the range allocator of the device memory and on the first-fit lists it replaced
+	if (argc > 1 && strcmp(argv[1], "--benchmark-allocator") == 0) {
+		return BenchmarkTlsf() == 0 ? 0 : 1;
+	}
+	//"--benchmark-png [directories...]" compares the png decoder with lodepng, by default on the resources and cubemaps
+	if (argc > 1 && strcmp(argv[1], "--benchmark-png") == 0) {
+		std::vector<std::string> directories(argv + 2, argv + argc);
+		if (directories.empty()) directories = { "resources", "resources/cubemap" };
+		return benchmarkPngDecoding(directories) == 0 ? 0 : 1;
+	}
+	//"--bake-textures [directory] [--uncompressed]" writes the .vktex cache of every .png file, by default of the resources and cubemaps
+	if (argc > 1 && strcmp(argv[1], "--bake-textures") == 0) {
+		bool compress = true;
+		std::vector<std::string> directories;
+		for (int i = 2; i < argc; i++) {
+			if (strcmp(argv[i], "--uncompressed") == 0) compress = false;
+			else directories.push_back(argv[i]);
+		}
+		if (directories.empty()) directories = { "resources", "resources/cubemap" };
+
+		int failures = 0;
+		for (auto& directory : directories) {
+			failures += bakeTextureCaches(directory, compress);
+		}
+		return failures == 0 ? 0 : 1;
+	}
+
+	//"--frames-in-flight n" sets how many frames the CPU can record ahead of the GPU
+	uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--frames-in-flight") == 0) framesInFlight = static_cast<uint32_t>(std::max(1, atoi(argv[i + 1])));
+	}
+	//"--benchmark-pipelines" compares pipeline creation with an empty pipeline cache and a filled one at startup
+	bool benchmarkPipelines = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--benchmark-pipelines") == 0) benchmarkPipelines = true;
+	}
+
 	glfwInit();
 
 	//we don't need an OpenGL context, so specify GLFW_NO_API
@@ -35,13 +105,18 @@ int main() {
 
 	glfwSetFramebufferSizeCallback(window, OnFramebufferResized);
 
-	Scene scene(window, width, height);
+	Scene scene(window, width, height, framesInFlight);
+	if (benchmarkPipelines) scene.BenchmarkPipelines();
 
 	glfwShowWindow(window);
 	double lastTime = 0.0;
 
 	double nextFPS = 0.25;
 	int frames = 0;
+	int measured = 0;
+	double frameTime = 0.0;
+	double waitTime = 0.0;
+	double recordTime = 0.0;
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
@@ -57,15 +132,27 @@ int main() {
 		frames++;
 
 		if (now > nextFPS) {
+			//averages of the frames since the last update, the CPU spends the rest of the frame time recording
 			std::stringstream stream;
-			stream << "Here Be Dragons (" << round(frames / (0.25 + (now - nextFPS))) << " fps)";
+			stream << std::fixed << std::setprecision(1);
+			stream << "Here Be Dragons (" << static_cast<int>(round(frames / (0.25 + (now - nextFPS)))) << " fps, "
+				<< frameTime / std::max(1, measured) << " ms frame, " << waitTime / std::max(1, measured) << " ms waiting for the GPU, "
+				<< recordTime / std::max(1, measured) << " ms recording)";
 			glfwSetWindowTitle(window, stream.str().c_str());
 			frames = 0;
+			measured = 0;
+			frameTime = 0.0;
+			waitTime = 0.0;
+			recordTime = 0.0;
 			nextFPS = now + 0.25;
 		}
 
 		scene.Update(elapsed);
 		scene.Render();
+		measured++;
+		frameTime += scene.GetFrameTime();
+		waitTime += scene.GetWaitTime();
+		recordTime += scene.GetRecordTime();
 	}
 
 	glfwDestroyWindow(window);